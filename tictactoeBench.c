@@ -0,0 +1,268 @@
+/***********************************************************/
+/* This program measures the throughput of the TicTacToe   */
+/* engine library (libttt). Every thread checks and        */
+/* searches its own copy of a set of random positions of   */
+/* each board variant, one at a time and in lockstep       */
+/* batches, which also exercises the library's reentrancy: */
+/* all threads and both searches must get the same         */
+/* results.                                                */
+/***********************************************************/
+
+/* #include files go here */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <string.h>
+#include <pthread.h>
+#include "tictactoeEngine.h"
+
+/* The default number of random positions generated per board variant. */
+#define DEFAULT_POSITIONS 200
+/* The maximum number of threads benchmarked. */
+#define MAX_THREADS 64
+/* The number of passes made over the positions when checking the rules. */
+#define RULE_PASSES 1000
+/* The seed of the random positions (the same for every thread). */
+#define SEED 0x5eed
+
+/* Structure for the work and results of one benchmark thread. */
+struct Bench_Thread {
+    pthread_t thread;                   // thread running the benchmark
+    const struct TTT_Variant *variant;  // board variant benchmarked
+    int count;                          // number of positions
+    int batch;                          // number of positions searched per batched call
+    struct TTT_Board *boards;           // this thread's copy of the positions
+    uint64_t ruleChecksum;              // sum of the rule check results
+    uint64_t searchChecksum;            // sum of the moves and scores found
+    uint64_t batchChecksum;             // sum of the moves and scores found by the batched search
+    double ruleTime;                    // time (in seconds) spent checking the rules
+    double searchTime;                  // time (in seconds) spent searching
+    double batchTime;                   // time (in seconds) spent searching as one batch
+};
+
+void print_error(const char *msg, int errnum, int terminate);
+void handle_init_error(const char *msg, int errnum);
+void extract_args(int argc, char *argv[], int *positions, int *threads, int *batch);
+double bench_clock(void);
+void generate_positions(const struct TTT_Variant *variant, struct TTT_Board *boards, int count);
+void *run_bench_thread(void *arg);
+int bench_variant(const struct TTT_Variant *variant, int positions, int threads, int batch);
+
+/**
+ * @brief This program measures how many positions per second the engine library checks and
+ * searches on each board variant, with one or more threads calling it concurrently.
+ *
+ * @param argc Non-negative value representing the number of arguments passed to the program.
+ * @param argv The arguments passed to the program.
+ * @return The value zero indicates successful termination.
+ */
+int main(int argc, char *argv[]) {
+    int positions = DEFAULT_POSITIONS, threads = 1, batch = 0, id, failed = 0;
+    const struct TTT_Variant *variant;
+
+    /* Extract options to their respective variables */
+    extract_args(argc, argv, &positions, &threads, &batch);
+    if (batch == 0 || batch > positions) batch = positions;
+
+    printf("[+]Engine library benchmark: %d positions per variant, %d thread(s), batches of %d\n", positions, threads, batch);
+    printf("%-8s %14s %14s %14s %8s\n", "variant", "checks/s", "searches/s", "batched/s", "results");
+    for (id = 0; (variant = ttt_get_variant(id)) != NULL; id++) {
+        if (bench_variant(variant, positions, threads, batch) == TTT_ERROR) failed = 1;
+    }
+    return failed ? EXIT_FAILURE : 0;
+}
+
+/**
+ * @brief Prints the provided error message and corresponding errno message (if present) and
+ * terminates the process if asked to do so.
+ *
+ * @param msg The error description message to display.
+ * @param errnum This is the error number, usually errno.
+ * @param terminate Whether or not the process should be terminated.
+ */
+void print_error(const char *msg, int errnum, int terminate) {
+    if (errnum) {
+        printf("ERROR: %s: %s\n", msg, strerror(errnum));
+    } else {
+        printf("ERROR: %s\n", msg);
+    }
+    if (terminate) exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Prints a string describing the initialization error, the correct command usage, and
+ * exits the process signaling unsuccessful termination.
+ *
+ * @param msg The error description message to display.
+ * @param errnum This is the error number, usually errno.
+ */
+void handle_init_error(const char *msg, int errnum) {
+    print_error(msg, errnum, 0);
+    printf("Usage is: tictactoeBench [-n <positions>] [-j <threads>] [-b <batch>]\n");
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Extracts the user provided options and performs validation on their formatting. If
+ * any errors are found, the function terminates the process.
+ *
+ * @param argc The number of arguments passed to the program.
+ * @param argv The arguments passed to the program.
+ * @param positions The number of random positions generated per board variant.
+ * @param threads The number of threads calling the library concurrently.
+ * @param batch The number of positions searched per batched call (0 for all of them).
+ */
+void extract_args(int argc, char *argv[], int *positions, int *threads, int *batch) {
+    int opt;
+    while ((opt = getopt(argc, argv, "n:j:b:")) != -1) {
+        switch (opt) {
+            case 'n':   // positions per variant
+                if ((*positions = strtol(optarg, NULL, 10)) < 1) handle_init_error("-n: Invalid number of positions", 0);
+                break;
+            case 'j':   // concurrent threads
+                *threads = strtol(optarg, NULL, 10);
+                if (*threads < 1 || *threads > MAX_THREADS) handle_init_error("-j: Invalid number of threads", 0);
+                break;
+            case 'b':   // positions per batched search
+                if ((*batch = strtol(optarg, NULL, 10)) < 1) handle_init_error("-b: Invalid batch size", 0);
+                break;
+            default:
+                handle_init_error("Invalid option", 0);
+        }
+    }
+    if (optind != argc) handle_init_error("argc: Invalid number of command line arguments", 0);
+}
+
+/**
+ * @brief Reads the monotonic clock.
+ *
+ * @return The current time in seconds.
+ */
+double bench_clock(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Generates random positions that can still be played by making random moves from the
+ * empty board. The positions are normalized by ttt_validate_position() (the player to move
+ * holds the first marks).
+ *
+ * @param variant The board variant.
+ * @param boards The array to fill with positions.
+ * @param count The number of positions to generate.
+ */
+void generate_positions(const struct TTT_Variant *variant, struct TTT_Board *boards, int count) {
+    uint32_t state = SEED + variant->id;
+    int i;
+    for (i = 0; i < count; i++) {
+        struct TTT_Board board;
+        int moves, square;
+        do {
+            board.marks[0] = board.marks[1] = 0;
+            /* Play a random number of random moves, leaving at least one square open */
+            state = state * 1103515245 + 12345;
+            moves = (state >> 16) % variant->squares;
+            while (moves-- > 0) {
+                do {
+                    state = state * 1103515245 + 12345;
+                    square = (state >> 16) % variant->squares + 1;
+                } while (ttt_validate_move(variant, &board, square) != TTT_MOVE_VALID);
+                ttt_mark_square(&board, square, 1 + __builtin_popcount(board.marks[0] | board.marks[1]) % 2);
+            }
+        } while (ttt_validate_position(variant, &board) == TTT_ERROR);   // someone already won
+        boards[i] = board;
+    }
+}
+
+/**
+ * @brief Runs the benchmark of one thread: checks every position for a win or a draw
+ * RULE_PASSES times, then searches every position for the best move, one at a time and then
+ * in batches with ttt_find_best_moves().
+ *
+ * @param arg The thread's work and results (struct Bench_Thread).
+ * @return NULL.
+ */
+void *run_bench_thread(void *arg) {
+    struct Bench_Thread *bench = arg;
+    double start = bench_clock();
+    int pass, i, score, *moves, *scores;
+    /* Check the rules */
+    for (pass = 0; pass < RULE_PASSES; pass++) {
+        for (i = 0; i < bench->count; i++) {
+            bench->ruleChecksum += ttt_check_win(bench->variant, &bench->boards[i]) + ttt_check_draw(bench->variant, &bench->boards[i]);
+        }
+    }
+    bench->ruleTime = bench_clock() - start;
+    /* Search for the best moves */
+    start = bench_clock();
+    for (i = 0; i < bench->count; i++) {
+        bench->searchChecksum += ttt_find_best_move(bench->variant, &bench->boards[i], &score);
+        bench->searchChecksum += (uint64_t)(int64_t)score << 8;
+    }
+    bench->searchTime = bench_clock() - start;
+    /* Search for the best moves in lockstep batches */
+    if ((moves = malloc(sizeof(int) * 2 * bench->count)) == NULL) print_error("malloc", errno, 1);
+    scores = &moves[bench->count];
+    start = bench_clock();
+    for (i = 0; i < bench->count; i += bench->batch) {
+        int count = (bench->count - i < bench->batch) ? bench->count - i : bench->batch;
+        ttt_find_best_moves(bench->variant, &bench->boards[i], count, &moves[i], &scores[i]);
+    }
+    bench->batchTime = bench_clock() - start;
+    for (i = 0; i < bench->count; i++) {
+        bench->batchChecksum += moves[i];
+        bench->batchChecksum += (uint64_t)(int64_t)scores[i] << 8;
+    }
+    free(moves);
+    return NULL;
+}
+
+/**
+ * @brief Benchmarks one board variant with the given number of threads and prints its
+ * throughput. Every thread gets its own copy of the same positions.
+ *
+ * @param variant The board variant.
+ * @param positions The number of positions.
+ * @param threads The number of threads.
+ * @param batch The number of positions searched per batched call.
+ * @return 0 if every thread got the same results, or TTT_ERROR otherwise.
+ */
+int bench_variant(const struct TTT_Variant *variant, int positions, int threads, int batch) {
+    static struct Bench_Thread bench[MAX_THREADS];
+    struct TTT_Board *boards;
+    double ruleTime = 0, searchTime = 0, batchTime = 0;
+    int t, consistent = 1;
+    if ((boards = malloc(sizeof(struct TTT_Board) * positions * threads)) == NULL) print_error("malloc", errno, 1);
+    generate_positions(variant, boards, positions);
+    for (t = 0; t < threads; t++) {
+        memcpy(&boards[t * positions], boards, sizeof(struct TTT_Board) * positions);
+        memset(&bench[t], 0, sizeof(struct Bench_Thread));
+        bench[t].variant = variant;
+        bench[t].count = positions;
+        bench[t].batch = batch;
+        bench[t].boards = &boards[t * positions];
+    }
+    /* Run the threads concurrently (the first one on this thread) */
+    for (t = 1; t < threads; t++) {
+        if ((errno = pthread_create(&bench[t].thread, NULL, run_bench_thread, &bench[t])) != 0) print_error("pthread_create", errno, 1);
+    }
+    run_bench_thread(&bench[0]);
+    for (t = 1; t < threads; t++) pthread_join(bench[t].thread, NULL);
+    /* Measure the throughput over the slowest thread and check that every thread got the same results */
+    for (t = 0; t < threads; t++) {
+        if (bench[t].ruleTime > ruleTime) ruleTime = bench[t].ruleTime;
+        if (bench[t].searchTime > searchTime) searchTime = bench[t].searchTime;
+        if (bench[t].batchTime > batchTime) batchTime = bench[t].batchTime;
+        if (bench[t].ruleChecksum != bench[0].ruleChecksum || bench[t].searchChecksum != bench[0].searchChecksum) consistent = 0;
+        if (bench[t].batchChecksum != bench[t].searchChecksum) consistent = 0;
+    }
+    printf("%-8s %14.0f %14.1f %14.1f %8s\n", variant->name, (double)positions * RULE_PASSES * threads / ruleTime,
+        positions * threads / searchTime, positions * threads / batchTime, consistent ? "match" : "DIFFER");
+    free(boards);
+    return consistent ? 0 : TTT_ERROR;
+}
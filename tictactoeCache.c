@@ -0,0 +1,167 @@
+/***********************************************************/
+/* Bounded position cache shared by the threads analyzing  */
+/* boards for the ANALYZE command. Positions are looked up */
+/* by a 64-bit key in a chained hash table and the least   */
+/* recently used position is evicted when it is full.      */
+/***********************************************************/
+
+/* #include files go here */
+#include <stdlib.h>
+#include "tictactoeCache.h"
+
+/**
+ * @brief Hashes a position key to a bucket of the cache.
+ *
+ * @param cache The cache being searched.
+ * @param key The position key.
+ * @return The bucket index of the key.
+ */
+static uint64_t cache_bucket(const struct Position_Cache *cache, uint64_t key) {
+    /* Fibonacci hashing spreads the base 3 board digits over the buckets */
+    return (key * 0x9E3779B97F4A7C15ULL >> 32) & cache->mask;
+}
+
+/**
+ * @brief Removes an entry from the recency list.
+ *
+ * @param cache The cache the entry belongs to.
+ * @param index The index of the entry.
+ */
+static void unlink_entry(struct Position_Cache *cache, int32_t index) {
+    struct Cache_Entry *entry = &cache->entries[index];
+    if (entry->prev >= 0) cache->entries[entry->prev].next = entry->next;
+    else cache->head = entry->next;
+    if (entry->next >= 0) cache->entries[entry->next].prev = entry->prev;
+    else cache->tail = entry->prev;
+}
+
+/**
+ * @brief Adds an entry to the front of the recency list (most recently used).
+ *
+ * @param cache The cache the entry belongs to.
+ * @param index The index of the entry.
+ */
+static void push_entry(struct Position_Cache *cache, int32_t index) {
+    struct Cache_Entry *entry = &cache->entries[index];
+    entry->prev = -1;
+    entry->next = cache->head;
+    if (cache->head >= 0) cache->entries[cache->head].prev = index;
+    cache->head = index;
+    if (cache->tail < 0) cache->tail = index;
+}
+
+/**
+ * @brief Finds the entry for a position without updating its recency.
+ *
+ * @param cache The cache to search.
+ * @param key The position key.
+ * @return The index of the entry, or -1 if the position is not cached.
+ */
+static int32_t find_entry(const struct Position_Cache *cache, uint64_t key) {
+    int32_t index;
+    for (index = cache->buckets[cache_bucket(cache, key)]; index >= 0; index = cache->entries[index].chain) {
+        if (cache->entries[index].key == key) return index;
+    }
+    return -1;
+}
+
+/**
+ * @brief Creates an empty position cache.
+ *
+ * @param capacity The maximum number of positions cached.
+ * @return The new cache, or NULL if it could not be created.
+ */
+struct Position_Cache *cache_create(int capacity) {
+    uint64_t i, numBuckets = 1;
+    struct Position_Cache *cache;
+    if (capacity < 1 || (cache = calloc(1, sizeof(struct Position_Cache))) == NULL) return NULL;
+    /* Use at least twice as many buckets as entries to keep the chains short */
+    while (numBuckets < 2 * (uint64_t)capacity) numBuckets <<= 1;
+    cache->entries = calloc(capacity, sizeof(struct Cache_Entry));
+    cache->buckets = malloc(numBuckets * sizeof(int32_t));
+    if (cache->entries == NULL || cache->buckets == NULL) {
+        free(cache->entries);
+        free(cache->buckets);
+        free(cache);
+        return NULL;
+    }
+    for (i = 0; i < numBuckets; i++) cache->buckets[i] = -1;
+    cache->capacity = capacity;
+    cache->mask = numBuckets - 1;
+    cache->head = cache->tail = -1;
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+/**
+ * @brief Frees a position cache.
+ *
+ * @param cache The cache to free.
+ */
+void cache_destroy(struct Position_Cache *cache) {
+    if (cache == NULL) return;
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->entries);
+    free(cache->buckets);
+    free(cache);
+}
+
+/**
+ * @brief Looks up the analysis of a position, marking it most recently used if found.
+ *
+ * @param cache The cache to search.
+ * @param key The position key.
+ * @param move Set to the cached best move if found.
+ * @param score Set to the cached score if found.
+ * @return True if the position was cached, false otherwise.
+ */
+int cache_lookup(struct Position_Cache *cache, uint64_t key, int *move, int *score) {
+    int32_t index;
+    pthread_mutex_lock(&cache->lock);
+    if ((index = find_entry(cache, key)) >= 0) {
+        *move = cache->entries[index].move;
+        *score = cache->entries[index].score;
+        unlink_entry(cache, index);
+        push_entry(cache, index);
+        cache->hits++;
+    } else {
+        cache->misses++;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return index >= 0;
+}
+
+/**
+ * @brief Caches the analysis of a position, evicting the least recently used position if the
+ * cache is full. A position that is already cached is updated instead.
+ *
+ * @param cache The cache to insert into.
+ * @param key The position key.
+ * @param move The best move in the position.
+ * @param score The minimax score of the best move.
+ */
+void cache_insert(struct Position_Cache *cache, uint64_t key, int move, int score) {
+    int32_t index, *link;
+    pthread_mutex_lock(&cache->lock);
+    if ((index = find_entry(cache, key)) >= 0) {
+        unlink_entry(cache, index);
+    } else {
+        if (cache->size < cache->capacity) {
+            index = cache->size++;
+        } else {
+            /* Evict the least recently used entry from its bucket and the recency list */
+            index = cache->tail;
+            for (link = &cache->buckets[cache_bucket(cache, cache->entries[index].key)]; *link != index; link = &cache->entries[*link].chain);
+            *link = cache->entries[index].chain;
+            unlink_entry(cache, index);
+        }
+        /* Add the entry to its bucket */
+        cache->entries[index].key = key;
+        cache->entries[index].chain = cache->buckets[cache_bucket(cache, key)];
+        cache->buckets[cache_bucket(cache, key)] = index;
+    }
+    cache->entries[index].move = move;
+    cache->entries[index].score = score;
+    push_entry(cache, index);
+    pthread_mutex_unlock(&cache->lock);
+}
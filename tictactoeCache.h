@@ -0,0 +1,40 @@
+/***********************************************************/
+/* Bounded position cache shared by the threads analyzing  */
+/* boards for the ANALYZE command. Positions are looked up */
+/* by a 64-bit key in a chained hash table and the least   */
+/* recently used position is evicted when it is full.      */
+/***********************************************************/
+
+#ifndef TICTACTOE_CACHE_H
+#define TICTACTOE_CACHE_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+/* Structure for a cached position and its analysis. */
+struct Cache_Entry {
+    uint64_t key;           // position the entry is for
+    int32_t move;           // best move in the position
+    int32_t score;          // minimax score of the best move
+    int32_t prev, next;     // neighbouring entries in recency order (-1 at the ends)
+    int32_t chain;          // next entry in the same hash bucket (-1 at the end)
+};
+
+/* Structure for a bounded least-recently-used position cache. */
+struct Position_Cache {
+    int capacity;                   // maximum number of positions cached
+    int size;                       // number of positions cached
+    uint64_t mask;                  // number of hash buckets minus one (a power of two)
+    struct Cache_Entry *entries;    // cached positions
+    int32_t *buckets;               // first entry in each hash bucket (-1 if empty)
+    int32_t head, tail;             // most and least recently used entries (-1 if empty)
+    uint64_t hits, misses;          // number of lookups that found and missed a position
+    pthread_mutex_t lock;           // protects the cache
+};
+
+struct Position_Cache *cache_create(int capacity);
+void cache_destroy(struct Position_Cache *cache);
+int cache_lookup(struct Position_Cache *cache, uint64_t key, int *move, int *score);
+void cache_insert(struct Position_Cache *cache, uint64_t key, int move, int score);
+
+#endif
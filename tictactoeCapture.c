@@ -0,0 +1,106 @@
+/***********************************************************/
+/* Traffic capture files for the TicTacToe server. Every   */
+/* datagram received is written as a fixed-size record    */
+/* with its arrival time and source address, so a capture  */
+/* can be replayed into the server later.                  */
+/***********************************************************/
+
+/* #include files go here */
+#include <errno.h>
+#include <string.h>
+#include "tictactoeCapture.h"
+#include "tictactoeTrace.h"
+
+/**
+ * @brief Creates a capture file and writes its header. Capture times are measured from now.
+ *
+ * @param writer The capture writer to set up.
+ * @param path The path of the capture file (truncated if it exists).
+ * @return Zero on success, -1 if the file could not be created (errno is set).
+ */
+int capture_open(struct Capture_Writer *writer, const char *path) {
+    memset(writer, 0, sizeof(struct Capture_Writer));
+    if ((writer->file = fopen(path, "wb")) == NULL) return -1;
+    if (fwrite(CAPTURE_MAGIC, CAPTURE_MAGIC_SIZE, 1, writer->file) != 1) {
+        fclose(writer->file);
+        writer->file = NULL;
+        return -1;
+    }
+    writer->start = trace_clock();
+    return 0;
+}
+
+/**
+ * @brief Appends a received datagram to the capture file. Records are buffered and flushed
+ * every CAPTURE_FLUSH records (or by capture_flush()).
+ *
+ * @param writer The capture writer.
+ * @param time The trace_clock() time the datagram arrived.
+ * @param addr The address the datagram came from.
+ * @param data The datagram.
+ * @param length The number of bytes received.
+ */
+void capture_write(struct Capture_Writer *writer, uint64_t time, const struct sockaddr_in *addr, const void *data, int length) {
+    struct Capture_Record record = {0};
+    record.time = (time > writer->start) ? time - writer->start : 0;
+    record.addr = addr->sin_addr.s_addr;
+    record.port = addr->sin_port;
+    record.length = (length > UINT8_MAX) ? UINT8_MAX : length;
+    memcpy(record.data, data, (length < CAPTURE_DATA) ? length : CAPTURE_DATA);
+    if (fwrite(&record, sizeof(record), 1, writer->file) != 1) perror("capture_write");
+    writer->records++;
+    if (++writer->unflushed >= CAPTURE_FLUSH) capture_flush(writer);
+}
+
+/**
+ * @brief Writes any buffered records to the capture file.
+ *
+ * @param writer The capture writer.
+ */
+void capture_flush(struct Capture_Writer *writer) {
+    if (writer->unflushed == 0) return;
+    if (fflush(writer->file) != 0) perror("capture_flush");
+    writer->unflushed = 0;
+}
+
+/**
+ * @brief Flushes and closes a capture file.
+ *
+ * @param writer The capture writer.
+ */
+void capture_close(struct Capture_Writer *writer) {
+    if (writer->file == NULL) return;
+    if (fclose(writer->file) != 0) perror("capture_close");
+    writer->file = NULL;
+}
+
+/**
+ * @brief Opens a capture file for replay and checks its header.
+ *
+ * @param path The path of the capture file.
+ * @return The open file positioned at the first record, or NULL if it could not be opened
+ * or is not a capture file (errno is zero in the latter case).
+ */
+FILE *replay_open(const char *path) {
+    char magic[CAPTURE_MAGIC_SIZE];
+    FILE *file;
+    if ((file = fopen(path, "rb")) == NULL) return NULL;
+    if (fread(magic, CAPTURE_MAGIC_SIZE, 1, file) != 1 || memcmp(magic, CAPTURE_MAGIC, CAPTURE_MAGIC_SIZE) != 0) {
+        fclose(file);
+        errno = 0;
+        return NULL;
+    }
+    return file;
+}
+
+/**
+ * @brief Reads the next record of a capture file.
+ *
+ * @param file The capture file opened by replay_open().
+ * @param record Set to the next record.
+ * @return True if a record was read, false at the end of the capture (a truncated last
+ * record, e.g. from a server that was killed mid-write, is ignored).
+ */
+int replay_read(FILE *file, struct Capture_Record *record) {
+    return fread(record, sizeof(struct Capture_Record), 1, file) == 1;
+}
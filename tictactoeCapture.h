@@ -0,0 +1,50 @@
+/***********************************************************/
+/* Traffic capture files for the TicTacToe server. Every   */
+/* datagram received is written as a fixed-size record    */
+/* with its arrival time and source address, so a capture  */
+/* can be replayed into the server later.                  */
+/***********************************************************/
+
+#ifndef TICTACTOE_CAPTURE_H
+#define TICTACTOE_CAPTURE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <netinet/in.h>
+
+/* The bytes every capture file starts with (format name and version). */
+#define CAPTURE_MAGIC "TTTCAP01"
+/* The length of the capture file magic. */
+#define CAPTURE_MAGIC_SIZE 8
+/* The maximum number of datagram bytes kept in each record (the largest command). */
+#define CAPTURE_DATA 12
+/* The number of records written between flushes of the capture file. */
+#define CAPTURE_FLUSH 64
+
+/* Structure for a captured datagram (32 bytes, stored in host byte order except the address). */
+struct Capture_Record {
+    uint64_t time;              // nanoseconds since the capture started
+    in_addr_t addr;             // source IP address (network byte order)
+    in_port_t port;             // source port number (network byte order)
+    uint8_t length;             // number of bytes received (may exceed CAPTURE_DATA)
+    uint8_t reserved;           // unused (pads the header to 16 bytes)
+    char data[CAPTURE_DATA];    // datagram as received (truncated to CAPTURE_DATA bytes)
+    uint32_t reserved2;         // unused (pads the record to 32 bytes)
+};
+
+/* Structure for a capture file being written. */
+struct Capture_Writer {
+    FILE *file;         // capture file
+    uint64_t start;     // trace_clock() time the capture started
+    int unflushed;      // number of records written since the last flush
+    uint64_t records;   // number of records written
+};
+
+int capture_open(struct Capture_Writer *writer, const char *path);
+void capture_write(struct Capture_Writer *writer, uint64_t time, const struct sockaddr_in *addr, const void *data, int length);
+void capture_flush(struct Capture_Writer *writer);
+void capture_close(struct Capture_Writer *writer);
+FILE *replay_open(const char *path);
+int replay_read(FILE *file, struct Capture_Record *record);
+
+#endif
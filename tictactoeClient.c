@@ -15,11 +15,18 @@
 #include <errno.h>
 #include <sys/time.h>
 #include <ctype.h>
-/* Define the number of rows and columns */
-#define ROWS 3
-#define COLUMNS 3
+#include <time.h>
+#include "tictactoeEngine.h"
 /* The number of command line arguments. */
 #define NUM_ARGS 3
+/* The retransmission timeout (ms) before any round trip has been measured (RFC 6298). */
+#define INITIAL_RTO 1000
+/* The smallest retransmission timeout (ms). */
+#define MIN_RTO 200
+/* The largest retransmission timeout (ms) the exponential backoff grows to. */
+#define MAX_RTO 8000
+/* How long (ms) a command is sent again before giving up on the server. */
+#define GIVE_UP 20000
 
 /* C language requires that you predefine all the routines you are writing */
  struct buffer {
@@ -29,15 +36,26 @@
        char gameNumber;
         
     };
-int checkwin(char board[ROWS][COLUMNS]);
-void print_board(char board[ROWS][COLUMNS]);
+ /* round trip time estimate of the server, kept like TCP does (RFC 6298) */
+ struct rtt_estimator {
+       int samples;   // round trips measured so far
+       double srtt;   // smoothed round trip time (ms)
+       double rttvar; // round trip time variation (ms)
+       double rto;    // retransmission timeout (ms)
+    };
+int checkwin(const struct TTT_Board *board);
+void print_board(const struct TTT_Board *board);
 int tictactoe();
-int initSharedState(char board[ROWS][COLUMNS]);
+int initSharedState(struct TTT_Board *board);
+double now_ms();
+void rtt_update(struct rtt_estimator *rtt, double sample);
+int await_reply(int sd, struct sockaddr_in *serverAdd, const struct buffer *command, double sentAt,
+                struct rtt_estimator *rtt, const struct TTT_Board *board, char gameNumber, struct buffer *reply);
 
 int main(int argc, char *argv[])
 {
     struct buffer Buffer={0};
-    char board[ROWS][COLUMNS];
+    struct TTT_Board board;
     int sd;
     struct sockaddr_in server_address;
     int portNumber;
@@ -72,6 +90,9 @@ int main(int argc, char *argv[])
     socklen_t fromLength=sizeof(struct sockaddr);
     Buffer.version=3;
     Buffer.move=0;
+    // tag the new game so the server can tell a repeated NEW_GAME from a second game
+    srand(time(NULL) ^ getpid());
+    Buffer.gameNumber=1+rand()%127;
     if(sendto(sd,&Buffer,sizeof(Buffer),0,(struct sockaddr*)&server_address,fromLength)<0)
     {
         close(sd);
@@ -80,21 +101,23 @@ int main(int argc, char *argv[])
     }
     
     printf("Connected to the server!\n");
-    initSharedState(board); // Initialize the 'game' board
-    tictactoe(board, sd,(struct sockaddr*)&server_address);   // call the 'game'
+    initSharedState(&board); // Initialize the 'game' board
+    tictactoe(&board, sd,(struct sockaddr*)&server_address,&Buffer);   // call the 'game'
     return 0;
 }
 
-int tictactoe(char board[ROWS][COLUMNS], int sd,struct sockaddr_in *serverAdd)
+int tictactoe(struct TTT_Board *board, int sd,struct sockaddr_in *serverAdd,struct buffer *lastCommand)
 {
     /* this is the meat of the game, you'll look here for how to change it up */
     int player = 1; // keep track of whose turn it is
     int i, rc;      // used for keeping track of choice user makes
-    int row, column;
-    char mark, pick; // either an 'x' or an 'o'
+    char pick;
+    const struct TTT_Variant *variant = ttt_get_variant(0); // the 3x3 board
     int input;
-    char gameNumber;
+    char gameNumber = 0;
     int x=0;
+    double sentAt=now_ms(); // when the last command was sent (the NEW_GAME was just sent)
+    struct rtt_estimator rtt={0,0,0,INITIAL_RTO};
    struct buffer player2,player1={0};
     /* loop, first print the board, then ask player 'n' to make a move */
 
@@ -128,16 +151,8 @@ int tictactoe(char board[ROWS][COLUMNS], int sd,struct sockaddr_in *serverAdd)
         {
             
             printf("Waiting for square selection from player 1..\n"); // gets chosen spot from player 1
-            struct timeval time;
-            time.tv_sec = 20;
-            time.tv_usec = 0;
-
-    if (setsockopt(sd, SOL_SOCKET, SO_RCVTIMEO, &time, sizeof(time)) < 0) {
-        printf("Error with setSocketopt\n");
-        printf("Closing connection!\n");
-        exit(1);
-    }
-            rc =recvfrom(sd,&player1,sizeof(player1),0,(struct sockaddr *)serverAdd,&fromLength);
+            // sends the last command again if the reply seems lost
+            rc = await_reply(sd, serverAdd, lastCommand, sentAt, &rtt, board, x ? gameNumber : 0, &player1);
             pick=player1.place;
             if(x==0){
             gameNumber=player1.gameNumber;
@@ -170,27 +185,19 @@ int tictactoe(char board[ROWS][COLUMNS], int sd,struct sockaddr_in *serverAdd)
         {
             printf("Player 2 picked: %d\n", choice);
         }
-        mark = (player == 1) ? 'X' : 'O'; //depending on who the player is, either us x or o
-        /******************************************************************/
-        /** little math here. you know the squares are numbered 1-9, but  */
-        /* the program is using 3 rows and 3 columns. We have to do some  */
-        /* simple math to conver a 1-9 to the right row/column            */
-        /******************************************************************/
-        row = (int)((choice - 1) / ROWS);
-        column = (choice - 1) % COLUMNS;
-
-        /* first check to see if the row/column chosen is has a digit in it, if it */
-        /* square 8 has and '8' then it is a valid choice                          */
+        /* first check to see if the square chosen is on the board and still open */
 
-        if (board[row][column] == (choice + '0'))
+        if (ttt_validate_move(variant, board, choice) == TTT_MOVE_VALID)
         {
-            board[row][column] = mark;
+            ttt_mark_square(board, choice, player); // player 1 is 'X', player 2 is 'O'
             // sends player 2 chioce if it is valid on the board
             if (player == 2)
             {
                 printf("version: %d, move %d, place %c, sd %d\n",player2.version,player2.move,player2.place,sd);
 
                 rc=sendto(sd,&player2,sizeof(player2),0,(struct sockaddr *)serverAdd,fromLength);
+                *lastCommand=player2; // kept to send again if the reply is lost
+                sentAt=now_ms();
                 if (rc<0 )
                 {
                     printf("%d\n",rc);
@@ -238,82 +245,142 @@ int tictactoe(char board[ROWS][COLUMNS], int sd,struct sockaddr_in *serverAdd)
     return 0;
 }
 
-int checkwin(char board[ROWS][COLUMNS])
+int checkwin(const struct TTT_Board *board)
 {
     /************************************************************************/
-    /* brute force check to see if someone won, or if there is a draw       */
-    /* return a 0 if the game is 'over' and return -1 if game should go on  */
+    /* check with the engine library to see if someone won, or if there is  */
+    /* a draw. return 1 if someone won, 0 if the game is a draw and -1 if   */
+    /* the game should go on                                                */
     /************************************************************************/
-    if (board[0][0] == board[0][1] && board[0][1] == board[0][2]) // row matches
-        return 1;
-
-    else if (board[1][0] == board[1][1] && board[1][1] == board[1][2]) // row matches
-        return 1;
-
-    else if (board[2][0] == board[2][1] && board[2][1] == board[2][2]) // row matches
-        return 1;
-
-    else if (board[0][0] == board[1][0] && board[1][0] == board[2][0]) // column
-        return 1;
+    const struct TTT_Variant *variant = ttt_get_variant(0);
 
-    else if (board[0][1] == board[1][1] && board[1][1] == board[2][1]) // column
+    if (ttt_check_win(variant, board) != 0) // a row, column or diagonal matches
         return 1;
 
-    else if (board[0][2] == board[1][2] && board[1][2] == board[2][2]) // column
-        return 1;
-
-    else if (board[0][0] == board[1][1] && board[1][1] == board[2][2]) // diagonal
-        return 1;
-
-    else if (board[2][0] == board[1][1] && board[1][1] == board[0][2]) // diagonal
-        return 1;
-
-    else if (board[0][0] != '1' && board[0][1] != '2' && board[0][2] != '3' &&
-             board[1][0] != '4' && board[1][1] != '5' && board[1][2] != '6' &&
-             board[2][0] != '7' && board[2][1] != '8' && board[2][2] != '9')
+    else if (ttt_check_draw(variant, board))
 
         return 0; // Return of 0 means game over
     else
         return -1; // return of -1 means keep playing
 }
 
-void print_board(char board[ROWS][COLUMNS])
+void print_board(const struct TTT_Board *board)
 {
     /*****************************************************************/
-    /* brute force print out the board and all the squares/values    */
+    /* print out the board and all the squares/values                */
     /*****************************************************************/
 
     printf("\n\n\n\tCurrent TicTacToe Game\n\n");
 
     printf("Player 1 (X)  -  Player 2 (O)\n\n\n");
 
-    printf("     |     |     \n");
-    printf("  %c  |  %c  |  %c \n", board[0][0], board[0][1], board[0][2]);
+    ttt_print_board(stdout, ttt_get_variant(0), board, 'X', 'O');
+}
 
-    printf("_____|_____|_____\n");
-    printf("     |     |     \n");
+int initSharedState(struct TTT_Board *board)
+{
+    /* this just initializing the shared state aka the board (no squares marked) */
+    printf("in sharedstate area\n");
+    board->marks[0] = board->marks[1] = 0;
 
-    printf("  %c  |  %c  |  %c \n", board[1][0], board[1][1], board[1][2]);
+    return 0;
+}
 
-    printf("_____|_____|_____\n");
-    printf("     |     |     \n");
+double now_ms()
+{
+    /* the monotonic clock in milliseconds, for timing round trips */
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+}
 
-    printf("  %c  |  %c  |  %c \n", board[2][0], board[2][1], board[2][2]);
+void rtt_update(struct rtt_estimator *rtt, double sample)
+{
+    /*****************************************************************/
+    /* fold a round trip measurement into the estimate (RFC 6298):   */
+    /* the first one sets the smoothed RTT, later ones are blended   */
+    /* in, and the timeout leaves room for four times the variation  */
+    /*****************************************************************/
+    double diff = rtt->srtt - sample;
 
-    printf("     |     |     \n\n");
+    if (rtt->samples++ == 0)
+    {
+        rtt->srtt = sample;
+        rtt->rttvar = sample / 2;
+    }
+    else
+    {
+        rtt->rttvar = 0.75 * rtt->rttvar + 0.25 * (diff < 0 ? -diff : diff);
+        rtt->srtt = 0.875 * rtt->srtt + 0.125 * sample;
+    }
+    rtt->rto = rtt->srtt + 4 * rtt->rttvar;
+    if (rtt->rto < MIN_RTO)
+        rtt->rto = MIN_RTO;
+    if (rtt->rto > MAX_RTO)
+        rtt->rto = MAX_RTO;
 }
 
-int initSharedState(char board[ROWS][COLUMNS])
+int await_reply(int sd, struct sockaddr_in *serverAdd, const struct buffer *command, double sentAt,
+                struct rtt_estimator *rtt, const struct TTT_Board *board, char gameNumber, struct buffer *reply)
 {
-    /* this just initializing the shared state aka the board */
-    int i, j, count = 1;
-    printf("in sharedstate area\n");
-    for (i = 0; i < 3; i++)
-        for (j = 0; j < 3; j++)
+    /*****************************************************************/
+    /* wait for the server's reply to the last command. each time    */
+    /* the retransmission timeout runs out the command is sent again */
+    /* and the timeout doubled. replies that were already seen (the  */
+    /* server answers a repeated command again) are skipped. returns */
+    /* the bytes received, or -1 with errno EAGAIN after GIVE_UP ms  */
+    /*****************************************************************/
+    const struct TTT_Variant *variant = ttt_get_variant(0);
+    double rto = rtt->rto, deadline = sentAt + rto, firstSent = sentAt;
+    int retransmitted = 0, rc;
+
+    while (1)
+    {
+        double wait = deadline - now_ms();
+        if (wait > 0)
         {
-            board[i][j] = count + '0';
-            count++;
+            socklen_t fromLength = sizeof(struct sockaddr);
+            struct timeval time;
+            time.tv_sec = (long)wait / 1000;
+            time.tv_usec = (long)(wait * 1000) % 1000000;
+            if (time.tv_sec == 0 && time.tv_usec == 0)
+                time.tv_usec = 1; // a zero timeout would wait forever
+            if (setsockopt(sd, SOL_SOCKET, SO_RCVTIMEO, &time, sizeof(time)) < 0)
+            {
+                printf("Error with setSocketopt\n");
+                printf("Closing connection!\n");
+                exit(1);
+            }
+            rc = recvfrom(sd, reply, sizeof(*reply), 0, (struct sockaddr *)serverAdd, &fromLength);
+            if (rc > 0)
+            {
+                // a second answer to a repeated command, or to a repeated NEW_GAME that opened another game
+                if (reply->version == 3 && reply->move != 0 &&
+                    ((gameNumber != 0 && reply->gameNumber != gameNumber) || ttt_validate_move(variant, board, reply->place - '0') == TTT_MOVE_TAKEN))
+                    continue;
+                // only commands sent once are timed (Karn's algorithm), a backed off timeout is kept until then
+                if (!retransmitted)
+                    rtt_update(rtt, now_ms() - sentAt);
+                else
+                    rtt->rto = rto;
+                return rc;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                return rc;
+            continue;
         }
-
-    return 0;
+        if (now_ms() - firstSent >= GIVE_UP)
+        {
+            errno = EAGAIN;
+            return -1;
+        }
+        // the command or its reply was lost: send it again and back off
+        printf("No reply within %.0f ms, sending the last command again\n", rto);
+        if (sendto(sd, command, sizeof(*command), 0, (struct sockaddr *)serverAdd, sizeof(struct sockaddr)) < 0)
+            return -1;
+        retransmitted = 1;
+        sentAt = now_ms();
+        rto = (rto * 2 > MAX_RTO) ? MAX_RTO : rto * 2;
+        deadline = sentAt + rto;
+    }
 }
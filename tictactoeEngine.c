@@ -0,0 +1,299 @@
+/***********************************************************/
+/* TicTacToe engine library (libttt): the rules and the    */
+/* search of every supported board variant. Every function */
+/* works only on the boards and contexts it is given, so   */
+/* the library is reentrant and never allocates memory.    */
+/***********************************************************/
+
+/* #include files go here */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "tictactoeEngine.h"
+
+/* The number of nodes searched between checks of the search time budget. */
+#define SEARCH_CHECK_NODES 1024
+
+/**
+ * @brief Counts a searched node and checks (every SEARCH_CHECK_NODES nodes) whether the
+ * search time budget has run out.
+ *
+ * @param ctx The search context.
+ * @return True if the search has been stopped, false otherwise.
+ */
+static inline int search_expired(struct Search_Context *ctx) {
+    if ((++ctx->nodes % SEARCH_CHECK_NODES) == 0 && ctx->deadline) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if ((uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec >= ctx->deadline) {
+            atomic_store_explicit(ctx->stop, 1, memory_order_relaxed);
+        }
+    }
+    return atomic_load_explicit(ctx->stop, memory_order_relaxed);
+}
+
+/* One unsigned value per board searched in lockstep (GCC vector extension). */
+typedef uint32_t ttt_lanes_u32 __attribute__((vector_size(4 * TTT_LANES)));
+/* One signed value, or lane mask (all ones for true), per board searched in lockstep. */
+typedef int32_t ttt_lanes_i32 __attribute__((vector_size(4 * TTT_LANES)));
+
+/**
+ * @brief Determines if any lane of a vector is nonzero.
+ *
+ * @param lanes The vector to test.
+ * @return True if some lane is nonzero, false otherwise.
+ */
+static inline int any_lane(ttt_lanes_u32 lanes) {
+    uint64_t words[TTT_LANES / 2], any = 0;
+    int i;
+    memcpy(words, &lanes, sizeof(words));
+    for (i = 0; i < TTT_LANES / 2; i++) any |= words[i];
+    return any != 0;
+}
+
+/**
+ * @brief Selects between two vectors lane by lane (vector comparisons give lane masks, and C
+ * has no vector conditional).
+ *
+ * @param mask The lane mask: all ones to take the lane of a, zero to take the lane of b.
+ * @param a The lanes taken where the mask is set.
+ * @param b The lanes taken where the mask is clear.
+ * @return The blended vector.
+ */
+static inline ttt_lanes_i32 blend_lanes(ttt_lanes_i32 mask, ttt_lanes_i32 a, ttt_lanes_i32 b) {
+    return (mask & a) | (~mask & b);
+}
+
+/* Generated win-line tables and engines specialized for each board variant */
+#include "tictactoeVariants.h"
+
+/**
+ * @brief Gets a board variant by the number the NEW_GAME command requests it by.
+ *
+ * @param id The variant number.
+ * @return The board variant, or NULL if there is no such variant.
+ */
+const struct TTT_Variant *ttt_get_variant(int id) {
+    return (id >= 0 && id < NUM_VARIANTS) ? &variants[id] : NULL;
+}
+
+/**
+ * @brief Determines if someone has won the game yet or not.
+ *
+ * @param variant The board variant.
+ * @param board The board to check.
+ * @return A positive score if Player 1 has won, a negative score if Player 2 has won, and
+ * 0 if the game is still going on.
+ */
+int ttt_check_win(const struct TTT_Variant *variant, const struct TTT_Board *board) {
+    return variant->check_win(board);
+}
+
+/**
+ * @brief Determines if there are moves left in the game to be made or not.
+ *
+ * @param variant The board variant.
+ * @param board The board to check.
+ * @return True if there are no moves left to be made, false otherwise.
+ */
+int ttt_check_draw(const struct TTT_Variant *variant, const struct TTT_Board *board) {
+    return variant->check_draw(board);
+}
+
+/**
+ * @brief Determines whether a move is legal (i.e. a square on the board) and valid (i.e.
+ * hasn't already been played).
+ *
+ * @param variant The board variant.
+ * @param board The board the move is made on.
+ * @param square The square (1-based) chosen.
+ * @return TTT_MOVE_VALID if the square can be marked, otherwise TTT_MOVE_OFF_BOARD or
+ * TTT_MOVE_TAKEN.
+ */
+int ttt_validate_move(const struct TTT_Variant *variant, const struct TTT_Board *board, int square) {
+    if (square < 1 || square > variant->squares) return TTT_MOVE_OFF_BOARD;
+    if ((board->marks[0] | board->marks[1]) & (1u << (square-1))) return TTT_MOVE_TAKEN;
+    return TTT_MOVE_VALID;
+}
+
+/**
+ * @brief Marks a square of a board for the given player.
+ *
+ * @param board The board to mark.
+ * @param square The square (1-based) to mark.
+ * @param player The player (1 or 2) marking the square.
+ */
+void ttt_mark_square(struct TTT_Board *board, int square, int player) {
+    board->marks[player-1] |= 1u << (square-1);
+}
+
+/**
+ * @brief Finds the optimal move for Player 1 with the minimax search specialized for the board
+ * variant (exhaustive on 3x3, to a fixed horizon on the larger boards).
+ *
+ * @param variant The board variant.
+ * @param board The board to search (Player 1 to move).
+ * @param score If not NULL, set to the minimax score of the optimal move.
+ * @return The optimal square (1-based) to play, or -1 if the board is full.
+ */
+int ttt_find_best_move(const struct TTT_Variant *variant, const struct TTT_Board *board, int *score) {
+    return variant->find_best_move(board, score);
+}
+
+/**
+ * @brief Finds the optimal move for Player 1 on each of a batch of boards, with the same results
+ * as ttt_find_best_move() gives on each one. The boards are searched TTT_LANES at a time in
+ * lockstep, most open squares first: a pass costs about as much as its largest tree alone, so
+ * the boards of similar size that share it are searched almost for free.
+ *
+ * @param variant The board variant (of every board).
+ * @param boards The boards to search (Player 1 to move).
+ * @param count The number of boards.
+ * @param moves Set to the optimal square (1-based) to play on each board, or -1 if it is full.
+ * @param scores If not NULL, set to the minimax score of the optimal move on each board.
+ * @return The number of lockstep passes made over the batch.
+ */
+int ttt_find_best_moves(const struct TTT_Variant *variant, const struct TTT_Board *boards, int count, int *moves, int *scores) {
+    struct TTT_Board lanes[TTT_LANES];
+    int open, i, lane, n = 0, seen = 0, passes = 0, index[TTT_LANES], laneMoves[TTT_LANES], laneScores[TTT_LANES];
+    for (open = variant->squares; open >= 0; open--) {
+        for (i = 0; i < count; i++) {
+            /* Add the boards with this many open squares to the pass */
+            if (variant->squares - __builtin_popcount(boards[i].marks[0] | boards[i].marks[1]) != open) continue;
+            index[n] = i;
+            lanes[n++] = boards[i];
+            /* Search the pass once it is full or holds the last board */
+            if (++seen < count && n < TTT_LANES) continue;
+            /* A lone board is searched faster without the lanes */
+            if (n == 1) laneMoves[0] = variant->find_best_move(&lanes[0], &laneScores[0]);
+            else variant->find_best_moves(lanes, n, laneMoves, laneScores);
+            for (lane = 0; lane < n; lane++) {
+                moves[index[lane]] = laneMoves[lane];
+                if (scores != NULL) scores[index[lane]] = laneScores[lane];
+            }
+            passes++;
+            n = 0;
+        }
+    }
+    return passes;
+}
+
+/**
+ * @brief Scores a single root move for Player 1 with an alpha-beta search to the given horizon.
+ * Searches of different root moves may share one bound and time budget through their contexts
+ * (this is how a parallel search splits its work).
+ *
+ * @param variant The board variant.
+ * @param board The board before the move.
+ * @param square The square (0-based) Player 1 plays.
+ * @param horizon The number of plies searched after the move.
+ * @param ctx The search context (shared bound, time budget and node count).
+ * @return The score of the move, or an upper bound on it if it is no better than the shared
+ * bound. The result is meaningless once the search has been stopped.
+ */
+int ttt_search_move(const struct TTT_Variant *variant, const struct TTT_Board *board, int square, int horizon, struct Search_Context *ctx) {
+    return variant->search_move(board, square, horizon, ctx);
+}
+
+/**
+ * @brief Packs a board in base 3, one digit per square with square 1 the least significant:
+ * 0 is open, 1 is Player 1 and 2 is Player 2. A 5x5 board fits in 40 bits.
+ *
+ * @param variant The board variant.
+ * @param board The board to pack.
+ * @return The packed board.
+ */
+uint64_t ttt_pack_board(const struct TTT_Variant *variant, const struct TTT_Board *board) {
+    int square;
+    uint64_t packed = 0;
+    for (square = variant->squares - 1; square >= 0; square--) {
+        packed = packed * 3 + ((board->marks[0] >> square) & 1) + 2 * ((board->marks[1] >> square) & 1);
+    }
+    return packed;
+}
+
+/**
+ * @brief Unpacks a board packed by ttt_pack_board().
+ *
+ * @param variant The board variant.
+ * @param packed The packed board.
+ * @param board The board to unpack into.
+ * @return 0 if the board was unpacked, or TTT_ERROR if it has digits beyond the last square.
+ */
+int ttt_unpack_board(const struct TTT_Variant *variant, uint64_t packed, struct TTT_Board *board) {
+    int square;
+    board->marks[0] = board->marks[1] = 0;
+    for (square = 0; square < variant->squares; square++) {
+        int digit = packed % 3;
+        if (digit != 0) board->marks[digit-1] |= 1u << square;
+        packed /= 3;
+    }
+    return (packed == 0) ? 0 : TTT_ERROR;
+}
+
+/**
+ * @brief Checks that a board can be reached in play and still has a move to make, and puts the
+ * player to move in the maximizer's (Player 1's) marks. Player 1 always moves first.
+ *
+ * @param variant The board variant.
+ * @param board The board to check (its marks are swapped if Player 2 is to move).
+ * @return 0 if the position can be analyzed, or TTT_ERROR if it cannot.
+ */
+int ttt_validate_position(const struct TTT_Variant *variant, struct TTT_Board *board) {
+    int p1Count = __builtin_popcount(board->marks[0]), p2Count = __builtin_popcount(board->marks[1]);
+    /* Player 1 has made as many moves as Player 2, or one more */
+    if (p1Count - p2Count != 0 && p1Count - p2Count != 1) return TTT_ERROR;
+    if (variant->check_win(board) != 0 || variant->check_draw(board)) return TTT_ERROR;
+    if (p1Count > p2Count) {
+        uint32_t marks = board->marks[0];
+        board->marks[0] = board->marks[1];
+        board->marks[1] = marks;
+    }
+    return 0;
+}
+
+/**
+ * @brief Finds the canonical form of a board under the symmetries of its variant (the image
+ * with the smallest packed value), so that all 8 rotations and reflections of a position can
+ * share one cache entry.
+ *
+ * @param variant The board variant.
+ * @param board The board to canonicalize.
+ * @param canonical Set to the canonical image of the board.
+ * @param symmetry Set to the symmetry that maps the board to its canonical image.
+ * @return The key of the canonical board (packed board and variant).
+ */
+uint64_t ttt_canonical_board(const struct TTT_Variant *variant, const struct TTT_Board *board, struct TTT_Board *canonical, int *symmetry) {
+    int t, square;
+    uint64_t best = UINT64_MAX;
+    for (t = 0; t < NUM_SYMMETRIES; t++) {
+        const unsigned char *map = &variant->symmetries[t * MAX_SQUARES];
+        struct TTT_Board image = {{0, 0}};
+        uint64_t packed;
+        /* Move every mark to its image under the symmetry */
+        for (square = 0; square < variant->squares; square++) {
+            if (board->marks[0] & (1u << square)) image.marks[0] |= 1u << map[square];
+            if (board->marks[1] & (1u << square)) image.marks[1] |= 1u << map[square];
+        }
+        if ((packed = ttt_pack_board(variant, &image)) < best) {
+            best = packed;
+            *canonical = image;
+            *symmetry = t;
+        }
+    }
+    return best | (uint64_t)variant->id << 40;
+}
+
+/**
+ * @brief Prints out a board nicely formatted. Open squares show their square number.
+ *
+ * @param out The stream to print to.
+ * @param variant The board variant.
+ * @param board The board to print.
+ * @param p1Mark The marker used for Player 1.
+ * @param p2Mark The marker used for Player 2.
+ */
+void ttt_print_board(FILE *out, const struct TTT_Variant *variant, const struct TTT_Board *board, char p1Mark, char p2Mark) {
+    variant->print_board(out, board, p1Mark, p2Mark);
+}
@@ -0,0 +1,76 @@
+/***********************************************************/
+/* TicTacToe engine library (libttt): the rules and the    */
+/* search of every supported board variant. Every function */
+/* works only on the boards and contexts it is given, so   */
+/* the library is reentrant and never allocates memory.    */
+/***********************************************************/
+
+#ifndef TICTACTOE_ENGINE_H
+#define TICTACTOE_ENGINE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+/* The number of supported board variants (checked against tictactoeGen's output). */
+#define NUM_VARIANTS 3
+/* The maximum number of squares on any supported board. */
+#define MAX_SQUARES 25
+/* The number of symmetries of each board. */
+#define NUM_SYMMETRIES 8
+/* The number of boards ttt_find_best_moves() searches in lockstep, one per vector lane. */
+#define TTT_LANES 4
+/* The value returned by a library function that failed. */
+#define TTT_ERROR -1
+
+/* The results of ttt_validate_move(). */
+#define TTT_MOVE_VALID 0        // the square is open
+#define TTT_MOVE_OFF_BOARD 1    // the square is not on the board
+#define TTT_MOVE_TAKEN 2        // the square has already been marked
+
+/* Structure for the state of a TicTacToe board (bit i of each mask is square i+1). */
+struct TTT_Board {
+    uint32_t marks[2];  // squares marked by Player 1 and Player 2
+};
+
+/* Structure for the state shared by the tasks of an alpha-beta search. */
+struct Search_Context {
+    atomic_int *alpha;      // best root score found by any task (shared cutoff bound)
+    atomic_int *stop;       // set once the time budget has run out
+    uint64_t deadline;      // CLOCK_MONOTONIC time (in nanoseconds) the search must stop by (0 for no budget)
+    uint64_t nodes;         // number of nodes searched with this context
+};
+
+/* Structure for the geometry and specialized engine of each board variant. */
+struct TTT_Variant {
+    int id;                     // variant number requested by the NEW_GAME command
+    const char *name;           // printable name of the variant
+    int rows;                   // number of rows on the board
+    int columns;                // number of columns on the board
+    int inARow;                 // number of marks in a row needed to win
+    int squares;                // number of squares on the board
+    const unsigned char *moveOrder; // squares (0-based) in the order moves are searched
+    int (*check_win)(const struct TTT_Board *board);
+    int (*check_draw)(const struct TTT_Board *board);
+    int (*find_best_move)(const struct TTT_Board *board, int *value);
+    int (*search_move)(const struct TTT_Board *board, int square, int horizon, struct Search_Context *ctx);
+    void (*print_board)(FILE *out, const struct TTT_Board *board, char p1Mark, char p2Mark);
+    const unsigned char *symmetries;    // square each square maps to under each symmetry (NUM_SYMMETRIES x MAX_SQUARES)
+    void (*find_best_moves)(const struct TTT_Board *boards, int count, int *moves, int *values);   // up to TTT_LANES boards in lockstep
+};
+
+const struct TTT_Variant *ttt_get_variant(int id);
+int ttt_check_win(const struct TTT_Variant *variant, const struct TTT_Board *board);
+int ttt_check_draw(const struct TTT_Variant *variant, const struct TTT_Board *board);
+int ttt_validate_move(const struct TTT_Variant *variant, const struct TTT_Board *board, int square);
+void ttt_mark_square(struct TTT_Board *board, int square, int player);
+int ttt_find_best_move(const struct TTT_Variant *variant, const struct TTT_Board *board, int *score);
+int ttt_find_best_moves(const struct TTT_Variant *variant, const struct TTT_Board *boards, int count, int *moves, int *scores);
+int ttt_search_move(const struct TTT_Variant *variant, const struct TTT_Board *board, int square, int horizon, struct Search_Context *ctx);
+uint64_t ttt_pack_board(const struct TTT_Variant *variant, const struct TTT_Board *board);
+int ttt_unpack_board(const struct TTT_Variant *variant, uint64_t packed, struct TTT_Board *board);
+int ttt_validate_position(const struct TTT_Variant *variant, struct TTT_Board *board);
+uint64_t ttt_canonical_board(const struct TTT_Variant *variant, const struct TTT_Board *board, struct TTT_Board *canonical, int *symmetry);
+void ttt_print_board(FILE *out, const struct TTT_Variant *variant, const struct TTT_Board *board, char p1Mark, char p2Mark);
+
+#endif
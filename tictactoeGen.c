@@ -0,0 +1,227 @@
+/***********************************************************/
+/* This program generates the compile-time constants for   */
+/* each supported TicTacToe board variant (win lines, move */
+/* ordering and unrolled win tests, scalar and across the  */
+/* lanes of a lockstep search) as a C header file, which   */
+/* is compiled into the engine library.                    */
+/***********************************************************/
+
+/* #include files go here */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+/* The maximum number of win lines on any supported board. */
+#define MAX_LINES 64
+/* The maximum number of squares on any supported board. */
+#define MAX_SQUARES 25
+/* The number of symmetries of a square board (4 rotations, each optionally mirrored). */
+#define NUM_SYMMETRIES 8
+
+/* Structure for the geometry of each board variant. */
+struct Variant_Spec {
+    const char *name;   // suffix used for the generated identifiers
+    int rows;           // number of rows on the board
+    int columns;        // number of columns on the board
+    int inARow;         // number of marks in a row needed to win
+    int maxDepth;       // number of plies searched after each candidate move
+};
+
+/* The supported board variants, in the order they are numbered by the NEW_GAME command. */
+static const struct Variant_Spec specs[] = {
+    {"3x3", 3, 3, 3, 9},
+    {"4x4", 4, 4, 4, 4},
+    {"5x5", 5, 5, 4, 3},
+};
+/* The number of supported board variants. */
+#define NUM_SPECS (int)(sizeof(specs) / sizeof(specs[0]))
+
+int find_win_lines(const struct Variant_Spec *spec, uint32_t lines[MAX_LINES]);
+void find_move_order(const struct Variant_Spec *spec, int order[MAX_SQUARES]);
+void find_symmetries(const struct Variant_Spec *spec, int symmetries[NUM_SYMMETRIES][MAX_SQUARES]);
+void print_line_test(const char *function, const char *type, const char *marksType, const char *test, const char *join, int numLines, const uint32_t lines[MAX_LINES], const char *name);
+void print_variant(int id, const struct Variant_Spec *spec);
+
+/**
+ * @brief Prints a C header containing the constants and specialized functions for each board
+ * variant to stdout.
+ *
+ * @return The value zero indicates successful termination.
+ */
+int main(void) {
+    int i;
+    printf("/* Generated by tictactoeGen. Do not edit. */\n\n");
+    printf("#ifndef TICTACTOE_VARIANTS_H\n#define TICTACTOE_VARIANTS_H\n\n");
+    /* The limits are part of the library's public header, so check they match the generated tables */
+    printf("#if NUM_VARIANTS != %d || MAX_SQUARES != %d || NUM_SYMMETRIES != %d\n", NUM_SPECS, MAX_SQUARES, NUM_SYMMETRIES);
+    printf("#error \"tictactoeEngine.h does not match the board variants generated by tictactoeGen\"\n#endif\n\n");
+    for (i = 0; i < NUM_SPECS; i++) print_variant(i, &specs[i]);
+    /* Table of every variant, indexed by the NEW_GAME variant number */
+    printf("/* The supported board variants, indexed by the NEW_GAME variant number. */\n");
+    printf("static const struct TTT_Variant variants[NUM_VARIANTS] = {\n");
+    for (i = 0; i < NUM_SPECS; i++) {
+        const char *n = specs[i].name;
+        printf("    {%d, \"%s\", %d, %d, %d, %d, moveOrder_%s, check_win_%s, check_draw_%s, find_best_move_%s,\n",
+            i, n, specs[i].rows, specs[i].columns, specs[i].inARow, specs[i].rows * specs[i].columns, n, n, n, n);
+        printf("        search_move_%s, print_board_%s, &symmetries_%s[0][0], find_best_moves_%s},\n", n, n, n, n);
+    }
+    printf("};\n\n#endif\n");
+    return 0;
+}
+
+/**
+ * @brief Finds every line of squares that wins a game of the given variant.
+ *
+ * @param spec The geometry of the board variant.
+ * @param lines The bitmasks of the squares in each winning line.
+ * @return The number of winning lines found.
+ */
+int find_win_lines(const struct Variant_Spec *spec, uint32_t lines[MAX_LINES]) {
+    /* Row, column, diagonal and anti-diagonal directions */
+    static const int dirs[4][2] = {{0, 1}, {1, 0}, {1, 1}, {1, -1}};
+    int d, row, column, i, count = 0;
+    for (d = 0; d < 4; d++) {
+        for (row = 0; row < spec->rows; row++) {
+            for (column = 0; column < spec->columns; column++) {
+                int endRow = row + dirs[d][0] * (spec->inARow - 1);
+                int endColumn = column + dirs[d][1] * (spec->inARow - 1);
+                uint32_t mask = 0;
+                /* Skip lines that run off the board */
+                if (endRow >= spec->rows || endColumn < 0 || endColumn >= spec->columns) continue;
+                for (i = 0; i < spec->inARow; i++) {
+                    mask |= 1u << ((row + dirs[d][0] * i) * spec->columns + column + dirs[d][1] * i);
+                }
+                lines[count++] = mask;
+            }
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Finds the order that moves are generated in for the given variant. The 3x3 board
+ * searches squares in numerical order; larger boards search the squares nearest the center
+ * first, since they take part in the most lines.
+ *
+ * @param spec The geometry of the board variant.
+ * @param order The squares (0-based) in the order they are searched.
+ */
+void find_move_order(const struct Variant_Spec *spec, int order[MAX_SQUARES]) {
+    int i, j, squares = spec->rows * spec->columns, distance[MAX_SQUARES];
+    for (i = 0; i < squares; i++) {
+        int dr = 2 * (i / spec->columns) - (spec->rows - 1), dc = 2 * (i % spec->columns) - (spec->columns - 1);
+        distance[i] = (spec->rows == 3 && spec->columns == 3) ? 0 : dr * dr + dc * dc;
+        order[i] = i;
+    }
+    /* Stable insertion sort by distance from the center */
+    for (i = 1; i < squares; i++) {
+        for (j = i; j > 0 && distance[order[j]] < distance[order[j-1]]; j--) {
+            int tmp = order[j];
+            order[j] = order[j-1];
+            order[j-1] = tmp;
+        }
+    }
+}
+
+/**
+ * @brief Finds where each square of the given variant moves under each symmetry of the board.
+ * Symmetries that do not apply to a rectangular board are left as the identity.
+ *
+ * @param spec The geometry of the board variant.
+ * @param symmetries The square (0-based) each square is mapped to by each symmetry.
+ */
+void find_symmetries(const struct Variant_Spec *spec, int symmetries[NUM_SYMMETRIES][MAX_SQUARES]) {
+    int t, square, squares = spec->rows * spec->columns, n = spec->rows - 1, m = spec->columns - 1;
+    for (t = 0; t < NUM_SYMMETRIES; t++) {
+        for (square = 0; square < squares; square++) {
+            int r = square / spec->columns, c = square % spec->columns, tr = r, tc = c;
+            /* Mirror and transpose images only stay on the board if it is square */
+            switch ((spec->rows == spec->columns || t == 2 || t == 4 || t == 5) ? t : 0) {
+                case 1: tr = c; tc = n - r; break;      // rotate 90 degrees
+                case 2: tr = n - r; tc = m - c; break;  // rotate 180 degrees
+                case 3: tr = m - c; tc = r; break;      // rotate 270 degrees
+                case 4: tc = m - c; break;              // mirror left to right
+                case 5: tr = n - r; break;              // mirror top to bottom
+                case 6: tr = c; tc = r; break;          // transpose
+                case 7: tr = m - c; tc = n - r; break;  // anti-transpose
+            }
+            symmetries[t][square] = tr * spec->columns + tc;
+        }
+    }
+}
+
+/**
+ * @brief Prints a branch-free function that applies a test to every win line of a variant.
+ *
+ * @param function The name of the function (without the variant suffix).
+ * @param type The return type of the function.
+ * @param marksType The type of the marks tested.
+ * @param test The format of the test applied to the marks for each line, given the line mask.
+ * @param join The operator used to combine the tests of each line.
+ * @param numLines The number of win lines.
+ * @param lines The bitmasks of the squares in each winning line.
+ * @param name The variant suffix.
+ */
+void print_line_test(const char *function, const char *type, const char *marksType, const char *test, const char *join, int numLines, const uint32_t lines[MAX_LINES], const char *name) {
+    int i;
+    printf("static inline %s %s_%s(%s marks) {\n    return", type, function, name, marksType);
+    for (i = 0; i < numLines; i++) {
+        if (i == 0) printf(" ");
+        else printf("\n        %s ", join);
+        printf(test, lines[i], lines[i]);
+    }
+    printf(";\n}\n");
+}
+
+/**
+ * @brief Prints the constants for a variant followed by an inclusion of the specialized engine
+ * template for that variant.
+ *
+ * @param id The variant number.
+ * @param spec The geometry of the board variant.
+ */
+void print_variant(int id, const struct Variant_Spec *spec) {
+    uint32_t lines[MAX_LINES], searchLines[MAX_LINES];
+    int i, t, order[MAX_SQUARES], symmetries[NUM_SYMMETRIES][MAX_SQUARES], squares = spec->rows * spec->columns;
+    int numLines = find_win_lines(spec, lines);
+    /* Win scores must dominate the open-line evaluation used if the search has a horizon */
+    int winScore = (spec->maxDepth + 1 >= squares || squares > numLines + spec->maxDepth) ? squares + 1 : numLines + spec->maxDepth + 1;
+    find_move_order(spec, order);
+    find_symmetries(spec, symmetries);
+    /* The lockstep search holds boards in search order: bit i is the i-th square searched */
+    for (t = 0; t < numLines; t++) {
+        searchLines[t] = 0;
+        for (i = 0; i < squares; i++) {
+            if (lines[t] & (1u << order[i])) searchLines[t] |= 1u << i;
+        }
+    }
+
+    printf("/*****************************************/\n");
+    printf("/* %dx%d board, %d in a row wins (variant %d) */\n", spec->rows, spec->columns, spec->inARow, id);
+    printf("/*****************************************/\n\n");
+    printf("/* The squares of the board in the order moves are searched. */\n");
+    printf("static const unsigned char moveOrder_%s[%d] = {", spec->name, squares);
+    for (i = 0; i < squares; i++) printf((i == 0) ? "%d" : ", %d", order[i]);
+    printf("};\n\n/* The square each square is mapped to by each symmetry of the board. */\n");
+    printf("static const unsigned char symmetries_%s[NUM_SYMMETRIES][MAX_SQUARES] = {\n", spec->name);
+    for (t = 0; t < NUM_SYMMETRIES; t++) {
+        printf("    {");
+        for (i = 0; i < squares; i++) printf((i == 0) ? "%d" : ", %d", symmetries[t][i]);
+        printf("},\n");
+    }
+    printf("};\n\n/* Whether the given marks complete any win line. */\n");
+    print_line_test("has_line", "int", "uint32_t", "((marks & 0x%07xu) == 0x%07xu)", "|", numLines, lines, spec->name);
+    printf("\n/* The number of win lines the given marks do not touch. */\n");
+    print_line_test("open_lines", "int", "uint32_t", "((marks & 0x%07xu) == 0)", "+", numLines, lines, spec->name);
+    printf("\n/* Whether the given marks (in search order, one board per lane) complete any win line (all ones if so). */\n");
+    print_line_test("has_line_lanes", "ttt_lanes_i32", "ttt_lanes_u32", "((marks & 0x%07xu) == 0x%07xu)", "|", numLines, searchLines, spec->name);
+    printf("\n/* The number of win lines the given marks (in search order, one board per lane) do not touch. */\n");
+    print_line_test("open_lines_lanes", "ttt_lanes_i32", "ttt_lanes_u32", "-((marks & 0x%07xu) == 0)", "+", numLines, searchLines, spec->name);
+    printf("\n#define VARIANT %s\n", spec->name);
+    printf("#define VARIANT_ROWS %d\n#define VARIANT_COLUMNS %d\n#define VARIANT_SQUARES %d\n", spec->rows, spec->columns, squares);
+    printf("#define VARIANT_FULL 0x%07xu\n", (uint32_t)((1ull << squares) - 1));
+    printf("#define VARIANT_WIN_SCORE %d\n#define VARIANT_MAX_DEPTH %d\n", winScore, spec->maxDepth);
+    printf("#include \"tictactoeVariant.h\"\n");
+    printf("#undef VARIANT\n#undef VARIANT_ROWS\n#undef VARIANT_COLUMNS\n#undef VARIANT_SQUARES\n");
+    printf("#undef VARIANT_FULL\n#undef VARIANT_WIN_SCORE\n#undef VARIANT_MAX_DEPTH\n\n");
+}
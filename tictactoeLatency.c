@@ -0,0 +1,261 @@
+/***********************************************************/
+/* This program measures the round-trip latency of the     */
+/* TicTacToe server. It sends paced ANALYZE commands for a */
+/* cached position (so the search is not measured) over    */
+/* UDP, the shared-memory or the stream transport and     */
+/* reports the latency percentiles from an HDR histogram.  */
+/***********************************************************/
+
+/* #include files go here */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "tictactoeTrace.h"
+#include "tictactoeShm.h"
+#include "tictactoeStream.h"
+
+/* The protocol version number used. */
+#define VERSION 3
+/* The command to analyze a board without playing a game. */
+#define ANALYZE 0x02
+/* The number of command line arguments (excluding options). */
+#define NUM_ARGS 3
+/* The default number of commands sent. */
+#define DEFAULT_COUNT 10000
+/* The default number of commands sent per second. */
+#define DEFAULT_RATE 1000
+/* The number of commands sent before measuring (fills the position cache). */
+#define WARMUP 100
+/* The number of seconds to wait for a reply before counting the command as lost. */
+#define TIMEOUT 1
+/* The board analyzed, packed in base 3 (X on square 5 and O on square 1, X to move). */
+#define BOARD 83
+
+/* Structure to send and recieve datagrams (must match the server's ANALYZE layout). */
+struct Analyze_Datagram {
+    char version;       // version number
+    char command;       // player command
+    char data;          // board variant (request) or best move (reply)
+    char gameNum;       // sequence tag echoed by the server
+    uint32_t words[2];  // packed board (request) or score (reply), network byte order
+};
+
+void print_error(const char *msg, int errnum, int terminate);
+void handle_init_error(const char *msg, int errnum);
+void extract_args(int argc, char *argv[], struct sockaddr_in *serverAddr, const char **shmPath, const char **streamAddress, int *count, int *rate);
+int send_request(int sd, const struct sockaddr_in *serverAddr, struct Shm_Endpoint *shm, struct Stream_Conn *stream, const struct Analyze_Datagram *request);
+int receive_reply(int sd, struct Shm_Endpoint *shm, struct Stream_Conn *stream, struct Analyze_Datagram *reply);
+int run_latency_test(int sd, const struct sockaddr_in *serverAddr, struct Shm_Endpoint *shm, struct Stream_Conn *stream, int count, int rate, struct HDR_Histogram *hist);
+
+/**
+ * @brief This program measures the round-trip latency of a TicTacToe server, e.g. to compare
+ * the server's default mode with its low-latency mode (-L), or UDP with the shared-memory
+ * (-u) and stream (-S) transports.
+ *
+ * @param argc Non-negative value representing the number of arguments passed to the program.
+ * @param argv The arguments passed to the program.
+ * @return The value zero indicates successful termination.
+ */
+int main(int argc, char *argv[]) {
+    int sd, count = DEFAULT_COUNT, rate = DEFAULT_RATE, lost;
+    const char *shmPath = NULL, *streamAddress = NULL;
+    struct sockaddr_in serverAddr = {0};
+    struct timeval timeout = {TIMEOUT, 0};
+    struct Shm_Endpoint endpoint, *shm = NULL;
+    static struct Stream_Conn conn;
+    struct Stream_Conn *stream = NULL;
+    static struct HDR_Histogram hist;
+
+    /* Extract options and arguments to their respective variables */
+    extract_args(argc, argv, &serverAddr, &shmPath, &streamAddress, &count, &rate);
+
+    /* Connect to the server over shared memory or a stream, or create the socket used to talk to it */
+    if (shmPath != NULL) {
+        if (shm_connect(shmPath, &endpoint) < 0) print_error("shm_connect", errno, 1);
+        shm = &endpoint;
+        sd = -1;
+    } else if (streamAddress != NULL) {
+        if (stream_connect(streamAddress, &conn) < 0) print_error("stream_connect", errno, 1);
+        stream = &conn;
+        sd = -1;
+    } else {
+        if ((sd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) print_error("socket", errno, 1);
+        if (setsockopt(sd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0) print_error("setsockopt", errno, 1);
+    }
+
+    /* Warm up the server's position cache, then measure */
+    hdr_init(&hist);
+    if (run_latency_test(sd, &serverAddr, shm, stream, WARMUP, rate, &hist) == WARMUP) print_error("No replies from the server", 0, 1);
+    hdr_init(&hist);
+    lost = run_latency_test(sd, &serverAddr, shm, stream, count, rate, &hist);
+
+    /* Print the latency percentiles (in microseconds) */
+    printf("%d commands at %d/s, %d lost\n", count, rate, lost);
+    printf("%9s %9s %9s %9s %9s %9s %9s\n", "min", "p50", "p90", "p99", "p99.9", "p99.99", "max");
+    printf("%9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n", hist.min / 1000.0,
+        hdr_percentile(&hist, 50) / 1000.0, hdr_percentile(&hist, 90) / 1000.0,
+        hdr_percentile(&hist, 99) / 1000.0, hdr_percentile(&hist, 99.9) / 1000.0,
+        hdr_percentile(&hist, 99.99) / 1000.0, hist.max / 1000.0);
+    if (shm != NULL) shm_close(shm);
+    else if (stream != NULL) stream_close(stream);
+    else close(sd);
+    return 0;
+}
+
+/**
+ * @brief Prints the provided error message and corresponding errno message (if present) and
+ * terminates the process if asked to do so.
+ *
+ * @param msg The error description message to display.
+ * @param errnum This is the error number, usually errno.
+ * @param terminate Whether or not the process should be terminated.
+ */
+void print_error(const char *msg, int errnum, int terminate) {
+    if (errnum) {
+        printf("ERROR: %s: %s\n", msg, strerror(errnum));
+    } else {
+        printf("ERROR: %s\n", msg);
+    }
+    if (terminate) exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Prints a string describing the initialization error, the correct command usage, and
+ * exits the process signaling unsuccessful termination.
+ *
+ * @param msg The error description message to display.
+ * @param errnum This is the error number, usually errno.
+ */
+void handle_init_error(const char *msg, int errnum) {
+    print_error(msg, errnum, 0);
+    printf("Usage is: tictactoeLatency [-n <count>] [-r <rate>] <server-ip> <server-port>\n");
+    printf("      or: tictactoeLatency [-n <count>] [-r <rate>] -u <socket-path>\n");
+    printf("      or: tictactoeLatency [-n <count>] [-r <rate>] -S <[server-ip:]server-port|socket-path>\n");
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Extracts the user provided arguments and performs validation on their formatting. If
+ * any errors are found, the function terminates the process.
+ *
+ * @param argc The number of arguments passed to the program.
+ * @param argv The arguments passed to the program.
+ * @param serverAddr The address of the server.
+ * @param shmPath Set to the server's shared-memory socket path if -u is given.
+ * @param streamAddress Set to the server's stream address if -S is given.
+ * @param count The number of commands to send.
+ * @param rate The number of commands to send per second.
+ */
+void extract_args(int argc, char *argv[], struct sockaddr_in *serverAddr, const char **shmPath, const char **streamAddress, int *count, int *rate) {
+    int opt, port;
+    while ((opt = getopt(argc, argv, "n:r:u:S:")) != -1) {
+        switch (opt) {
+            case 'n':   // number of commands to send
+                if ((*count = strtol(optarg, NULL, 10)) < 1) handle_init_error("-n: Invalid count", 0);
+                break;
+            case 'r':   // commands sent per second
+                if ((*rate = strtol(optarg, NULL, 10)) < 1) handle_init_error("-r: Invalid rate", 0);
+                break;
+            case 'u':   // talk to the server over the shared-memory transport
+                *shmPath = optarg;
+                break;
+            case 'S':   // talk to the server over the stream transport
+                *streamAddress = optarg;
+                break;
+            default:
+                handle_init_error("Invalid option", 0);
+        }
+    }
+    if (*shmPath != NULL || *streamAddress != NULL) {
+        if (argc - optind != 0) handle_init_error("argc: Invalid number of command line arguments", 0);
+        return;
+    }
+    if (argc - optind + 1 != NUM_ARGS) handle_init_error("argc: Invalid number of command line arguments", 0);
+    serverAddr->sin_family = AF_INET;
+    if (inet_pton(AF_INET, argv[optind], &serverAddr->sin_addr) != 1) handle_init_error("server-ip: Invalid IP address", 0);
+    port = strtol(argv[optind + 1], NULL, 10);
+    if (port < 1 || port != (u_int16_t)port) handle_init_error("server-port: Invalid port number", 0);
+    serverAddr->sin_port = htons(port);
+}
+
+/**
+ * @brief Sends a command to the server over UDP, shared memory or a stream.
+ *
+ * @param sd The socket descriptor used to talk to the server (UDP).
+ * @param serverAddr The address of the server (UDP).
+ * @param shm The shared-memory connection to the server, or NULL.
+ * @param stream The stream connection to the server, or NULL.
+ * @param request The command to send.
+ * @return The number of bytes sent, or -1 if there was an error (errno is set).
+ */
+int send_request(int sd, const struct sockaddr_in *serverAddr, struct Shm_Endpoint *shm, struct Stream_Conn *stream, const struct Analyze_Datagram *request) {
+    if (shm != NULL) return shm_send(shm, request, sizeof(struct Analyze_Datagram));
+    if (stream != NULL) return stream_send(stream, request, sizeof(struct Analyze_Datagram));
+    return sendto(sd, request, sizeof(struct Analyze_Datagram), 0, (const struct sockaddr *)serverAddr, sizeof(struct sockaddr_in));
+}
+
+/**
+ * @brief Receives a reply from the server over UDP, shared memory or a stream, waiting up to
+ * TIMEOUT seconds.
+ *
+ * @param sd The socket descriptor used to talk to the server (UDP).
+ * @param shm The shared-memory connection to the server, or NULL.
+ * @param stream The stream connection to the server, or NULL.
+ * @param reply Set to the reply.
+ * @return True if a reply was received, false otherwise.
+ */
+int receive_reply(int sd, struct Shm_Endpoint *shm, struct Stream_Conn *stream, struct Analyze_Datagram *reply) {
+    if (shm != NULL) return shm_receive(shm, reply, sizeof(struct Analyze_Datagram), TIMEOUT * 1000) > 0;
+    if (stream != NULL) return stream_receive(stream, reply, sizeof(struct Analyze_Datagram), TIMEOUT * 1000) > 0;
+    return recv(sd, reply, sizeof(struct Analyze_Datagram), 0) >= 0;
+}
+
+/**
+ * @brief Sends ANALYZE commands at a fixed rate, waiting for each reply, and records each
+ * round-trip time. Commands are paced from a fixed schedule, so a slow reply does not hide the
+ * delay of the commands behind it.
+ *
+ * @param sd The socket descriptor used to talk to the server.
+ * @param serverAddr The address of the server.
+ * @param shm The shared-memory connection to the server, or NULL.
+ * @param stream The stream connection to the server, or NULL.
+ * @param count The number of commands to send.
+ * @param rate The number of commands to send per second.
+ * @param hist The histogram the round-trip times (in nanoseconds) are recorded in.
+ * @return The number of commands that got no reply.
+ */
+int run_latency_test(int sd, const struct sockaddr_in *serverAddr, struct Shm_Endpoint *shm, struct Stream_Conn *stream, int count, int rate, struct HDR_Histogram *hist) {
+    int i, lost = 0;
+    uint64_t interval = 1000000000ULL / rate, next = trace_clock();
+    for (i = 0; i < count; i++) {
+        struct Analyze_Datagram request = {VERSION, ANALYZE, 0, (char)i, {0, htonl(BOARD)}}, reply;
+        struct timespec wait;
+        uint64_t start;
+        int received = 0;
+        /* Sleep until the command is due */
+        next += interval;
+        if ((start = trace_clock()) < next) {
+            wait.tv_sec = (next - start) / 1000000000ULL;
+            wait.tv_nsec = (next - start) % 1000000000ULL;
+            nanosleep(&wait, NULL);
+        }
+        start = trace_clock();
+        if (send_request(sd, serverAddr, shm, stream, &request) < 0) print_error("send_request", errno, 1);
+        /* Wait for the reply to this command (skipping late replies to earlier ones) */
+        while (!received && receive_reply(sd, shm, stream, &reply)) received = (reply.gameNum == request.gameNum);
+        if (received) {
+            hdr_record(hist, trace_clock() - start);
+        } else {
+            lost++;
+        }
+    }
+    return lost;
+}
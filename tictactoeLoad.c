@@ -0,0 +1,362 @@
+/***********************************************************/
+/* This program puts a mixed load on the TicTacToe server: */
+/* players keep 3x3 games going while bursts of NEW_GAME   */
+/* commands arrive from another source. It reports how     */
+/* long the players' moves waited and how many of their    */
+/* games timed out behind the bursts.                      */
+/***********************************************************/
+
+/* #include files go here */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "tictactoeTrace.h"
+#include "tictactoeEngine.h"
+
+/* The protocol version number used. */
+#define VERSION 3
+/* The command to begin a new game. */
+#define NEW_GAME 0x00
+/* The command to issue a move. */
+#define MOVE 0x01
+/* The number of command line arguments (excluding options). */
+#define NUM_ARGS 3
+/* The maximum number of players keeping games going. */
+#define MAX_PLAYERS 64
+/* The default number of players keeping games going. */
+#define DEFAULT_PLAYERS 4
+/* The default number of NEW_GAME commands in each burst. */
+#define DEFAULT_BURST 16
+/* The default board variant of the burst games (4x4). */
+#define DEFAULT_VARIANT 1
+/* The default number of seconds between bursts. */
+#define DEFAULT_INTERVAL 5
+/* The default number of seconds the load runs for. */
+#define DEFAULT_DURATION 30
+/* The default number of seconds a move may go unanswered (the server's game timeout). */
+#define DEFAULT_TIMEOUT 30
+/* The number of milliseconds between checks for unanswered commands. */
+#define POLL_INTERVAL 10
+
+/* Structure to send and recieve datagrams. */
+struct Buffer {
+    char version;   // version number
+    char command;   // player command
+    char data;      // data for command if applicable
+    char gameNum;   // game number
+};
+
+/* Structure for a player keeping a game going. */
+struct Load_Player {
+    int sd;                 // socket the player sends from (its own source address)
+    int gameNum;            // game number the server gave the game (0 until the first reply)
+    struct TTT_Board board; // board of the game (the server is Player 1)
+    uint64_t sent;          // trace_clock() time the unanswered command was sent
+    int command;            // command waiting for an answer
+    uint32_t random;        // state of the player's move generator
+};
+
+/* Structure for the options of the load. */
+struct Load_Options {
+    int players;        // number of players keeping games going
+    int burst;          // number of NEW_GAME commands in each burst
+    int variant;        // board variant of the burst games
+    int interval;       // seconds between bursts
+    int duration;       // seconds the load runs for
+    int timeout;        // seconds a command may go unanswered
+};
+
+/* Structure for the results of the load. */
+struct Load_Results {
+    uint64_t moves;         // moves answered
+    uint64_t finished;      // games played to the end
+    uint64_t timedOut;      // moves left unanswered past the timeout
+    uint64_t unanswered;    // NEW_GAME commands of the players left unanswered past the timeout
+    uint64_t burstSent;     // NEW_GAME commands sent in bursts
+    struct HDR_Histogram moveLatency;   // latency of the answered moves
+};
+
+void print_error(const char *msg, int errnum, int terminate);
+void handle_init_error(const char *msg, int errnum);
+void extract_args(int argc, char *argv[], struct sockaddr_in *serverAddr, struct Load_Options *options);
+int open_socket(void);
+void send_command(int sd, const struct sockaddr_in *serverAddr, int command, int data, int gameNum);
+void start_game(struct Load_Player *player, const struct sockaddr_in *serverAddr);
+void play_reply(struct Load_Player *player, const struct sockaddr_in *serverAddr, struct Load_Results *results);
+void send_burst(int sd, const struct sockaddr_in *serverAddr, const struct Load_Options *options, struct Load_Results *results);
+void run_load(const struct sockaddr_in *serverAddr, const struct Load_Options *options, struct Load_Results *results);
+
+/**
+ * @brief This program measures how well the server keeps games in progress moving while new
+ * games keep arriving, e.g. to compare server builds or options under the same mixed load.
+ *
+ * @param argc Non-negative value representing the number of arguments passed to the program.
+ * @param argv The arguments passed to the program.
+ * @return The value zero indicates successful termination.
+ */
+int main(int argc, char *argv[]) {
+    struct sockaddr_in serverAddr = {0};
+    struct Load_Options options = {DEFAULT_PLAYERS, DEFAULT_BURST, DEFAULT_VARIANT, DEFAULT_INTERVAL, DEFAULT_DURATION, DEFAULT_TIMEOUT};
+    static struct Load_Results results;
+
+    /* Extract options and arguments to their respective variables */
+    extract_args(argc, argv, &serverAddr, &options);
+
+    /* Run the load */
+    hdr_init(&results.moveLatency);
+    run_load(&serverAddr, &options, &results);
+
+    /* Print the results (latencies in milliseconds) */
+    printf("%d players, bursts of %d NEW_GAME (%s) every %d s for %d s, %d s timeout\n", options.players, options.burst,
+        ttt_get_variant(options.variant)->name, options.interval, options.duration, options.timeout);
+    printf("%9s %9s %9s %11s %11s\n", "moves", "finished", "timed out", "unanswered", "burst sent");
+    printf("%9llu %9llu %9llu %11llu %11llu\n", (unsigned long long)results.moves, (unsigned long long)results.finished,
+        (unsigned long long)results.timedOut, (unsigned long long)results.unanswered, (unsigned long long)results.burstSent);
+    if (results.moves == 0) return 0;
+    printf("move latency (ms)\n%9s %9s %9s %9s %9s\n", "min", "p50", "p90", "p99", "max");
+    printf("%9.1f %9.1f %9.1f %9.1f %9.1f\n", results.moveLatency.min / 1e6, hdr_percentile(&results.moveLatency, 50) / 1e6,
+        hdr_percentile(&results.moveLatency, 90) / 1e6, hdr_percentile(&results.moveLatency, 99) / 1e6,
+        results.moveLatency.max / 1e6);
+    return 0;
+}
+
+/**
+ * @brief Prints the provided error message and corresponding errno message (if present) and
+ * terminates the process if asked to do so.
+ *
+ * @param msg The error description message to display.
+ * @param errnum This is the error number, usually errno.
+ * @param terminate Whether or not the process should be terminated.
+ */
+void print_error(const char *msg, int errnum, int terminate) {
+    if (errnum) {
+        printf("ERROR: %s: %s\n", msg, strerror(errnum));
+    } else {
+        printf("ERROR: %s\n", msg);
+    }
+    if (terminate) exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Prints a string describing the initialization error, the correct command usage, and
+ * exits the process signaling unsuccessful termination.
+ *
+ * @param msg The error description message to display.
+ * @param errnum This is the error number, usually errno.
+ */
+void handle_init_error(const char *msg, int errnum) {
+    print_error(msg, errnum, 0);
+    printf("Usage is: tictactoeLoad [-g <games>] [-b <burst>] [-v <variant>] [-i <interval>] [-d <duration>] [-T <timeout>] <server-ip> <server-port>\n");
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Extracts the user provided arguments and performs validation on their formatting. If
+ * any errors are found, the function terminates the process.
+ *
+ * @param argc The number of arguments passed to the program.
+ * @param argv The arguments passed to the program.
+ * @param serverAddr The address of the server.
+ * @param options The options of the load.
+ */
+void extract_args(int argc, char *argv[], struct sockaddr_in *serverAddr, struct Load_Options *options) {
+    int opt, port;
+    while ((opt = getopt(argc, argv, "g:b:v:i:d:T:")) != -1) {
+        switch (opt) {
+            case 'g':   // players keeping games going
+                options->players = strtol(optarg, NULL, 10);
+                if (options->players < 1 || options->players > MAX_PLAYERS) handle_init_error("-g: Invalid number of games", 0);
+                break;
+            case 'b':   // NEW_GAME commands per burst
+                if ((options->burst = strtol(optarg, NULL, 10)) < 0) handle_init_error("-b: Invalid burst size", 0);
+                break;
+            case 'v':   // board variant of the burst games
+                options->variant = strtol(optarg, NULL, 10);
+                if (ttt_get_variant(options->variant) == NULL) handle_init_error("-v: Invalid board variant", 0);
+                break;
+            case 'i':   // seconds between bursts
+                if ((options->interval = strtol(optarg, NULL, 10)) < 1) handle_init_error("-i: Invalid interval", 0);
+                break;
+            case 'd':   // seconds the load runs for
+                if ((options->duration = strtol(optarg, NULL, 10)) < 1) handle_init_error("-d: Invalid duration", 0);
+                break;
+            case 'T':   // seconds a command may go unanswered
+                if ((options->timeout = strtol(optarg, NULL, 10)) < 1) handle_init_error("-T: Invalid timeout", 0);
+                break;
+            default:
+                handle_init_error("Invalid option", 0);
+        }
+    }
+    if (argc - optind + 1 != NUM_ARGS) handle_init_error("argc: Invalid number of command line arguments", 0);
+    serverAddr->sin_family = AF_INET;
+    if (inet_pton(AF_INET, argv[optind], &serverAddr->sin_addr) != 1) handle_init_error("server-ip: Invalid IP address", 0);
+    port = strtol(argv[optind + 1], NULL, 10);
+    if (port < 1 || port != (u_int16_t)port) handle_init_error("server-port: Invalid port number", 0);
+    serverAddr->sin_port = htons(port);
+}
+
+/**
+ * @brief Creates a UDP socket (a new source address for the server). If the socket cannot be
+ * created, the function terminates the process.
+ *
+ * @return The socket descriptor.
+ */
+int open_socket(void) {
+    int sd;
+    if ((sd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) print_error("socket", errno, 1);
+    return sd;
+}
+
+/**
+ * @brief Sends a command to the server.
+ *
+ * @param sd The socket descriptor to send from.
+ * @param serverAddr The address of the server.
+ * @param command The command to send.
+ * @param data The data of the command (board variant or square).
+ * @param gameNum The game number of the command.
+ */
+void send_command(int sd, const struct sockaddr_in *serverAddr, int command, int data, int gameNum) {
+    struct Buffer datagram = {VERSION, command, data, gameNum};
+    if (sendto(sd, &datagram, sizeof(datagram), 0, (const struct sockaddr *)serverAddr, sizeof(struct sockaddr_in)) < 0) {
+        print_error("sendto", errno, 0);
+    }
+}
+
+/**
+ * @brief Starts a new 3x3 game for a player.
+ *
+ * @param player The player.
+ * @param serverAddr The address of the server.
+ */
+void start_game(struct Load_Player *player, const struct sockaddr_in *serverAddr) {
+    player->gameNum = 0;
+    player->board.marks[0] = player->board.marks[1] = 0;
+    player->command = NEW_GAME;
+    player->sent = trace_clock();
+    send_command(player->sd, serverAddr, NEW_GAME, 0, 0);
+}
+
+/**
+ * @brief Receives the server's move for a player and answers it with a random open square,
+ * starting a new game once the game is over.
+ *
+ * @param player The player.
+ * @param serverAddr The address of the server.
+ * @param results The results of the load.
+ */
+void play_reply(struct Load_Player *player, const struct sockaddr_in *serverAddr, struct Load_Results *results) {
+    const struct TTT_Variant *variant = ttt_get_variant(0);
+    struct Buffer reply;
+    int square;
+    if (recv(player->sd, &reply, sizeof(reply), MSG_DONTWAIT) != sizeof(reply) || reply.version != VERSION || reply.command != MOVE) return;
+    /* Ignore replies for earlier games and replies nobody is waiting for */
+    if (player->sent == 0 || (player->gameNum != 0 && reply.gameNum != player->gameNum)) return;
+    if (player->command == MOVE) {
+        hdr_record(&results->moveLatency, trace_clock() - player->sent);
+        results->moves++;
+    }
+    player->gameNum = reply.gameNum;
+    player->sent = 0;
+    /* Play the server's move */
+    if (ttt_validate_move(variant, &player->board, reply.data - '0') != TTT_MOVE_VALID) return;
+    ttt_mark_square(&player->board, reply.data - '0', 1);
+    if (ttt_check_win(variant, &player->board) != 0 || ttt_check_draw(variant, &player->board)) {
+        results->finished++;
+        start_game(player, serverAddr);
+        return;
+    }
+    /* Answer it with a random open square (the server does not answer a move that ends the game) */
+    do {
+        player->random = player->random * 1103515245 + 12345;
+        square = (player->random >> 16) % variant->squares + 1;
+    } while (ttt_validate_move(variant, &player->board, square) != TTT_MOVE_VALID);
+    ttt_mark_square(&player->board, square, 2);
+    send_command(player->sd, serverAddr, MOVE, square + '0', player->gameNum);
+    if (ttt_check_win(variant, &player->board) != 0 || ttt_check_draw(variant, &player->board)) {
+        results->finished++;
+        start_game(player, serverAddr);
+        return;
+    }
+    player->command = MOVE;
+    player->sent = trace_clock();
+}
+
+/**
+ * @brief Sends a burst of NEW_GAME commands (whose replies are ignored).
+ *
+ * @param sd The socket descriptor the bursts are sent from.
+ * @param serverAddr The address of the server.
+ * @param options The options of the load.
+ * @param results The results of the load.
+ */
+void send_burst(int sd, const struct sockaddr_in *serverAddr, const struct Load_Options *options, struct Load_Results *results) {
+    int i;
+    for (i = 0; i < options->burst; i++) send_command(sd, serverAddr, NEW_GAME, options->variant, 0);
+    results->burstSent += options->burst;
+}
+
+/**
+ * @brief Runs the mixed load: every player keeps a game going while bursts of NEW_GAME commands
+ * are sent from another source (the first one an interval in, once the games are under way). A player whose command goes unanswered past the timeout counts
+ * its game as timed out and starts a new one from a new source address.
+ *
+ * @param serverAddr The address of the server.
+ * @param options The options of the load.
+ * @param results The results of the load.
+ */
+void run_load(const struct sockaddr_in *serverAddr, const struct Load_Options *options, struct Load_Results *results) {
+    static struct Load_Player players[MAX_PLAYERS];
+    struct pollfd events[MAX_PLAYERS + 1];
+    uint64_t now = trace_clock(), end = now + options->duration * 1000000000ULL;
+    uint64_t nextBurst = now + options->interval * 1000000000ULL;
+    uint64_t timeout = options->timeout * 1000000000ULL;
+    int i, burstSd = open_socket();
+    /* Start every player's game */
+    for (i = 0; i < options->players; i++) {
+        players[i].sd = open_socket();
+        players[i].random = i + 1;
+        start_game(&players[i], serverAddr);
+    }
+    while ((now = trace_clock()) < end) {
+        /* Send a burst when it is due */
+        if (now >= nextBurst) {
+            send_burst(burstSd, serverAddr, options, results);
+            nextBurst += options->interval * 1000000000ULL;
+        }
+        /* Answer the server's moves */
+        for (i = 0; i < options->players; i++) {
+            events[i].fd = players[i].sd;
+            events[i].events = POLLIN;
+        }
+        events[options->players].fd = burstSd;
+        events[options->players].events = POLLIN;
+        if (poll(events, options->players + 1, POLL_INTERVAL) < 0 && errno != EINTR) print_error("poll", errno, 1);
+        for (i = 0; i < options->players; i++) {
+            if (events[i].revents & POLLIN) play_reply(&players[i], serverAddr, results);
+        }
+        if (events[options->players].revents & POLLIN) {
+            char discard[sizeof(struct Buffer)];
+            while (recv(burstSd, discard, sizeof(discard), MSG_DONTWAIT) > 0);
+        }
+        /* Give up on the games whose commands went unanswered for too long */
+        now = trace_clock();
+        for (i = 0; i < options->players; i++) {
+            if (players[i].sent == 0 || now - players[i].sent < timeout) continue;
+            if (players[i].command == MOVE) results->timedOut++;
+            else results->unanswered++;
+            close(players[i].sd);
+            players[i].sd = open_socket();
+            start_game(&players[i], serverAddr);
+        }
+    }
+    for (i = 0; i < options->players; i++) close(players[i].sd);
+    close(burstSd);
+}
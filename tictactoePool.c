@@ -0,0 +1,221 @@
+/***********************************************************/
+/* Work-stealing thread pool used by the parallel game-    */
+/* tree search. Each worker owns a deque of tasks; idle    */
+/* workers (and threads waiting on a task group) steal     */
+/* from the other deques.                                  */
+/***********************************************************/
+
+/* #include files go here */
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include "tictactoePool.h"
+
+/* Structure passed to each worker thread when it starts. */
+struct Worker_Start {
+    struct Pool *pool;  // pool the worker belongs to
+    int index;          // index of the worker's deque
+};
+
+/* The index of the deque owned by the current thread (-1 if not a worker). */
+static __thread int workerIndex = -1;
+
+/**
+ * @brief Pushes a task onto the tail of a deque.
+ *
+ * @param deque The deque to push onto.
+ * @param task The task to push.
+ * @return True if the task was queued, false if the deque was full.
+ */
+static int deque_push(struct Pool_Deque *deque, const struct Pool_Task *task) {
+    int queued = 0;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->tail - deque->head < POOL_DEQUE_SIZE) {
+        deque->tasks[deque->tail++ % POOL_DEQUE_SIZE] = *task;
+        queued = 1;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return queued;
+}
+
+/**
+ * @brief Takes a task from a deque. The owner takes the newest task (for locality) and
+ * thieves take the oldest task (which is usually the largest).
+ *
+ * @param deque The deque to take from.
+ * @param steal Whether the task is being stolen by another thread.
+ * @param task The task that was taken.
+ * @return True if a task was taken, false if the deque was empty.
+ */
+static int deque_take(struct Pool_Deque *deque, int steal, struct Pool_Task *task) {
+    int taken = 0;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->tail > deque->head) {
+        *task = (steal) ? deque->tasks[deque->head++ % POOL_DEQUE_SIZE] : deque->tasks[--deque->tail % POOL_DEQUE_SIZE];
+        taken = 1;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return taken;
+}
+
+/**
+ * @brief Finds a task to run, first from the given deque and then by stealing from the others.
+ *
+ * @param pool The pool to search.
+ * @param own The index of the deque owned by the caller.
+ * @param task The task that was found.
+ * @return True if a task was found, false if every deque was empty.
+ */
+static int find_task(struct Pool *pool, int own, struct Pool_Task *task) {
+    int i;
+    if (atomic_load(&pool->queued) == 0) return 0;
+    if (deque_take(&pool->deques[own], 0, task)) goto found;
+    /* Steal from the other deques, starting after our own */
+    for (i = 1; i <= pool->numThreads; i++) {
+        if (deque_take(&pool->deques[(own + i) % (pool->numThreads + 1)], 1, task)) goto found;
+    }
+    return 0;
+found:
+    atomic_fetch_sub(&pool->queued, 1);
+    return 1;
+}
+
+/**
+ * @brief Runs a task and marks it finished in its group.
+ *
+ * @param task The task to run.
+ */
+static void run_task(const struct Pool_Task *task) {
+    task->run(task->arg);
+    atomic_fetch_sub(&task->group->pending, 1);
+}
+
+/**
+ * @brief Main loop of each worker thread. Runs tasks until the pool is destroyed, sleeping
+ * while no tasks are queued.
+ *
+ * @param arg The worker start information.
+ * @return Always NULL.
+ */
+static void *worker_main(void *arg) {
+    struct Worker_Start start = *(struct Worker_Start *)arg;
+    struct Pool *pool = start.pool;
+    free(arg);
+    workerIndex = start.index;
+    while (!atomic_load(&pool->shutdown)) {
+        struct Pool_Task task;
+        if (find_task(pool, workerIndex, &task)) {
+            run_task(&task);
+            continue;
+        }
+        /* Sleep until more tasks are queued */
+        pthread_mutex_lock(&pool->sleepLock);
+        while (atomic_load(&pool->queued) == 0 && !atomic_load(&pool->shutdown)) {
+            pthread_cond_wait(&pool->wake, &pool->sleepLock);
+        }
+        pthread_mutex_unlock(&pool->sleepLock);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Creates a pool of worker threads.
+ *
+ * @param numThreads The number of worker threads to create [1-POOL_MAX_THREADS].
+ * @return The new pool, or NULL if it could not be created.
+ */
+struct Pool *pool_create(int numThreads) {
+    int i;
+    struct Pool *pool;
+    if (numThreads < 1 || numThreads > POOL_MAX_THREADS) return NULL;
+    if ((pool = calloc(1, sizeof(struct Pool))) == NULL) return NULL;
+    pool->numThreads = numThreads;
+    pool->threads = calloc(numThreads, sizeof(pthread_t));
+    pool->deques = calloc(numThreads + 1, sizeof(struct Pool_Deque));
+    if (pool->threads == NULL || pool->deques == NULL) {
+        free(pool->threads);
+        free(pool->deques);
+        free(pool);
+        return NULL;
+    }
+    for (i = 0; i <= numThreads; i++) pthread_mutex_init(&pool->deques[i].lock, NULL);
+    pthread_mutex_init(&pool->sleepLock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    /* Start each worker with its own deque */
+    for (i = 0; i < numThreads; i++) {
+        struct Worker_Start *start = malloc(sizeof(struct Worker_Start));
+        start->pool = pool;
+        start->index = i;
+        if (pthread_create(&pool->threads[i], NULL, worker_main, start) != 0) {
+            perror("pool_create: pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    return pool;
+}
+
+/**
+ * @brief Stops all worker threads and frees the pool. No tasks may be queued.
+ *
+ * @param pool The pool to destroy.
+ */
+void pool_destroy(struct Pool *pool) {
+    int i;
+    if (pool == NULL) return;
+    /* Wake every worker so it sees the shutdown flag */
+    pthread_mutex_lock(&pool->sleepLock);
+    atomic_store(&pool->shutdown, 1);
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->sleepLock);
+    for (i = 0; i < pool->numThreads; i++) pthread_join(pool->threads[i], NULL);
+    for (i = 0; i <= pool->numThreads; i++) pthread_mutex_destroy(&pool->deques[i].lock);
+    pthread_mutex_destroy(&pool->sleepLock);
+    pthread_cond_destroy(&pool->wake);
+    free(pool->threads);
+    free(pool->deques);
+    free(pool);
+}
+
+/**
+ * @brief Queues a task on the pool. Workers queue on their own deque; other threads queue on
+ * the shared outside deque. If the deque is full, the task is run immediately instead.
+ *
+ * @param pool The pool to run the task on.
+ * @param group The group the task belongs to.
+ * @param run The function that runs the task.
+ * @param arg The argument passed to the function.
+ */
+void pool_submit(struct Pool *pool, struct Pool_Group *group, pool_task run, void *arg) {
+    struct Pool_Task task = {run, arg, group};
+    int own = (workerIndex >= 0) ? workerIndex : pool->numThreads;
+    atomic_fetch_add(&group->pending, 1);
+    atomic_fetch_add(&pool->queued, 1);
+    if (!deque_push(&pool->deques[own], &task)) {
+        atomic_fetch_sub(&pool->queued, 1);
+        run_task(&task);
+        return;
+    }
+    /* Wake a sleeping worker to run (or steal) the task */
+    pthread_mutex_lock(&pool->sleepLock);
+    pthread_cond_signal(&pool->wake);
+    pthread_mutex_unlock(&pool->sleepLock);
+}
+
+/**
+ * @brief Waits for every task in a group to finish. The waiting thread runs queued tasks
+ * (stealing if necessary) instead of blocking, so it adds to the pool's throughput.
+ *
+ * @param pool The pool the tasks were submitted to.
+ * @param group The group to wait for.
+ */
+void pool_wait(struct Pool *pool, struct Pool_Group *group) {
+    int own = (workerIndex >= 0) ? workerIndex : pool->numThreads;
+    while (atomic_load(&group->pending) > 0) {
+        struct Pool_Task task;
+        if (find_task(pool, own, &task)) {
+            run_task(&task);
+        } else {
+            sched_yield();
+        }
+    }
+}
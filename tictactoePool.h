@@ -0,0 +1,57 @@
+/***********************************************************/
+/* Work-stealing thread pool used by the parallel game-    */
+/* tree search. Each worker owns a deque of tasks; idle    */
+/* workers (and threads waiting on a task group) steal     */
+/* from the other deques.                                  */
+/***********************************************************/
+
+#ifndef TICTACTOE_POOL_H
+#define TICTACTOE_POOL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+/* The maximum number of tasks queued on each deque. */
+#define POOL_DEQUE_SIZE 256
+/* The maximum number of worker threads in a pool. */
+#define POOL_MAX_THREADS 64
+
+/* Function pointer type for a task run by the pool. */
+typedef void (*pool_task)(void *arg);
+
+/* Structure to track the completion of a group of tasks. */
+struct Pool_Group {
+    atomic_int pending;     // number of tasks in the group that have not finished
+};
+
+/* Structure for a task queued on the pool. */
+struct Pool_Task {
+    pool_task run;              // function that runs the task
+    void *arg;                  // argument passed to the function
+    struct Pool_Group *group;   // group the task belongs to
+};
+
+/* Structure for the deque of tasks owned by each worker. */
+struct Pool_Deque {
+    pthread_mutex_t lock;                       // protects the deque
+    int head, tail;                             // steal from the head, pop from the tail
+    struct Pool_Task tasks[POOL_DEQUE_SIZE];    // circular buffer of tasks
+};
+
+/* Structure for a work-stealing thread pool. */
+struct Pool {
+    int numThreads;                 // number of worker threads
+    pthread_t *threads;             // worker threads
+    struct Pool_Deque *deques;      // one deque per worker, plus one for outside threads
+    atomic_int queued;              // number of tasks waiting on all deques
+    atomic_int shutdown;            // set when the pool is being destroyed
+    pthread_mutex_t sleepLock;      // protects sleeping on the wake condition
+    pthread_cond_t wake;            // signalled when tasks are queued
+};
+
+struct Pool *pool_create(int numThreads);
+void pool_destroy(struct Pool *pool);
+void pool_submit(struct Pool *pool, struct Pool_Group *group, pool_task run, void *arg);
+void pool_wait(struct Pool *pool, struct Pool_Group *group);
+
+#endif
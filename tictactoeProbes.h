@@ -0,0 +1,59 @@
+/***********************************************************/
+/* Static tracepoints (USDT probes) for the server. Each   */
+/* probe is a nop with a .note.stapsdt note describing     */
+/* where its arguments live (the format of <sys/sdt.h>),   */
+/* so bpftrace, perf and SystemTap attach to the binary    */
+/* as built. A tracer raises the probe's semaphore while   */
+/* attached, which lets costly arguments be skipped.       */
+/***********************************************************/
+
+#ifndef TICTACTOE_PROBES_H
+#define TICTACTOE_PROBES_H
+
+#include <stdint.h>
+
+/* The provider name every probe is listed under. */
+#define PROBE_PROVIDER "tictactoe"
+
+/* The reasons a command is rejected (the last argument of the reject probe). */
+#define PROBE_REJECT_INVALID 0  // discarded by validate_command()
+#define PROBE_REJECT_REFUSED 1  // refused by its command handler
+
+/* Defines the semaphore of a probe (once per probe, in the file that fires it). */
+#define PROBE_SEMAPHORE(name) volatile unsigned short tictactoe_##name##_semaphore __attribute__((used, section(".probes")))
+/* Whether a tracer is attached to a probe (for guarding the work of computing its arguments). */
+#define PROBE_ENABLED(name) __builtin_expect(tictactoe_##name##_semaphore != 0, 0)
+
+#if defined(__x86_64__) || defined(__aarch64__)
+/* Fires a probe with three arguments, each passed to the tracer as a signed 64-bit value. */
+#define PROBE(name, arg1, arg2, arg3) \
+    __asm__ __volatile__( \
+        "990: nop\n" \
+        ".pushsection .note.stapsdt,\"?\",\"note\"\n" \
+        ".balign 4\n" \
+        ".4byte 992f-991f, 994f-993f, 3\n" \
+        "991: .asciz \"stapsdt\"\n" \
+        "992: .balign 4\n" \
+        "993: .8byte 990b\n" \
+        ".8byte _.stapsdt.base\n" \
+        ".8byte tictactoe_" #name "_semaphore\n" \
+        ".asciz \"" PROBE_PROVIDER "\"\n" \
+        ".asciz \"" #name "\"\n" \
+        ".asciz \"-8@%[a1] -8@%[a2] -8@%[a3]\"\n" \
+        "994: .balign 4\n" \
+        ".popsection\n" \
+        ".ifndef _.stapsdt.base\n" \
+        ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+        ".weak _.stapsdt.base\n" \
+        ".hidden _.stapsdt.base\n" \
+        "_.stapsdt.base: .space 1\n" \
+        ".size _.stapsdt.base, 1\n" \
+        ".popsection\n" \
+        ".endif\n" \
+        :: [a1] "nor" ((int64_t)(arg1)), [a2] "nor" ((int64_t)(arg2)), [a3] "nor" ((int64_t)(arg3)))
+#else
+/* Probes are only emitted on the architectures the note format is written for. */
+#define PROBE(name, arg1, arg2, arg3) do { (void)(arg1); (void)(arg2); (void)(arg3); } while (0)
+#endif
+
+#endif
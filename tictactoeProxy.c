@@ -0,0 +1,1084 @@
+/***********************************************************/
+/* This program is a front proxy for a pool of TicTacToe   */
+/* servers. Games are spread over the backends by          */
+/* consistent hashing and their game numbers are rewritten */
+/* into one namespace, so clients see a single server.     */
+/***********************************************************/
+
+/* Needed for recvmmsg(), sendmmsg() and accept4() */
+#define _GNU_SOURCE
+
+/* #include files go here */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <string.h>
+#include <stdarg.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "tictactoeEngine.h"
+#include "tictactoeStream.h"
+
+/* The protocol version number used. */
+#define VERSION 3
+/* The command to begin a new game. */
+#define NEW_GAME 0x00
+/* The command to issue a move. */
+#define MOVE 0x01
+/* The command to analyze a board without playing a game. */
+#define ANALYZE 0x02
+/* The error code returned by a failed function. */
+#define ERROR_CODE -1
+/* The minimum number of command line arguments (excluding options): the port and one backend. */
+#define MIN_ARGS 3
+/* The maximum number of backend servers. */
+#define MAX_BACKENDS 16
+/* The default number of points each backend gets on the hash ring. */
+#define DEFAULT_VNODES 64
+/* The maximum number of points each backend gets on the hash ring. */
+#define MAX_VNODES 1024
+/* The maximum number of flows (client and backend pairs, each with its own upstream socket). */
+#define MAX_FLOWS 512
+/* The number of game numbers the proxy hands out (the game number is a single byte, 0 is unused). */
+#define GLOBAL_GAMES 255
+/* The maximum number of datagrams moved with one system call. */
+#define BATCH 32
+/* The largest datagram forwarded (in bytes). */
+#define DATAGRAM_SIZE 64
+/* The number of seconds a NEW_GAME waits for its backend's reply before its game number is released. */
+#define NEW_GAME_TIMEOUT 30
+/* The number of seconds a quiet flow is kept (the servers keep idle games for 30 + 600 seconds). */
+#define FLOW_TIMEOUT 660
+/* The maximum number of clients connected to the admin socket at once. */
+#define ADMIN_PEERS 4
+/* The longest admin command line (in bytes, including the newline). */
+#define ADMIN_LINE 128
+/* The longest admin reply line (in bytes). */
+#define ADMIN_REPLY 256
+/* The size of each admin client's output buffer (replies not yet sent). */
+#define ADMIN_OUTPUT 8192
+/* The output buffer room a command needs before it is run (the longest reply, stats, is a line per backend and three more). */
+#define ADMIN_RESERVE ((MAX_BACKENDS + 3) * ADMIN_REPLY)
+/* The slot of the first flow in the descriptors the proxy waits on (after the front, admin socket and admin clients). */
+#define FLOW_EVENT (2 + ADMIN_PEERS)
+/* The number of descriptors the proxy waits on. */
+#define NUM_EVENTS (FLOW_EVENT + MAX_FLOWS)
+
+/* Structure to send and recieve datagrams. */
+struct Buffer {
+    char version;   // version number
+    char command;   // player command
+    char data;      // data for command if applicable
+    char gameNum;   // game number
+};
+
+/* Structure for a backend server. */
+struct Proxy_Backend {
+    struct sockaddr_in addr;    // address of the server
+    int draining;               // whether new games are kept off the server
+    int games;                  // games being played on the server through the proxy
+    uint64_t forwarded;         // datagrams forwarded to the server
+    uint64_t replies;           // replies received from the server
+};
+
+/* Structure for a flow: a client's traffic to one backend, over an upstream socket of its own. */
+struct Proxy_Flow {
+    int fd;                     // upstream socket connected to the backend (-1 if the slot is free)
+    struct sockaddr_in client;  // address of the client
+    int backend;                // backend the flow goes to
+    int32_t lastActive;         // proxy clock time of the flow's last datagram
+};
+
+/* Structure for a game played through the proxy, by its global game number. A game that is over
+ * keeps its flow until the number is handed out again, so a repeated final move still reaches
+ * the backend that answers it. */
+struct Proxy_Game {
+    int flow;                   // flow the game is played over (-1 if the game number is free)
+    uint8_t backendNum;         // game number on the backend (0 until the backend answers the NEW_GAME)
+    uint8_t variant;            // board variant being played
+    uint8_t turn;               // player to move (1 is the backend, 2 is the client, 0 once the game is over)
+    uint8_t tag;                // tag of the NEW_GAME command that opened the game (0 for none)
+    struct TTT_Board board;     // board as seen by the proxy
+    uint64_t order;             // order the NEW_GAME was forwarded in
+    int32_t started;            // proxy clock time the NEW_GAME was forwarded
+};
+
+/* Structure for a point of a backend on the hash ring. */
+struct Ring_Point {
+    uint64_t hash;              // position on the ring
+    int backend;                // backend the point belongs to
+};
+
+/* Structure for a batch of datagrams moved with one system call. */
+struct Datagram_Batch {
+    int count;                              // number of datagrams in the batch
+    int flows[BATCH];                       // flow each datagram goes to (upstream batches)
+    struct mmsghdr msgs[BATCH];             // message headers
+    struct iovec iovs[BATCH];               // datagram buffers
+    struct sockaddr_in addrs[BATCH];        // source or destination addresses
+    char data[BATCH][DATAGRAM_SIZE];        // datagrams
+};
+
+/* Structure for the datagrams the proxy dropped. */
+struct Proxy_Stats {
+    uint64_t invalid;           // datagrams that are not valid commands
+    uint64_t unknownGame;       // moves for game numbers the client is not playing
+    uint64_t noGameNumber;      // NEW_GAME commands refused because every game number is in use
+    uint64_t noBackend;         // commands refused because every backend is draining
+    uint64_t noFlow;            // commands refused because every upstream socket is in use
+    uint64_t staleReplies;      // replies that matched no game
+    uint64_t sendFailed;        // datagrams the kernel refused to send
+};
+
+/* Structure for a client connected to the admin socket. */
+struct Admin_Peer {
+    int fd;                     // connected socket (-1 if the slot is free)
+    int length;                 // number of bytes in the input buffer
+    int outLength;              // number of bytes in the output buffer
+    int closing;                // set once the client has shut down its side of the connection
+    char input[ADMIN_LINE];     // bytes received and not yet parsed into lines
+    char output[ADMIN_OUTPUT];  // replies not yet sent
+};
+
+/* The state of the proxy. */
+static struct {
+    int frontFd;                                // socket clients send to
+    int adminFd;                                // admin socket (-1 if off)
+    int vnodes;                                 // points each backend gets on the hash ring
+    int numBackends;                            // number of backends
+    struct Proxy_Backend backends[MAX_BACKENDS];    // backends
+    struct Proxy_Flow flows[MAX_FLOWS];         // flows
+    struct Proxy_Game games[GLOBAL_GAMES + 1];  // games by global game number (0 is unused)
+    int nextGame;                               // game number the search for a free one starts at
+    uint64_t sequence;                          // NEW_GAME commands forwarded so far
+    struct Proxy_Stats stats;                   // datagrams dropped
+    struct Admin_Peer admins[ADMIN_PEERS];      // connected admin clients
+} proxy;
+
+/* The hash ring of the backends taking new games. */
+static struct {
+    int count;                                          // number of points
+    struct Ring_Point points[MAX_BACKENDS * MAX_VNODES];    // points sorted by position
+} ring;
+
+void print_error(const char *msg, int errnum, int terminate);
+void handle_init_error(const char *msg, int errnum);
+void extract_args(int argc, char *argv[], int *port, const char **adminPath);
+int32_t proxy_clock(void);
+int create_front(int port);
+
+/*************************/
+/* HASH RING FUNCTIONS */
+/*************************/
+
+uint64_t mix_hash(uint64_t x);
+uint64_t endpoint_key(const struct sockaddr_in *addr);
+int compare_points(const void *a, const void *b);
+void build_ring(void);
+int ring_lookup(uint64_t hash);
+
+/****************************/
+/* FLOW AND GAME FUNCTIONS */
+/****************************/
+
+int same_endpoint(const struct sockaddr_in *addr1, const struct sockaddr_in *addr2);
+int open_flow(const struct sockaddr_in *client, int backend);
+void close_flow(int index);
+int allocate_game(void);
+void end_game(int gameNum);
+void release_game(int gameNum);
+int find_tagged_game(const struct sockaddr_in *client, int tag);
+int repeats_reply(const struct Proxy_Game *game, uint8_t backendNum, int square);
+void play_square(int gameNum, int square, int player);
+void expire_flows(void);
+
+/*****************************/
+/* FORWARDING FUNCTIONS */
+/*****************************/
+
+void prepare_batch(struct Datagram_Batch *batch, int withAddresses);
+int route_request(const struct sockaddr_in *client, char *datagram, int length);
+int route_reply(int flow, char *datagram, int length);
+void forward_requests(void);
+void send_upstream(struct Datagram_Batch *batch);
+void collect_replies(int flow, struct Datagram_Batch *out);
+void flush_replies(struct Datagram_Batch *out);
+void run_proxy(void);
+
+/***************************/
+/* ADMIN CONTROL FUNCTIONS */
+/***************************/
+
+void start_admin_control(const char *path);
+void accept_admin_peer(void);
+short admin_peer_events(const struct Admin_Peer *peer);
+void handle_admin_peer(int index, short revents);
+int flush_admin_peer(struct Admin_Peer *peer);
+int admin_reply(struct Admin_Peer *peer, const char *format, ...) __attribute__((format(printf, 2, 3)));
+int run_admin_command(struct Admin_Peer *peer, char *line);
+int find_backend(const char *name);
+
+/**
+ * @brief This program accepts TicTacToe datagrams on a single port and spreads the games over
+ * a pool of backend servers, so the pool can be grown, shrunk or drained without clients
+ * knowing more than one address.
+ *
+ * @param argc Non-negative value representing the number of arguments passed to the program.
+ * @param argv The arguments passed to the program.
+ * @return The value zero indicates successful termination.
+ */
+int main(int argc, char *argv[]) {
+    int port, i;
+    const char *adminPath = NULL;
+
+    /* Extract options and arguments to their respective variables */
+    proxy.vnodes = DEFAULT_VNODES;
+    extract_args(argc, argv, &port, &adminPath);
+
+    /* Create the front socket and the hash ring */
+    proxy.frontFd = create_front(port);
+    proxy.adminFd = -1;
+    for (i = 0; i < MAX_FLOWS; i++) proxy.flows[i].fd = -1;
+    for (i = 0; i <= GLOBAL_GAMES; i++) proxy.games[i].flow = -1;
+    for (i = 0; i < ADMIN_PEERS; i++) proxy.admins[i].fd = -1;
+    proxy.nextGame = 1;
+    build_ring();
+    printf("[+]Proxy listening on port %d with %d backend(s), %d points each on the hash ring.\n", port, proxy.numBackends, proxy.vnodes);
+
+    /* Accept admin clients if requested */
+    if (adminPath != NULL) {
+        start_admin_control(adminPath);
+        printf("[+]Admin clients connect at %s.\n", adminPath);
+    }
+
+    /* Forward datagrams until killed */
+    run_proxy();
+    return 0;
+}
+
+/**
+ * @brief Prints the provided error message and corresponding errno message (if present) and
+ * terminates the process if asked to do so.
+ *
+ * @param msg The error description message to display.
+ * @param errnum This is the error number, usually errno.
+ * @param terminate Whether or not the process should be terminated.
+ */
+void print_error(const char *msg, int errnum, int terminate) {
+    if (errnum) {
+        printf("ERROR: %s: %s\n", msg, strerror(errnum));
+    } else {
+        printf("ERROR: %s\n", msg);
+    }
+    if (terminate) exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Prints a string describing the initialization error, the correct command usage, and
+ * exits the process signaling unsuccessful termination.
+ *
+ * @param msg The error description message to display.
+ * @param errnum This is the error number, usually errno.
+ */
+void handle_init_error(const char *msg, int errnum) {
+    print_error(msg, errnum, 0);
+    printf("Usage is: tictactoeProxy [-v <vnodes>] [-A <admin-socket-path>] <local-port> <backend-ip:port> [<backend-ip:port> ...]\n");
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Extracts the user provided arguments and performs validation on their formatting. If
+ * any errors are found, the function terminates the process.
+ *
+ * @param argc The number of arguments passed to the program.
+ * @param argv The arguments passed to the program.
+ * @param port The port the proxy listens on.
+ * @param adminPath Set to the Unix socket admin clients connect to (NULL for none).
+ */
+void extract_args(int argc, char *argv[], int *port, const char **adminPath) {
+    int opt, i;
+    while ((opt = getopt(argc, argv, "v:A:")) != -1) {
+        switch (opt) {
+            case 'v':   // points each backend gets on the hash ring
+                proxy.vnodes = strtol(optarg, NULL, 10);
+                if (proxy.vnodes < 1 || proxy.vnodes > MAX_VNODES) handle_init_error("-v: Invalid number of points", 0);
+                break;
+            case 'A':   // accept admin clients on the given Unix socket
+                if (strchr(optarg, '/') == NULL) handle_init_error("-A: The admin socket must be a Unix socket path", 0);
+                *adminPath = optarg;
+                break;
+            default:
+                handle_init_error("Invalid option", 0);
+        }
+    }
+    if (argc - optind + 1 < MIN_ARGS) handle_init_error("argc: Invalid number of command line arguments", 0);
+    if (argc - optind - 1 > MAX_BACKENDS) handle_init_error("argc: Too many backends", 0);
+    *port = strtol(argv[optind], NULL, 10);
+    if (*port < 1 || *port != (u_int16_t)(*port)) handle_init_error("local-port: Invalid port number", 0);
+    /* Extract and validate the backend addresses */
+    for (i = optind + 1; i < argc; i++) {
+        struct Proxy_Backend *backend = &proxy.backends[proxy.numBackends++];
+        char host[INET_ADDRSTRLEN];
+        int backendPort;
+        if (sscanf(argv[i], "%15[0-9.]:%d", host, &backendPort) != 2 || backendPort < 1 || backendPort != (u_int16_t)backendPort) {
+            handle_init_error("backend: Invalid address (expected <ip>:<port>)", 0);
+        }
+        backend->addr.sin_family = AF_INET;
+        backend->addr.sin_port = htons(backendPort);
+        if (inet_pton(AF_INET, host, &backend->addr.sin_addr) != 1) handle_init_error("backend: Invalid IP address", 0);
+    }
+}
+
+/**
+ * @brief Reads the monotonic proxy clock that flows and games are timed against.
+ *
+ * @return The current proxy clock time in seconds.
+ */
+int32_t proxy_clock(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int32_t)now.tv_sec;
+}
+
+/**
+ * @brief Creates the non-blocking UDP socket clients send to. If any errors are found, the
+ * function terminates the process.
+ *
+ * @param port The port to listen on.
+ * @return The socket descriptor.
+ */
+int create_front(int port) {
+    int sd;
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if ((sd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) print_error("create_front: socket", errno, 1);
+    if (bind(sd, (struct sockaddr *)&addr, sizeof(addr)) < 0) print_error("create_front: bind", errno, 1);
+    return sd;
+}
+
+/**
+ * @brief Mixes the bits of a 64-bit value (the splitmix64 finalizer), so nearby keys land far
+ * apart on the hash ring.
+ *
+ * @param x The value to mix.
+ * @return The hash of the value.
+ */
+uint64_t mix_hash(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+/**
+ * @brief Packs an IPv4 endpoint into the low 48 bits of a key.
+ *
+ * @param addr The endpoint.
+ * @return The key of the endpoint.
+ */
+uint64_t endpoint_key(const struct sockaddr_in *addr) {
+    return (uint64_t)ntohl(addr->sin_addr.s_addr) << 16 | ntohs(addr->sin_port);
+}
+
+/**
+ * @brief Orders hash ring points by position (for qsort()).
+ *
+ * @param a The first point.
+ * @param b The second point.
+ * @return Negative, zero or positive as the first point comes before, with or after the second.
+ */
+int compare_points(const void *a, const void *b) {
+    uint64_t hashA = ((const struct Ring_Point *)a)->hash, hashB = ((const struct Ring_Point *)b)->hash;
+    return (hashA > hashB) - (hashA < hashB);
+}
+
+/**
+ * @brief Builds the hash ring of the backends taking new games. Each backend's points depend
+ * only on its address, so adding, removing or draining a backend only moves the keys next to
+ * its own points.
+ */
+void build_ring(void) {
+    int b, v;
+    ring.count = 0;
+    for (b = 0; b < proxy.numBackends; b++) {
+        if (proxy.backends[b].draining) continue;
+        for (v = 0; v < proxy.vnodes; v++) {
+            ring.points[ring.count].hash = mix_hash(endpoint_key(&proxy.backends[b].addr) << 10 | v);
+            ring.points[ring.count].backend = b;
+            ring.count++;
+        }
+    }
+    qsort(ring.points, ring.count, sizeof(struct Ring_Point), compare_points);
+}
+
+/**
+ * @brief Finds the backend that owns a key: the one with the first point at or after the
+ * key's position on the hash ring (wrapping around).
+ *
+ * @param hash The hashed key.
+ * @return The backend index, or an error code if every backend is draining.
+ */
+int ring_lookup(uint64_t hash) {
+    int low = 0, high = ring.count;
+    if (ring.count == 0) return ERROR_CODE;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (ring.points[mid].hash < hash) low = mid + 1;
+        else high = mid;
+    }
+    return ring.points[(low == ring.count) ? 0 : low].backend;
+}
+
+/**
+ * @brief Checks to see if two endpoints have the same address (IP and port) or not.
+ *
+ * @param addr1 The address of endpoint 1.
+ * @param addr2 The address of endpoint 2.
+ * @return True if the endpoint addresses are the same, false otherwise.
+ */
+int same_endpoint(const struct sockaddr_in *addr1, const struct sockaddr_in *addr2) {
+    return addr1->sin_addr.s_addr == addr2->sin_addr.s_addr && addr1->sin_port == addr2->sin_port;
+}
+
+/**
+ * @brief Finds the flow of a client to a backend, opening one if needed. Each flow has its own
+ * upstream socket, so the backend tells clients apart by address exactly as it would without
+ * the proxy.
+ *
+ * @param client The address of the client.
+ * @param backend The backend index.
+ * @return The flow index, or an error code if every upstream socket is in use.
+ */
+int open_flow(const struct sockaddr_in *client, int backend) {
+    int i, free = ERROR_CODE;
+    struct Proxy_Flow *flow;
+    for (i = 0; i < MAX_FLOWS; i++) {
+        flow = &proxy.flows[i];
+        if (flow->fd < 0) {
+            if (free < 0) free = i;
+        } else if (flow->backend == backend && same_endpoint(&flow->client, client)) {
+            flow->lastActive = proxy_clock();
+            return i;
+        }
+    }
+    if (free < 0) return ERROR_CODE;
+    flow = &proxy.flows[free];
+    if ((flow->fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) {
+        print_error("open_flow: socket", errno, 0);
+        return ERROR_CODE;
+    }
+    if (connect(flow->fd, (struct sockaddr *)&proxy.backends[backend].addr, sizeof(struct sockaddr_in)) < 0) {
+        print_error("open_flow: connect", errno, 0);
+        close(flow->fd);
+        flow->fd = -1;
+        return ERROR_CODE;
+    }
+    flow->client = *client;
+    flow->backend = backend;
+    flow->lastActive = proxy_clock();
+    return free;
+}
+
+/**
+ * @brief Closes a flow and forgets the games played over it.
+ *
+ * @param index The flow index.
+ */
+void close_flow(int index) {
+    int g;
+    for (g = 1; g <= GLOBAL_GAMES; g++) {
+        if (proxy.games[g].flow == index) release_game(g);
+    }
+    close(proxy.flows[index].fd);
+    proxy.flows[index].fd = -1;
+}
+
+/**
+ * @brief Finds a free global game number (never used, or its game is over), handing them out in
+ * turn so a number is not reused while a late reply for its last game may still arrive.
+ *
+ * @return The game number, or an error code if every game number is in use.
+ */
+int allocate_game(void) {
+    int i;
+    for (i = 0; i < GLOBAL_GAMES; i++) {
+        int g = (proxy.nextGame + i - 1) % GLOBAL_GAMES + 1;
+        if (proxy.games[g].flow < 0 || proxy.games[g].turn == 0) {
+            proxy.nextGame = g % GLOBAL_GAMES + 1;
+            return g;
+        }
+    }
+    return ERROR_CODE;
+}
+
+/**
+ * @brief Frees a global game number and forgets its game (given up on, or its flow closed).
+ *
+ * @param gameNum The global game number.
+ */
+void release_game(int gameNum) {
+    end_game(gameNum);
+    proxy.games[gameNum].flow = -1;
+}
+
+/**
+ * @brief Marks a game as over, so its global game number can be handed out again.
+ *
+ * @param gameNum The global game number.
+ */
+void end_game(int gameNum) {
+    struct Proxy_Game *game = &proxy.games[gameNum];
+    if (game->flow < 0 || game->turn == 0) return;
+    proxy.backends[proxy.flows[game->flow].backend].games--;
+    game->turn = 0;
+}
+
+/**
+ * @brief Finds the game a tagged NEW_GAME command already opened for a client, if the client
+ * has not made a move in it yet (i.e. the command is being repeated because its reply was lost).
+ *
+ * @param client The address of the client.
+ * @param tag The tag of the NEW_GAME command (the game number field).
+ * @return The global game number, or an error code if there is no such game.
+ */
+int find_tagged_game(const struct sockaddr_in *client, int tag) {
+    int g;
+    for (g = 1; g <= GLOBAL_GAMES; g++) {
+        const struct Proxy_Game *game = &proxy.games[g];
+        if (game->flow >= 0 && game->turn != 0 && game->tag == tag && game->board.marks[1] == 0 &&
+            same_endpoint(&proxy.flows[game->flow].client, client)) return g;
+    }
+    return ERROR_CODE;
+}
+
+/**
+ * @brief Determines whether a backend's move is a repeat of the last move it sent for a game
+ * (the client repeated its command because the reply was lost).
+ *
+ * @param game The game.
+ * @param backendNum The game number the backend sent.
+ * @param square The square (1-based) the backend sent.
+ * @return True if the backend has already played the square in the game, false otherwise.
+ */
+int repeats_reply(const struct Proxy_Game *game, uint8_t backendNum, int square) {
+    return game->backendNum == backendNum && square >= 1 && square <= MAX_SQUARES && (game->board.marks[0] & (1u << (square - 1)));
+}
+
+/**
+ * @brief Plays a move on the proxy's copy of a game's board, the same way the backend does:
+ * a move out of turn or on a taken square is left to the backend to refuse (or answer again,
+ * if it repeats the last move). The game is ended once someone wins or the board is full.
+ *
+ * @param gameNum The global game number.
+ * @param square The square (1-based) played.
+ * @param player The player (1 is the backend, 2 is the client) making the move.
+ */
+void play_square(int gameNum, int square, int player) {
+    struct Proxy_Game *game = &proxy.games[gameNum];
+    const struct TTT_Variant *variant = ttt_get_variant(game->variant);
+    if (game->turn != player || ttt_validate_move(variant, &game->board, square) != TTT_MOVE_VALID) return;
+    ttt_mark_square(&game->board, square, player);
+    game->turn = 3 - player;
+    if (ttt_check_win(variant, &game->board) != 0 || ttt_check_draw(variant, &game->board)) end_game(gameNum);
+}
+
+/**
+ * @brief Releases the game numbers of NEW_GAME commands their backends never answered, and
+ * closes the flows that have been quiet for longer than the servers keep idle games.
+ */
+void expire_flows(void) {
+    int i, g;
+    int32_t now = proxy_clock();
+    for (g = 1; g <= GLOBAL_GAMES; g++) {
+        struct Proxy_Game *game = &proxy.games[g];
+        if (game->flow >= 0 && game->turn != 0 && game->backendNum == 0 && now - game->started > NEW_GAME_TIMEOUT) release_game(g);
+    }
+    for (i = 0; i < MAX_FLOWS; i++) {
+        if (proxy.flows[i].fd >= 0 && now - proxy.flows[i].lastActive > FLOW_TIMEOUT) close_flow(i);
+    }
+}
+
+/**
+ * @brief Points the message headers of a batch at its buffers.
+ *
+ * @param batch The batch.
+ * @param withAddresses Whether the messages carry addresses (the front socket is not connected).
+ */
+void prepare_batch(struct Datagram_Batch *batch, int withAddresses) {
+    int i;
+    memset(batch->msgs, 0, sizeof(batch->msgs));
+    for (i = 0; i < BATCH; i++) {
+        batch->iovs[i].iov_base = batch->data[i];
+        batch->iovs[i].iov_len = DATAGRAM_SIZE;
+        batch->msgs[i].msg_hdr.msg_iov = &batch->iovs[i];
+        batch->msgs[i].msg_hdr.msg_iovlen = 1;
+        if (withAddresses) {
+            batch->msgs[i].msg_hdr.msg_name = &batch->addrs[i];
+            batch->msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        }
+    }
+}
+
+/**
+ * @brief Picks the flow a client's command goes over and rewrites its game number for the
+ * backend. A NEW_GAME is given a global game number and a backend by hashing the client's
+ * endpoint with that number (a repeated NEW_GAME with the same tag goes to the game it already
+ * opened); a MOVE goes to the backend its game was started on; an ANALYZE goes to the backend
+ * owning the client's endpoint.
+ *
+ * @param client The address of the client.
+ * @param datagram The datagram (rewritten in place).
+ * @param length The number of bytes received.
+ * @return The flow index, or an error code if the datagram is dropped.
+ */
+int route_request(const struct sockaddr_in *client, char *datagram, int length) {
+    struct Buffer *header = (struct Buffer *)datagram;
+    struct Proxy_Game *game;
+    int g, backend, flow;
+    if (length < (int)sizeof(struct Buffer) || header->version != VERSION) {
+        proxy.stats.invalid++;
+        return ERROR_CODE;
+    }
+    if (header->command == NEW_GAME) {
+        if (ttt_get_variant(header->data) == NULL) {
+            proxy.stats.invalid++;
+            return ERROR_CODE;
+        }
+        if (header->gameNum != 0 && (g = find_tagged_game(client, (uint8_t)header->gameNum)) != ERROR_CODE) return proxy.games[g].flow;
+        if ((g = allocate_game()) == ERROR_CODE) {
+            proxy.stats.noGameNumber++;
+            return ERROR_CODE;
+        }
+        if ((backend = ring_lookup(mix_hash(endpoint_key(client) << 8 | g))) == ERROR_CODE) {
+            proxy.stats.noBackend++;
+            return ERROR_CODE;
+        }
+        if ((flow = open_flow(client, backend)) == ERROR_CODE) {
+            proxy.stats.noFlow++;
+            return ERROR_CODE;
+        }
+        /* The backend numbers the game when it answers */
+        game = &proxy.games[g];
+        memset(game, 0, sizeof(struct Proxy_Game));
+        game->flow = flow;
+        game->variant = header->data;
+        game->turn = 1;
+        game->tag = header->gameNum;
+        game->order = ++proxy.sequence;
+        game->started = proxy_clock();
+        proxy.backends[backend].games++;
+        return flow;
+    } else if (header->command == MOVE) {
+        g = (uint8_t)header->gameNum;
+        game = &proxy.games[g];
+        if (g == 0 || game->flow < 0 || game->backendNum == 0 || !same_endpoint(&proxy.flows[game->flow].client, client)) {
+            proxy.stats.unknownGame++;
+            return ERROR_CODE;
+        }
+        flow = game->flow;
+        proxy.flows[flow].lastActive = proxy_clock();
+        header->gameNum = game->backendNum;
+        play_square(g, header->data - '0', 2);
+        return flow;
+    } else if (header->command == ANALYZE) {
+        if ((backend = ring_lookup(mix_hash(endpoint_key(client) << 8))) == ERROR_CODE) {
+            proxy.stats.noBackend++;
+            return ERROR_CODE;
+        }
+        if ((flow = open_flow(client, backend)) == ERROR_CODE) proxy.stats.noFlow++;
+        return flow;
+    }
+    proxy.stats.invalid++;
+    return ERROR_CODE;
+}
+
+/**
+ * @brief Matches a backend's reply to the game it is for and rewrites its game number into the
+ * global namespace. A move is the answer to the flow's game waiting on the backend with that
+ * number, a repeat of the last move of the flow's game waiting on the client with that number
+ * or, failing those, the answer to the flow's oldest NEW_GAME not yet answered (a backend
+ * answers a client's NEW_GAME commands in order). Only then is it taken for a repeat of the
+ * move that ended a game. ANALYZE replies are passed on as they are.
+ *
+ * @param flow The flow the reply arrived on.
+ * @param datagram The datagram (rewritten in place).
+ * @param length The number of bytes received.
+ * @return 0 if the reply is passed on to the client, or an error code if it is dropped.
+ */
+int route_reply(int flow, char *datagram, int length) {
+    struct Buffer *header = (struct Buffer *)datagram;
+    int g, match = ERROR_CODE, repeat = ERROR_CODE, ended = ERROR_CODE, oldest = ERROR_CODE;
+    uint8_t backendNum = (uint8_t)header->gameNum;
+    int square = header->data - '0';
+    if (length < (int)sizeof(struct Buffer) || header->version != VERSION || (header->command != MOVE && header->command != ANALYZE)) {
+        proxy.stats.staleReplies++;
+        return ERROR_CODE;
+    }
+    proxy.flows[flow].lastActive = proxy_clock();
+    if (header->command == ANALYZE) return 0;
+    for (g = 1; g <= GLOBAL_GAMES; g++) {
+        struct Proxy_Game *game = &proxy.games[g];
+        if (game->flow != flow) continue;
+        if (game->backendNum == backendNum && game->turn == 1) match = g;
+        if (game->turn == 2 && repeats_reply(game, backendNum, square)) repeat = g;
+        if (game->turn == 0 && repeats_reply(game, backendNum, square)) ended = g;
+        if (game->backendNum == 0 && game->turn != 0 && (oldest < 0 || game->order < proxy.games[oldest].order)) oldest = g;
+    }
+    if (match < 0 && repeat < 0 && oldest >= 0) {
+        /* A new game: whatever game the backend numbered the same before has ended */
+        for (g = 1; g <= GLOBAL_GAMES; g++) {
+            if (proxy.games[g].flow == flow && proxy.games[g].backendNum == backendNum) release_game(g);
+        }
+        proxy.games[oldest].backendNum = backendNum;
+        match = oldest;
+    }
+    /* A repeated reply is passed on without being played again */
+    if (match < 0) match = (repeat >= 0) ? repeat : ended;
+    if (match < 0) {
+        proxy.stats.staleReplies++;
+        return ERROR_CODE;
+    }
+    header->gameNum = (char)match;
+    play_square(match, square, 1);
+    return 0;
+}
+
+/**
+ * @brief Receives a batch of commands from the clients and forwards each one over its flow.
+ */
+void forward_requests(void) {
+    static struct Datagram_Batch in, out;
+    int i, n;
+    prepare_batch(&in, 1);
+    if ((n = recvmmsg(proxy.frontFd, in.msgs, BATCH, MSG_DONTWAIT, NULL)) <= 0) {
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) print_error("forward_requests: recvmmsg", errno, 0);
+        return;
+    }
+    out.count = 0;
+    for (i = 0; i < n; i++) {
+        int length = in.msgs[i].msg_len, flow;
+        if ((flow = route_request(&in.addrs[i], in.data[i], length)) == ERROR_CODE) continue;
+        memcpy(out.data[out.count], in.data[i], length);
+        out.iovs[out.count].iov_len = length;
+        out.flows[out.count++] = flow;
+    }
+    send_upstream(&out);
+}
+
+/**
+ * @brief Sends a batch of commands upstream, with one system call for each run of commands
+ * going over the same flow.
+ *
+ * @param batch The batch (its lengths and flows are set, its headers are pointed here).
+ */
+void send_upstream(struct Datagram_Batch *batch) {
+    int i, start;
+    for (i = 0; i < batch->count; i++) {
+        memset(&batch->msgs[i], 0, sizeof(struct mmsghdr));
+        batch->iovs[i].iov_base = batch->data[i];
+        batch->msgs[i].msg_hdr.msg_iov = &batch->iovs[i];
+        batch->msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    for (start = 0; start < batch->count; start = i) {
+        int flow = batch->flows[start], sent;
+        for (i = start + 1; i < batch->count && batch->flows[i] == flow; i++);
+        if ((sent = sendmmsg(proxy.flows[flow].fd, &batch->msgs[start], i - start, 0)) < 0) sent = 0;
+        proxy.stats.sendFailed += (i - start) - sent;
+        proxy.backends[proxy.flows[flow].backend].forwarded += sent;
+    }
+}
+
+/**
+ * @brief Receives the replies waiting on a flow and adds the ones that are passed on to the
+ * batch of replies to the clients.
+ *
+ * @param flow The flow index.
+ * @param out The batch of replies to the clients (flushed whenever it fills up).
+ */
+void collect_replies(int flow, struct Datagram_Batch *out) {
+    static struct Datagram_Batch in;
+    int i, n;
+    prepare_batch(&in, 0);
+    if ((n = recvmmsg(proxy.flows[flow].fd, in.msgs, BATCH, MSG_DONTWAIT, NULL)) <= 0) {
+        /* Nothing waiting, or the backend is not listening (ECONNREFUSED) */
+        return;
+    }
+    proxy.backends[proxy.flows[flow].backend].replies += n;
+    for (i = 0; i < n; i++) {
+        int length = in.msgs[i].msg_len;
+        if (route_reply(flow, in.data[i], length) == ERROR_CODE) continue;
+        memcpy(out->data[out->count], in.data[i], length);
+        out->iovs[out->count].iov_len = length;
+        out->addrs[out->count++] = proxy.flows[flow].client;
+        if (out->count == BATCH) flush_replies(out);
+    }
+}
+
+/**
+ * @brief Sends a batch of replies to their clients through the front socket.
+ *
+ * @param out The batch of replies (emptied).
+ */
+void flush_replies(struct Datagram_Batch *out) {
+    int i, sent = 0, rv;
+    for (i = 0; i < out->count; i++) {
+        memset(&out->msgs[i], 0, sizeof(struct mmsghdr));
+        out->iovs[i].iov_base = out->data[i];
+        out->msgs[i].msg_hdr.msg_iov = &out->iovs[i];
+        out->msgs[i].msg_hdr.msg_iovlen = 1;
+        out->msgs[i].msg_hdr.msg_name = &out->addrs[i];
+        out->msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    }
+    /* Skip a reply the kernel refuses and carry on with the rest */
+    while (sent < out->count) {
+        if ((rv = sendmmsg(proxy.frontFd, &out->msgs[sent], out->count - sent, 0)) <= 0) {
+            proxy.stats.sendFailed++;
+            rv = 1;
+        }
+        sent += rv;
+    }
+    out->count = 0;
+}
+
+/**
+ * @brief Waits for datagrams from the clients and the backends and forwards them, until the
+ * process is killed.
+ */
+void run_proxy(void) {
+    static struct pollfd events[NUM_EVENTS];
+    static struct Datagram_Batch replies;
+    int32_t nextExpiry = proxy_clock() + 1;
+    int i;
+    while (1) {
+        /* Wait on the front socket, the admin socket and clients, and every flow */
+        events[0].fd = proxy.frontFd;
+        events[1].fd = proxy.adminFd;
+        for (i = 0; i < ADMIN_PEERS; i++) events[2 + i].fd = proxy.admins[i].fd;
+        for (i = 0; i < MAX_FLOWS; i++) events[FLOW_EVENT + i].fd = proxy.flows[i].fd;
+        for (i = 0; i < NUM_EVENTS; i++) events[i].events = POLLIN;
+        for (i = 0; i < ADMIN_PEERS; i++) events[2 + i].events = admin_peer_events(&proxy.admins[i]);
+        if (poll(events, NUM_EVENTS, 1000) < 0) {
+            if (errno != EINTR) print_error("run_proxy: poll", errno, 0);
+            continue;
+        }
+        /* Forward the clients' commands */
+        if (events[0].revents & POLLIN) forward_requests();
+        /* Pass the backends' replies back to the clients */
+        for (i = 0; i < MAX_FLOWS; i++) {
+            if (events[FLOW_EVENT + i].revents && proxy.flows[i].fd >= 0) collect_replies(i, &replies);
+        }
+        if (replies.count > 0) flush_replies(&replies);
+        /* Answer admin clients */
+        if (events[1].revents & POLLIN) accept_admin_peer();
+        for (i = 0; i < ADMIN_PEERS; i++) {
+            if (events[2 + i].revents && proxy.admins[i].fd >= 0) handle_admin_peer(i, events[2 + i].revents);
+        }
+        /* Give up on unanswered games and quiet flows once a second */
+        if (proxy_clock() >= nextExpiry) {
+            expire_flows();
+            nextExpiry = proxy_clock() + 1;
+        }
+    }
+}
+
+/**
+ * @brief Starts accepting admin clients on a Unix socket only the proxy's user can connect to.
+ * If the socket cannot be created, the function terminates the process.
+ *
+ * @param path The path of the Unix socket.
+ */
+void start_admin_control(const char *path) {
+    mode_t mask = umask(S_IRWXG | S_IRWXO);
+    proxy.adminFd = stream_listen(path);
+    umask(mask);
+    if (proxy.adminFd < 0) handle_init_error("-A: Unable to create admin socket", errno);
+}
+
+/**
+ * @brief Accepts an admin client and gives it a free peer slot. The client is refused if every
+ * slot is taken.
+ */
+void accept_admin_peer(void) {
+    int i, fd;
+    if ((fd = accept4(proxy.adminFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) < 0) return;
+    for (i = 0; i < ADMIN_PEERS && proxy.admins[i].fd >= 0; i++);
+    if (i == ADMIN_PEERS) {
+        close(fd);
+        return;
+    }
+    proxy.admins[i].fd = fd;
+    proxy.admins[i].length = 0;
+    proxy.admins[i].outLength = 0;
+    proxy.admins[i].closing = 0;
+}
+
+/**
+ * @brief Chooses what to wait for on an admin client's connection: room to send while replies
+ * are queued, and more commands only while there is room to run them. A client that stops
+ * reading its replies is thus left waiting without holding up the proxy.
+ *
+ * @param peer The admin client.
+ * @return The poll() events to wait for.
+ */
+short admin_peer_events(const struct Admin_Peer *peer) {
+    short events = (peer->outLength > 0) ? POLLOUT : 0;
+    if (!peer->closing && peer->length < ADMIN_LINE && ADMIN_OUTPUT - peer->outLength >= ADMIN_RESERVE) events |= POLLIN;
+    return events;
+}
+
+/**
+ * @brief Sends an admin client's queued replies, then runs every complete command line it has
+ * sent as long as there is room for their replies. The client is dropped if it stopped taking
+ * replies, or once it has hung up and its replies are out.
+ *
+ * @param index The peer slot of the client.
+ * @param revents The events poll() reported on its connection.
+ */
+void handle_admin_peer(int index, short revents) {
+    struct Admin_Peer *peer = &proxy.admins[index];
+    char *line, *end;
+    int n, failed = 0;
+    if ((revents & POLLOUT) && flush_admin_peer(peer) < 0) failed = 1;
+    if (!failed && (revents & (POLLIN | POLLHUP | POLLERR)) && !peer->closing && peer->length < ADMIN_LINE) {
+        if ((n = read(peer->fd, peer->input + peer->length, ADMIN_LINE - peer->length)) > 0) {
+            peer->length += n;
+        } else if (n == 0) {
+            peer->closing = 1;
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            failed = 1;
+        }
+    }
+    if (!failed) {
+        line = peer->input;
+        while (!failed && ADMIN_OUTPUT - peer->outLength >= ADMIN_RESERVE && (end = memchr(line, '\n', peer->input + peer->length - line)) != NULL) {
+            *end = '\0';
+            failed = (run_admin_command(peer, line) == ERROR_CODE);
+            line = end + 1;
+        }
+        peer->length -= line - peer->input;
+        memmove(peer->input, line, peer->length);
+        if (!failed && peer->length == ADMIN_LINE && memchr(peer->input, '\n', ADMIN_LINE) == NULL) {
+            admin_reply(peer, "error: command too long\n");
+            flush_admin_peer(peer);
+            failed = 1;
+        }
+    }
+    if (failed || flush_admin_peer(peer) < 0 || (peer->closing && peer->outLength == 0)) {
+        close(peer->fd);
+        peer->fd = -1;
+    }
+}
+
+/**
+ * @brief Sends as much of an admin client's queued replies as its connection takes without
+ * blocking.
+ *
+ * @param peer The admin client.
+ * @return The number of bytes still queued, or -1 if the connection failed (errno is set).
+ */
+int flush_admin_peer(struct Admin_Peer *peer) {
+    ssize_t rv;
+    if (peer->outLength == 0) return 0;
+    if ((rv = send(peer->fd, peer->output, peer->outLength, MSG_NOSIGNAL)) < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? peer->outLength : -1;
+    }
+    peer->outLength -= rv;
+    memmove(peer->output, peer->output + rv, peer->outLength);
+    return peer->outLength;
+}
+
+/**
+ * @brief Queues a line of a reply to an admin client. The line is queued whole or not at all.
+ *
+ * @param peer The admin client.
+ * @param format The printf() format of the line.
+ * @return 0 if the line was queued, or an error code if the output buffer has no room for it.
+ */
+int admin_reply(struct Admin_Peer *peer, const char *format, ...) {
+    char text[ADMIN_REPLY];
+    int length;
+    va_list args;
+    va_start(args, format);
+    length = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    if (length >= (int)sizeof(text)) length = sizeof(text) - 1;
+    if (length > ADMIN_OUTPUT - peer->outLength) return ERROR_CODE;
+    memcpy(peer->output + peer->outLength, text, length);
+    peer->outLength += length;
+    return 0;
+}
+
+/**
+ * @brief Runs an admin command line. Every reply ends with a line holding "ok" or "error: "
+ * and the reason. The commands are:
+ * - stats: every backend (its games and traffic, and whether it is draining or drained), the
+ *   flows and games in use, and the datagrams dropped
+ * - drain <backend>: keeps new games off a backend (by index or <ip>:<port>) while its games
+ *   in progress are played out
+ * - undrain <backend>: puts a backend back on the hash ring
+ *
+ * @param peer The admin client.
+ * @param line The command line (without its newline).
+ * @return 0 if the reply was queued, or an error code if the client is not taking replies.
+ */
+int run_admin_command(struct Admin_Peer *peer, char *line) {
+    char word[ADMIN_LINE], name[ADMIN_LINE], extra;
+    int i, b, flows = 0, games = 0;
+    line[strcspn(line, "\r")] = '\0';
+    if (sscanf(line, "%s", word) != 1) return 0;
+    if (strcmp(word, "stats") == 0 && sscanf(line, "%*s %c", &extra) != 1) {
+        for (b = 0; b < proxy.numBackends; b++) {
+            const struct Proxy_Backend *backend = &proxy.backends[b];
+            if (admin_reply(peer, "backend %d %s:%d %s games %d forwarded %llu replies %llu\n", b, inet_ntoa(backend->addr.sin_addr),
+                ntohs(backend->addr.sin_port), !backend->draining ? "active" : (backend->games > 0) ? "draining" : "drained",
+                backend->games, (unsigned long long)backend->forwarded, (unsigned long long)backend->replies) == ERROR_CODE) return ERROR_CODE;
+        }
+        for (i = 0; i < MAX_FLOWS; i++) flows += (proxy.flows[i].fd >= 0);
+        for (i = 1; i <= GLOBAL_GAMES; i++) games += (proxy.games[i].flow >= 0 && proxy.games[i].turn != 0);
+        if (admin_reply(peer, "flows %d\ngames %d\n", flows, games) == ERROR_CODE ||
+            admin_reply(peer, "dropped-invalid %llu\ndropped-unknown-game %llu\ndropped-no-game-number %llu\ndropped-no-backend %llu\n"
+            "dropped-no-flow %llu\nstale-replies %llu\nsend-failed %llu\n", (unsigned long long)proxy.stats.invalid,
+            (unsigned long long)proxy.stats.unknownGame, (unsigned long long)proxy.stats.noGameNumber, (unsigned long long)proxy.stats.noBackend,
+            (unsigned long long)proxy.stats.noFlow, (unsigned long long)proxy.stats.staleReplies, (unsigned long long)proxy.stats.sendFailed) == ERROR_CODE) {
+            return ERROR_CODE;
+        }
+    } else if ((strcmp(word, "drain") == 0 || strcmp(word, "undrain") == 0) && sscanf(line, "%*s %s %c", name, &extra) == 1) {
+        if ((b = find_backend(name)) == ERROR_CODE) return admin_reply(peer, "error: no backend %s\n", name);
+        proxy.backends[b].draining = (strcmp(word, "drain") == 0);
+        build_ring();
+        printf("[+]Backend %d %s.\n", b, proxy.backends[b].draining ? "draining" : "taking new games again");
+    } else {
+        return admin_reply(peer, "error: unknown command (stats, drain <backend>, undrain <backend>)\n");
+    }
+    return admin_reply(peer, "ok\n");
+}
+
+/**
+ * @brief Finds a backend by its index or its <ip>:<port> address.
+ *
+ * @param name The index or address of the backend.
+ * @return The backend index, or an error code if there is no such backend.
+ */
+int find_backend(const char *name) {
+    int b;
+    char *end;
+    long index = strtol(name, &end, 10);
+    if (*end == '\0') return (index >= 0 && index < proxy.numBackends) ? (int)index : ERROR_CODE;
+    for (b = 0; b < proxy.numBackends; b++) {
+        char address[ADMIN_LINE];
+        snprintf(address, sizeof(address), "%s:%d", inet_ntoa(proxy.backends[b].addr.sin_addr), ntohs(proxy.backends[b].addr.sin_port));
+        if (strcmp(address, name) == 0) return b;
+    }
+    return ERROR_CODE;
+}
@@ -4,9 +4,13 @@
 /* forth, between two computers.                           */
 /***********************************************************/
 
+/* Needed for CPU affinity */
+#define _GNU_SOURCE
+
 /* #include files go here */
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <errno.h>
 #include <time.h>
@@ -18,11 +22,28 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <poll.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <linux/sock_diag.h>
+#include "tictactoeEngine.h"
+#include "tictactoeTrace.h"
+#include "tictactoePool.h"
+#include "tictactoeWorkers.h"
+#include "tictactoeCache.h"
+#include "tictactoeCapture.h"
+#include "tictactoeShm.h"
+#include "tictactoeStream.h"
+#include "tictactoeProbes.h"
 
 /* The protocol version number used. */
 #define VERSION 3
 
-/* The number of command line arguments. */
+/* The number of command line arguments (excluding options). */
 #define NUM_ARGS 2
 /* The maximum size of a buffer for the program. */
 #define BUFFER_SIZE 100
@@ -31,26 +52,301 @@
 /* The number of seconds spend waiting before a timeout. */
 #define TIMEOUT 30
 
-/* The number of rows for the TicIacToe board. */
-#define ROWS 3
-/* The number of columns for the TicIacToe board. */
-#define COLUMNS 3
-/* The maximum number of games the server can play simultaneously. */
+/* The board variant played when a NEW_GAME command does not request one (3x3). */
+#define DEFAULT_VARIANT 0
+/* The default time budget (in milliseconds) of a parallel move search. */
+#define SEARCH_BUDGET 2000
+/* The default maximum number of games the server can play simultaneously (-g changes it). */
 #define MAX_GAMES 10
+/* The most games -g allows (the game number of a command datagram is a signed byte). */
+#define MAX_GAMES_LIMIT 127
+#if MAX_GAMES > MAX_GAMES_LIMIT
+#error "MAX_GAMES must fit in the game number of a command datagram"
+#endif
+/* The maximum number of idle games kept in cold storage. */
+#define COLD_GAMES 1024
+/* The number of seconds an idle game is kept in cold storage before it times out. */
+#define COLD_TIMEOUT 600
+/* The number of positions kept in the ANALYZE position cache. */
+#define CACHE_SIZE 4096
+/* The number of microseconds the kernel busy-polls the device queue in low-latency mode. */
+#define BUSY_POLL_USEC 50
+/* The number of milliseconds the receive loop spins after the last event before it sleeps. */
+#define SPIN_TIME 200
+/* The number of bytes of stack touched up front in low-latency mode (covers the deepest search). */
+#define STACK_PREFAULT (512 * 1024)
+/* The number of seconds between drop reports and socket buffer adjustments. */
+#define TUNE_INTERVAL 1
+/* The number of drop-free intervals before an underused socket buffer is shrunk. */
+#define SHRINK_INTERVALS 60
+/* The number of datagrams received between samples of the receive queue depth. */
+#define QUEUE_SAMPLE 16
+/* The maximum number of clients connected over the shared-memory transport at once. */
+#define SHM_PEERS 16
+/* The maximum number of commands taken from each shared-memory client per loop iteration. */
+#define SHM_BATCH 32
+/* The address shared-memory clients are known by in the roster (never a UDP source address). */
+#define SHM_ADDR INADDR_ANY
+/* The maximum number of clients connected over the stream transport at once. */
+#define STREAM_PEERS 32
+/* The maximum number of pipelined commands taken from each stream client per loop iteration. */
+#define STREAM_BATCH 32
+/* The output space (in bytes) a stream client must have free before more of its commands are handled. */
+#define STREAM_RESERVE (STREAM_BUFFER / 2)
+/* The address stream clients are known by in the roster (never a UDP source address). */
+#define STREAM_ADDR INADDR_BROADCAST
+/* The maximum number of received commands waiting to be dispatched. */
+#define PENDING_COMMANDS 256
+/* The number of hash buckets the sources of waiting commands are found by (a power of two). */
+#define SOURCE_BUCKETS 64
+/* The maximum number of datagrams taken from the socket at once. */
+#define RECEIVE_BATCH 32
+/* The number of milliseconds of dispatching after which new commands are received before new work is admitted. */
+#define RECEIVE_REFRESH 1
+/* The priorities of received commands: moves of games in progress are served before new work. */
+#define PRIORITY_MOVE 0    // MOVE commands, earliest game deadline first
+#define PRIORITY_ADMIT 1   // NEW_GAME and ANALYZE commands, in turns between their sources
+/* The maximum number of clients connected to the admin socket at once. */
+#define ADMIN_PEERS 4
+/* The longest admin command line (in bytes, including the newline). */
+#define ADMIN_LINE 128
+/* The longest admin reply line (in bytes). */
+#define ADMIN_REPLY 256
+/* The size of each admin client's output buffer (replies not yet sent). */
+#define ADMIN_OUTPUT 4096
+/* The output buffer room a command needs before it is run (the longest reply, stats, is six lines of up to ADMIN_REPLY bytes). */
+#define ADMIN_RESERVE (6 * ADMIN_REPLY)
+/* The longest game timeout (in seconds) an admin can set. */
+#define MAX_TIMEOUT 3600
+/* The longest cold storage timeout (in seconds) an admin can set (cold deadlines are 16-bit). */
+#define MAX_COLD_TIMEOUT INT16_MAX
+/* The slot of the stream listener in the descriptors the receive loop waits on (its clients follow). */
+#define STREAM_EVENT (3 + 2 * SHM_PEERS)
+/* The slot of the admin socket in the descriptors the receive loop waits on (its clients follow). */
+#define ADMIN_EVENT (STREAM_EVENT + 1 + STREAM_PEERS)
+/* The number of descriptors the receive loop waits on (socket, engine, transport and admin clients). */
+#define NUM_EVENTS (ADMIN_EVENT + 1 + ADMIN_PEERS)
+/* The size of a cache line, which the hot and cold roster arrays are aligned to. */
+#define CACHE_LINE 64
 /* The baord marker used for Player 1 */
 #define P1_MARK 'X'
 /* The baord marker used for Player 2 */
 #define P2_MARK 'O'
 
-/* Structure for each game of TicTacToe. */
+/* Structure for the hot state of each game, scanned on every command (4 games per cache line). */
+struct Game_State {
+    struct TTT_Board board;     // TicTacToe game board state
+    int32_t deadline;           // server clock time (in seconds) at which the game times out
+    uint8_t player;             // current player's turn (0 if the game is open)
+    uint8_t variant;            // board variant being played
+    uint16_t lastMove : 5;      // square of Player 2's last move (0 before its first)
+    uint16_t lastReply : 5;     // square of Player 1's last move, sent again if Player 2 repeats its command
+    uint16_t reserved : 6;      // unused (pads the state to 16 bytes)
+};
+
+/* Structure for the cold bookkeeping of each game, only used when the game receives a command. */
+struct Game_Info {
+    in_addr_t p2Addr;           // IP address of remote player for game
+    in_port_t p2Port;           // port number of remote player for game
+    uint8_t tag;                // tag of the NEW_GAME command that opened the game (0 for none)
+    uint8_t reserved;           // unused (pads the info to 8 bytes)
+};
+
+/* Structure for an idle game evicted to cold storage (always waiting on Player 2's move). */
+struct Cold_Game {
+    uint64_t packed;            // board in base 3 (bits 0-39), variant (bits 40-41), game number (bits 42-49), Player 2 has moved (bit 50), last reply (bits 51-55), then Player 2's last move or, before its first, the tag (bits 56-63), 0 if unused
+    in_addr_t p2Addr;           // IP address of remote player for game
+    in_port_t p2Port;           // port number of remote player for game
+    uint16_t expires;           // low 16 bits of the server clock time at which the game times out
+};
+
+/* Structure for a Player 1 move computed by an engine worker. */
+struct Move_Job {
+    struct Engine_Job job;      // engine job header (must be first)
+    int gameIndex;              // roster index of the game the move is for
+    int command;                // command that the move answers
+    uint8_t variant;            // board variant being searched
+    struct TTT_Board board;     // snapshot of the board when the job was queued
+    int move;                   // square (1-based) chosen by the worker
+    uint64_t queued;            // trace_clock() time the job was queued
+    uint64_t started;           // trace_clock() time a worker started the search
+    uint64_t finished;          // trace_clock() time the worker finished the search
+    struct Trace_Record trace;  // latency record of the command, set aside during the search
+    int score;                  // ANALYZE: minimax score of the move for the player to move
+    struct sockaddr_in playerAddr;  // ANALYZE: address the analysis is sent to
+    char tag;                   // ANALYZE: game number field echoed back to the player
+};
+
+/* Structure-of-arrays roster of every game the server can play simultaneously. */
+struct TTT_Roster {
+    struct Game_State *state;           // hot game state (maxGames slots, cache-line aligned)
+    struct Game_Info *info;             // cold game bookkeeping (maxGames slots, cache-line aligned)
+    struct Move_Job **pending;          // move being computed for each game (NULL if none)
+    struct Cold_Game cold[COLD_GAMES];  // idle games evicted from the hot arrays
+};
+
+/* Structure referring to a single game of TicTacToe in the roster. */
 struct TTT_Game {
-    int gameNum;                    // game number
-    double timeout;                 // amount of time before game timeout
-    struct sockaddr_in p2Address;   // address of remote player for game
-    int player;                     // current player's turn
-    char board[ROWS*COLUMNS];       // TicTacToe game board state
+    int gameNum;                // game number (roster index + 1)
+    struct Game_State *state;   // hot state of the game
+    struct Game_Info *info;     // cold bookkeeping of the game
+    struct Move_Job **pending;  // move being computed for the game (NULL if none)
+};
+
+/* Structure for the options the server was started with. */
+struct Server_Options {
+    int trace;          // whether or not stage latency tracing is turned on
+    int traceInterval;  // number of seconds between trace dumps (0 for SIGUSR1 only)
+    int searchThreads;  // number of threads used by the parallel search (0 to turn it off)
+    int searchBudget;   // time budget (in milliseconds) of each parallel search
+    int benchmark;      // whether to run the parallel search benchmark instead of serving
+    int engineWorkers;  // number of engine workers computing moves (0 to compute them inline)
+    int batchMoves;     // whether the inline moves of each scheduler pass are searched together
+    int lowLatency;     // whether to spin on the socket with locked memory instead of sleeping
+    int pinCpu;         // CPU the receive loop is pinned to (-1 for no pinning)
+    int fifoPriority;   // SCHED_FIFO priority of the receive loop (0 for the default scheduler)
+    const char *captureFile;    // file every received datagram is captured to (NULL for none)
+    const char *replayFile;     // capture replayed in-process instead of serving (NULL for none)
+    int replaySpeed;    // replay speed multiplier (0 to replay as fast as possible)
+    const char *shmPath;        // Unix socket shared-memory clients register on (NULL for none)
+    const char *streamAddress;  // TCP port or Unix socket path stream clients connect to (NULL for none)
+    int minBuffer;      // smallest socket buffer (in bytes) automatic tuning may set (0 for no tuning)
+    int maxBuffer;      // largest socket buffer (in bytes) automatic tuning may set
+    const char *adminPath;      // Unix socket admin clients connect to (NULL for none)
+    int maxGames;       // number of roster slots (the most games an admin can raise the capacity to)
+};
+
+/* Structure for the limits the server runs under, which an admin can change while it runs. */
+struct Server_Limits {
+    int32_t timeout;        // seconds a game waits on its player before it times out
+    int32_t coldTimeout;    // seconds an idle game is kept in cold storage
+    int capacity;           // number of roster slots new games are started in (up to maxGames)
+};
+
+/* Structure for the datagrams dropped by the kernel and by the server itself. */
+struct Drop_Stats {
+    uint32_t kernel;        // datagrams the kernel dropped (receive queue full), from SO_RXQ_OVFL
+    uint64_t invalid;       // datagrams discarded by validate_command()
+    uint64_t rejected;      // valid commands discarded by the command handlers
+    uint64_t sendFailed;    // replies the kernel refused to send
+    uint64_t received;      // datagrams received
+    uint64_t timedOut;      // games reset because their deadline passed (not those moved to cold storage)
+    uint64_t repeated;      // repeated commands answered with their last reply again
+};
+
+/* Structure for a client connected over the shared-memory transport. */
+struct Shm_Peer {
+    struct Shm_Endpoint endpoint;   // server side of the connection (conn is -1 if the slot is free, channel NULL until registered)
+    uint16_t id;                    // port number the client is known by in the roster
+    uint64_t registerBy;            // trace_clock() time after which an unregistered client loses its slot
+};
+
+/* Structure for a client connected over the stream transport. */
+struct Stream_Peer {
+    struct Stream_Conn conn;        // server side of the connection (fd is -1 if the slot is free)
+    uint16_t id;                    // port number the client is known by in the roster
+    int closing;                    // set once the client has shut down its side of the connection
+};
+
+/* Structure for a client connected to the admin socket. */
+struct Admin_Peer {
+    int fd;                     // connected socket (-1 if the slot is free)
+    int length;                 // number of bytes in the input buffer
+    int outLength;              // number of bytes in the output buffer
+    int listing;                // next game a list in progress sends (-1 if no list is in progress)
+    int closing;                // set once the client has shut down its side of the connection
+    char input[ADMIN_LINE];     // bytes received and not yet parsed into lines
+    char output[ADMIN_OUTPUT];  // replies not yet sent
+};
+
+/* Structure for a parallel search of a single board. */
+struct Parallel_Search {
+    const struct TTT_Variant *variant;  // board variant being searched
+    struct TTT_Board board;             // board being searched (Player 1 to move)
+    int horizon;                        // number of plies searched after each root move
+    atomic_int alpha;                   // best root score found so far (shared cutoff bound)
+    atomic_int stop;                    // set once the time budget has run out
+    uint64_t deadline;                  // trace_clock() time the search must stop by
+    pthread_mutex_t lock;               // protects the best move and node count
+    int bestMove, bestValue;            // best root move (0-based) and score this iteration
+    uint64_t nodes;                     // number of nodes searched by all tasks
+};
+
+/* Structure for the task that searches one root move of a parallel search. */
+struct Root_Task {
+    struct Parallel_Search *search;     // search the move belongs to
+    int square;                         // root move (0-based) to search
 };
 
+/* The settings used for the parallel search of the larger board variants. */
+static struct {
+    int enabled;        // whether larger boards are searched in parallel
+    struct Pool *pool;  // work-stealing pool (NULL to search on the calling thread only)
+    int budget;         // time budget (in milliseconds) of each search
+} searchSettings;
+
+/* The engine workers computing moves off the receive loop (NULL to compute them inline). */
+static struct Engine_Pool *engine;
+/* The inline moves set aside to be searched together in lockstep at the end of a scheduler pass. */
+static struct {
+    int enabled;                        // whether inline moves are batched
+    int count;                          // number of moves set aside (including cancelled ones)
+    struct Move_Job *jobs;              // moves set aside, in the order they were requested (maxGames slots)
+} moveBatch;
+/* The cache of analyzed positions shared by the threads handling ANALYZE commands. */
+static struct Position_Cache *analysisCache;
+/* Whether the receive loop spins on the socket instead of sleeping (low-latency mode). */
+static int spinReceive;
+/* The capture file received datagrams are written to (file is NULL when not capturing). */
+static struct Capture_Writer capture;
+/* The drop counts so far, and when they were last reported. */
+static struct Drop_Stats dropStats, reportedDrops;
+/* The state of the drop reports and automatic socket buffer tuning. */
+static struct {
+    int minBuffer, maxBuffer;   // bounds of the buffer sizes set (maxBuffer is 0 for no tuning)
+    int rcvBuffer, sndBuffer;   // buffer sizes last set (as passed to setsockopt())
+    uint32_t queuePeak;         // most bytes seen queued on the receive socket this interval
+    uint32_t windowPeak;        // most bytes seen queued since the last adjustment
+    int quietIntervals;         // number of intervals in a row without kernel drops
+    int sendQuietIntervals;     // number of intervals in a row without failed sends
+    uint64_t nextCheck;         // trace_clock() time of the next report
+} socketTuning;
+/* The clients connected over the shared-memory transport. */
+static struct {
+    int listenFd;                       // registration socket (-1 if the transport is off)
+    int numPeers;                       // number of connected clients
+    uint16_t nextId;                    // id given to the next client that registers
+    struct Shm_Peer peers[SHM_PEERS];   // connected clients
+} shmTransport = {.listenFd = -1};
+/* The clients connected over the stream transport. */
+static struct {
+    int listenFd;                           // listening socket (-1 if the transport is off)
+    int numPeers;                           // number of connected clients
+    uint16_t nextId;                        // id given to the next client that connects
+    struct Stream_Peer peers[STREAM_PEERS]; // connected clients
+} streamTransport = {.listenFd = -1};
+/* The number of slots in the game roster (set once at startup). */
+static int maxGames = MAX_GAMES;
+/* The limits in force (the defaults until an admin changes them). */
+static struct Server_Limits limits = {TIMEOUT, COLD_TIMEOUT, MAX_GAMES};
+/* The admin socket and the changes its clients asked for, applied together between loop iterations. */
+static struct {
+    int listenFd;                       // admin socket (-1 if admin control is off)
+    struct Admin_Peer peers[ADMIN_PEERS];   // connected admin clients
+    int changed;                        // whether any change is waiting to be applied
+    struct Server_Limits staged;        // limits to put in force
+    uint8_t freeing[MAX_GAMES_LIMIT];   // games to free (by roster index)
+} adminControl = {.listenFd = -1};
+/* The semaphores of the static tracepoints (raised by a tracer attached to the probe). */
+PROBE_SEMAPHORE(receive);
+PROBE_SEMAPHORE(reject);
+PROBE_SEMAPHORE(dispatch);
+PROBE_SEMAPHORE(search__start);
+PROBE_SEMAPHORE(search__end);
+PROBE_SEMAPHORE(send);
+PROBE_SEMAPHORE(free__game);
+PROBE_SEMAPHORE(timeout);
+
 /* Structure to send and recieve player datagrams. */
 struct Buffer {
     char version;   // version number
@@ -59,6 +355,57 @@ struct Buffer {
     char gameNum;   // game number
 };
 
+/* Structure to recieve player datagrams of any command (the board only follows ANALYZE). */
+struct Command_Datagram {
+    struct Buffer header;   // command header
+    uint32_t board[2];      // base 3 packed board, high and low words (network byte order)
+};
+
+/* Structure for a command waiting in the scheduler between receive and dispatch. */
+struct Pending_Command {
+    struct sockaddr_in playerAddr;      // address of the remote player (or transport client)
+    struct Command_Datagram command;    // validated command
+    int source;                         // scheduler index of the command's source
+    int next;                           // next command in the same list (arrivals or the source's admissions, -1 if last)
+    int32_t deadline;                   // deadline of a MOVE's game when the command was ordered (INT32_MAX if it has none)
+    uint64_t sequence;                  // arrival order of the command
+    uint64_t queued;                    // trace_clock() time the command was queued (0 unless the dispatch probe is on)
+    struct Trace_Record trace;          // latency record of the command, set aside while it waits
+};
+
+/* Structure for a remote player (or transport client) with commands waiting in the scheduler. */
+struct Command_Source {
+    struct sockaddr_in addr;    // address of the source
+    int count;                  // number of its commands waiting
+    int first, last;            // its admissions waiting, in arrival order (-1 if none)
+    int nextTurn;               // next source waiting for its turn to admit (-1 if last)
+    int nextInBucket;           // next source in the same hash bucket (-1 if last)
+};
+
+/* The commands received and waiting to be dispatched. New commands wait as arrivals until the
+ * next pick orders them: moves in a heap by (deadline, sequence), admissions in one FIFO per
+ * source, with the sources taking turns. */
+static struct {
+    int count;                                          // number of commands waiting
+    uint64_t sequence;                                  // number of commands queued so far
+    int freeCommands[PENDING_COMMANDS];                 // free command slots (those from count on)
+    int firstArrival, lastArrival;                      // commands not ordered yet, in arrival order (-1 if none)
+    int numMoves;                                       // number of moves in the heap
+    int moves[PENDING_COMMANDS];                        // heap of moves, earliest (deadline, sequence) first
+    int firstTurn, lastTurn;                            // sources with admissions, in turn order (-1 if none)
+    int numSources;                                     // number of sources with commands waiting
+    int freeSources[PENDING_COMMANDS];                  // free source slots (those from numSources on)
+    int buckets[SOURCE_BUCKETS];                        // first source in each hash bucket (-1 if none)
+    struct Command_Source sources[PENDING_COMMANDS];    // sources with commands waiting
+    struct Pending_Command queue[PENDING_COMMANDS];     // commands waiting
+} scheduler;
+
+/* Structure to send the result of an ANALYZE command. */
+struct Analysis {
+    struct Buffer header;   // ANALYZE header (data is the best square + '0')
+    int32_t score;          // minimax score of the best move for the player to move (network byte order)
+};
+
 /*******************/
 /* PLAYER COMMANDS */
 /*******************/
@@ -69,9 +416,12 @@ typedef void (*command_handler)(int sd, const struct sockaddr_in *playerAddr, co
 #define NEW_GAME 0x00
 /* The command to issue a move. */
 #define MOVE 0x01
+/* The command to analyze a board without playing a game. */
+#define ANALYZE 0x02
 
 void new_game(int sd, const struct sockaddr_in *playerAddr, const struct Buffer *datagram, struct TTT_Game *game);
 void move(int sd, const struct sockaddr_in *playerAddr, const struct Buffer *datagram, struct TTT_Game *game);
+void analyze(int sd, const struct sockaddr_in *playerAddr, const struct Buffer *datagram, struct TTT_Game *game);
 
 /********************************/
 /* SOCKET AND NETWORK FUNCTIONS */
@@ -79,33 +429,200 @@ void move(int sd, const struct sockaddr_in *playerAddr, const struct Buffer *dat
 
 void print_error(const char *msg, int errnum, int terminate);
 void handle_init_error(const char *msg, int errnum);
-void extract_args(char *argv[], int *port);
+void extract_args(int argc, char *argv[], int *port, struct Server_Options *options);
 void print_server_info(struct sockaddr_in serverAddr);
 int create_endpoint(struct sockaddr_in *socketAddr, unsigned long address, int port);
-void set_timeout(int sd, int seconds);
-void check_timeout(struct TTT_Game roster[MAX_GAMES]);
+void enable_timestamps(int sd);
+uint64_t get_queue_time(struct msghdr *msg);
+int32_t server_clock(void);
+void check_timeout(struct TTT_Roster *roster);
 int same_address(const struct sockaddr_in *addr1, const struct sockaddr_in *addr2);
+struct sockaddr_in player_address(const struct TTT_Game *game);
+struct sockaddr_in client_address(in_addr_t transport, uint16_t id);
+ssize_t deliver_reply(int sd, const void *reply, size_t length, const struct sockaddr_in *playerAddr);
+ssize_t udp_reply(int sd, const void *reply, size_t length, const struct sockaddr_in *playerAddr);
+ssize_t discard_reply(int sd, const void *reply, size_t length, const struct sockaddr_in *playerAddr);
+
+/* Function pointer type for the function that sends replies to remote players. */
+typedef ssize_t (*reply_sender)(int sd, const void *reply, size_t length, const struct sockaddr_in *playerAddr);
+/* The function replies are sent with (discard_reply() while replaying a capture). */
+static reply_sender send_reply = deliver_reply;
+/* The number of replies discarded while replaying a capture. */
+static uint64_t repliesDiscarded;
 
 /******************************/
 /* TIC-TAC-TOE GAME FUNCTIONS */
 /******************************/
 
 void init_shared_state(struct TTT_Game *game);
-void init_game_roster(struct TTT_Game roster[MAX_GAMES]);
-int games_in_progress(struct TTT_Game roster[MAX_GAMES]);
-int find_open_game(struct TTT_Game roster[MAX_GAMES]);
-int get_command(int sd, struct sockaddr_in *playerAddr, struct Buffer *datagram);
-int minimax(struct TTT_Game *game, int depth, int isMax);
+void init_game_roster(struct TTT_Roster *roster);
+struct TTT_Game get_game(struct TTT_Roster *roster, int index);
+const struct TTT_Variant *get_variant(const struct TTT_Game *game);
+int games_in_progress(const struct TTT_Roster *roster);
+int find_open_game(const struct TTT_Roster *roster);
+int find_tagged_game(const struct TTT_Roster *roster, const struct sockaddr_in *playerAddr, int tag);
+int receive_commands(int sd);
+int validate_command(const struct Command_Datagram *command, int length);
+void dispatch_command(int sd, struct TTT_Roster *roster, const struct sockaddr_in *playerAddr, const struct Buffer *datagram, uint64_t waited);
+int search_board(const struct TTT_Variant *variant, const struct TTT_Board *board);
 int find_best_move(struct TTT_Game *game);
 int check_win(const struct TTT_Game *game);
 int check_draw(const struct TTT_Game *game);
 void print_board(const struct TTT_Game *game);
 int validate_move(int choice, const struct TTT_Game *game);
-int send_p1_move(int sd, struct TTT_Game *game);
+void mark_square(struct TTT_Game *game, int square, int player);
+void request_p1_move(int sd, struct TTT_Game *game, int command);
+int send_p1_move(int sd, struct TTT_Game *game, int move);
+void finish_p1_move(int sd, struct TTT_Game *game, int move);
+void repeat_reply(int sd, struct TTT_Game *game);
+void cancel_move(struct TTT_Game *game);
+void reset_game(struct TTT_Game *game);
 void free_game(struct TTT_Game *game);
 int game_over(struct TTT_Game *game);
 void tictactoe(int sd);
 
+/**************************/
+/* COLD STORAGE FUNCTIONS */
+/**************************/
+
+uint64_t pack_game(const struct TTT_Game *game);
+void unpack_game(uint64_t packed, struct TTT_Game *game);
+int cold_game_number(uint64_t packed);
+int cold_game_tag(uint64_t packed);
+int can_evict(const struct TTT_Roster *roster, int index);
+int evict_game(struct TTT_Roster *roster, int index);
+int evict_idle_game(struct TTT_Roster *roster);
+int evict_idle_games(struct TTT_Roster *roster);
+int find_cold_game(const struct TTT_Roster *roster, const struct sockaddr_in *playerAddr, int gameNum);
+int find_cold_tagged_game(const struct TTT_Roster *roster, const struct sockaddr_in *playerAddr, int tag);
+void restore_game(struct TTT_Roster *roster, int index, const struct Cold_Game *cold);
+void expire_cold_games(struct TTT_Roster *roster);
+int locate_game(struct TTT_Roster *roster, const struct sockaddr_in *playerAddr, const struct Buffer *datagram);
+
+/*******************************/
+/* POSITION ANALYSIS FUNCTIONS */
+/*******************************/
+
+int analyze_board(const struct TTT_Variant *variant, const struct TTT_Board *board, int *score);
+void send_analysis(int sd, const struct sockaddr_in *playerAddr, char tag, int move, int score);
+
+/***************************/
+/* ENGINE WORKER FUNCTIONS */
+/***************************/
+
+void compute_move(struct Engine_Job *job);
+void collect_moves(int sd, struct TTT_Roster *roster);
+void search_move_batch(int sd, struct TTT_Roster *roster);
+
+/********************************/
+/* CAPTURE AND REPLAY FUNCTIONS */
+/********************************/
+
+void wait_for_replay(uint64_t due, struct TTT_Roster *roster);
+void wait_for_move(struct TTT_Roster *roster, int index);
+void replay_capture(const char *path, int speed);
+
+/****************************/
+/* DROP TELEMETRY FUNCTIONS */
+/****************************/
+
+void enable_drop_counts(int sd);
+void read_drop_count(struct msghdr *msg);
+int read_socket_memory(int sd, uint32_t *meminfo);
+void sample_queue_depth(int sd);
+int set_buffer_size(int sd, int option, int forceOption, int bytes);
+void start_buffer_tuning(int sd, int minBuffer, int maxBuffer);
+void tune_buffers(int sd, const struct Drop_Stats *delta);
+void report_drops(int sd);
+
+/*************************************/
+/* SHARED-MEMORY TRANSPORT FUNCTIONS */
+/*************************************/
+
+void start_shm_transport(const char *path);
+void accept_shm_peer(void);
+void register_shm_peer(int index);
+void drop_shm_peer(int index);
+void watch_shm_peers(struct pollfd *events);
+void handle_shm_events(struct pollfd *events);
+int queue_shm_commands(void);
+int shm_requests_waiting(void);
+int arm_shm_peers(void);
+void disarm_shm_peers(void);
+ssize_t shm_reply(int sd, const void *reply, size_t length, const struct sockaddr_in *playerAddr);
+
+/******************************/
+/* STREAM TRANSPORT FUNCTIONS */
+/******************************/
+
+void start_stream_transport(const char *address);
+void accept_stream_peer(void);
+void drop_stream_peer(int index);
+int stream_peer_ready(const struct Stream_Peer *peer);
+void watch_stream_peers(struct pollfd *events);
+void handle_stream_events(struct pollfd *events);
+int queue_stream_commands(void);
+void flush_stream_peers(void);
+int stream_requests_waiting(void);
+ssize_t stream_reply(int sd, const void *reply, size_t length, const struct sockaddr_in *playerAddr);
+
+/*******************************/
+/* COMMAND SCHEDULER FUNCTIONS */
+/*******************************/
+
+void init_scheduler(void);
+int find_source(const struct sockaddr_in *playerAddr, int *bucket);
+void queue_command(const struct sockaddr_in *playerAddr, const struct Command_Datagram *command);
+int count_source_commands(const struct sockaddr_in *playerAddr);
+int queue_commands(int sd, int readSocket);
+int command_priority(struct TTT_Roster *roster, const struct Pending_Command *pending, int32_t *deadline);
+int earlier_move(int index1, int index2);
+void push_move(int index);
+void pop_move(void);
+void order_arrivals(struct TTT_Roster *roster);
+int next_command(struct TTT_Roster *roster, int *priority);
+void take_command(int index, int priority);
+int run_scheduler(int sd, struct TTT_Roster *roster);
+
+/***************************/
+/* ADMIN CONTROL FUNCTIONS */
+/***************************/
+
+void start_admin_control(const char *path);
+void accept_admin_peer(void);
+void drop_admin_peer(int index);
+void watch_admin_peers(struct pollfd *events);
+short admin_peer_events(const struct Admin_Peer *peer);
+void handle_admin_events(struct pollfd *events, struct TTT_Roster *roster);
+int serve_admin_peer(struct Admin_Peer *peer, struct TTT_Roster *roster);
+int flush_admin_peer(struct Admin_Peer *peer);
+int admin_reply(struct Admin_Peer *peer, const char *format, ...) __attribute__((format(printf, 2, 3)));
+int run_admin_command(struct Admin_Peer *peer, char *line, struct TTT_Roster *roster);
+int report_status(struct Admin_Peer *peer, const struct TTT_Roster *roster);
+void list_games(struct Admin_Peer *peer, struct TTT_Roster *roster);
+void describe_player(char *text, size_t size, in_addr_t addr, in_port_t port);
+void apply_admin_changes(struct TTT_Roster *roster);
+
+/*************************/
+/* LOW-LATENCY FUNCTIONS */
+/*************************/
+
+void enable_busy_poll(int sd);
+void pin_thread(pthread_t thread, int cpu);
+void set_realtime(int priority);
+void lock_memory(void);
+void prefault_stack(void);
+int wait_for_events(struct pollfd *events, int numEvents);
+
+/*****************************/
+/* PARALLEL SEARCH FUNCTIONS */
+/*****************************/
+
+void search_root_task(void *arg);
+int search_iteration(struct Parallel_Search *search, struct Pool *pool, int firstMove);
+int parallel_find_best_move(const struct TTT_Variant *variant, const struct TTT_Board *board, struct Pool *pool, int budget, int maxHorizon, uint64_t *nodes);
+void run_search_benchmark(int maxThreads);
+
 /**
  * @brief This program creates and sets up a TicTacToe server which acts as Player 1 in a
  * 2-player game of TicTacToe. This server creates a server socket for the clients to communicate
@@ -129,14 +646,124 @@ void tictactoe(int sd);
 int main(int argc, char *argv[]) {
     int sd, portNumber;
     struct sockaddr_in serverAddress;
+    struct Server_Options options = {0};
+
+    /* Extract options and arguments to their respective variables */
+    options.searchBudget = SEARCH_BUDGET;
+    options.pinCpu = -1;
+    options.replaySpeed = 1;
+    options.maxGames = MAX_GAMES;
+    extract_args(argc, argv, &portNumber, &options);
+
+    /* Size the roster (new games start in every slot until an admin lowers the capacity) */
+    maxGames = limits.capacity = options.maxGames;
+
+    /* Run the parallel search benchmark instead of the server if requested */
+    if (options.benchmark) {
+        run_search_benchmark((options.searchThreads > 0) ? options.searchThreads : 1);
+        return 0;
+    }
+
+    /* Create server socket and print server information (not needed to replay a capture) */
+    if (options.replayFile == NULL) {
+        sd = create_endpoint(&serverAddress, INADDR_ANY, portNumber);
+        print_server_info(serverAddress);
+    } else {
+        sd = ERROR_CODE;
+    }
+
+    /* Turn on stage latency tracing if requested */
+    if (options.trace) {
+        if (sd >= 0) enable_timestamps(sd);
+        trace_init(options.traceInterval);
+        printf("[+]Tracing enabled. Send SIGUSR1 to dump stage latencies.\n");
+    }
+
+    /* Count kernel drops and tune the socket buffers if requested */
+    if (sd >= 0) {
+        enable_drop_counts(sd);
+        if (options.maxBuffer > 0) start_buffer_tuning(sd, options.minBuffer, options.maxBuffer);
+    }
+
+    /* Accept shared-memory clients if requested */
+    if (options.shmPath != NULL && sd >= 0) {
+        start_shm_transport(options.shmPath);
+        printf("[+]Shared-memory clients register at %s.\n", options.shmPath);
+    }
+
+    /* Accept stream clients if requested */
+    if (options.streamAddress != NULL && sd >= 0) {
+        start_stream_transport(options.streamAddress);
+        printf("[+]Stream clients connect at %s.\n", options.streamAddress);
+    }
+
+    /* Accept admin clients if requested */
+    if (options.adminPath != NULL && sd >= 0) {
+        start_admin_control(options.adminPath);
+        printf("[+]Admin clients connect at %s.\n", options.adminPath);
+    }
+
+    /* Capture every received datagram if requested */
+    if (options.captureFile != NULL && sd >= 0) {
+        if (capture_open(&capture, options.captureFile) < 0) handle_init_error("-c: Unable to create capture file", errno);
+        if (!options.trace) enable_timestamps(sd);
+        printf("[+]Capturing received datagrams to %s.\n", options.captureFile);
+    }
+
+    /* Start the parallel search threads if requested (the server thread also searches) */
+    if (options.searchThreads > 0) {
+        searchSettings.enabled = 1;
+        searchSettings.budget = options.searchBudget;
+        if (options.searchThreads > 1 && (searchSettings.pool = pool_create(options.searchThreads - 1)) == NULL) {
+            handle_init_error("-j: Unable to create search threads", 0);
+        }
+        printf("[+]Parallel search enabled with %d thread(s) and a %d ms budget.\n", options.searchThreads, options.searchBudget);
+    }
 
-    /* If arg count correct, extract arguments to their respective variables */
-    if (argc != NUM_ARGS) handle_init_error("argc: Invalid number of command line arguments", 0);
-    extract_args(argv, &portNumber);
+    /* Create the position cache used by the ANALYZE command */
+    if ((analysisCache = cache_create(CACHE_SIZE)) == NULL) print_error("main: Unable to create position cache", 0, 1);
+
+    /* Start the engine workers if requested */
+    if (options.engineWorkers > 0) {
+        if ((engine = engine_create(options.engineWorkers)) == NULL) {
+            handle_init_error("-w: Unable to create engine workers", 0);
+        }
+        printf("[+]Moves computed by %d engine worker(s).\n", options.engineWorkers);
+    }
+
+    /* Search the moves of each scheduler pass together if requested */
+    if (options.batchMoves) {
+        if (engine != NULL) handle_init_error("-M: Batched moves are searched inline, not by engine workers", 0);
+        moveBatch.enabled = 1;
+        if ((moveBatch.jobs = calloc(maxGames, sizeof(struct Move_Job))) == NULL) print_error("main: Unable to allocate the move batch", 0, 1);
+        printf("[+]Moves of each scheduler pass searched together, %d boards per lockstep pass.\n", TTT_LANES);
+    }
+
+    /* Trade CPU for tail latency if requested (after every thread and buffer is created) */
+    if (options.pinCpu >= 0) {
+        int i;
+        pin_thread(pthread_self(), options.pinCpu);
+        for (i = 0; engine != NULL && i < engine->numWorkers; i++) pin_thread(engine->threads[i], options.pinCpu + 1 + i);
+    }
+    if (options.fifoPriority > 0) set_realtime(options.fifoPriority);
+    if (options.lowLatency && sd >= 0) {
+        enable_busy_poll(sd);
+        lock_memory();
+        prefault_stack();
+        /* Spinning on the only CPU takes it from the clients and engine workers, worsening the tail */
+        if (sysconf(_SC_NPROCESSORS_ONLN) > 1) {
+            spinReceive = 1;
+            printf("[+]Low-latency mode enabled (spinning receive loop, locked memory).\n");
+        } else {
+            printf("[+]Low-latency mode enabled without spinning (only one CPU is online), locked memory.\n");
+        }
+    }
 
-    /* Create server socket and print server information */
-    sd = create_endpoint(&serverAddress, INADDR_ANY, portNumber);
-    print_server_info(serverAddress);
+    /* Replay the capture instead of serving if requested */
+    if (options.replayFile != NULL) {
+        replay_capture(options.replayFile, options.replaySpeed);
+        return 0;
+    }
 
     /* Start the TicTacToe server */
     tictactoe(sd);
@@ -172,7 +799,8 @@ void print_error(const char *msg, int errnum, int terminate) {
  */
 void handle_init_error(const char *msg, int errnum) {
     print_error(msg, errnum, 0);
-    printf("Usage is: tictactoeServer <remote-port>\n");
+    printf("Usage is: tictactoeServer [-g <max-games>] [-t <dump-interval>] [-j <search-threads>] [-d <search-budget-ms>] [-w <engine-workers>] [-M] [-L] [-p <cpu>] [-R <fifo-priority>] [-c <capture-file>] [-U <socket-path>] [-S <stream-port|socket-path>] [-b <min-kb>:<max-kb>] [-A <admin-socket-path>] [-B] <remote-port>\n");
+    printf("      or: tictactoeServer [-g <max-games>] [-t <dump-interval>] [-j <search-threads>] [-d <search-budget-ms>] [-w <engine-workers>] [-M] -r <capture-file> [-s <speed>]\n");
     /* Exits the process signaling unsuccessful termination */
     exit(EXIT_FAILURE);
 }
@@ -181,16 +809,105 @@ void handle_init_error(const char *msg, int errnum) {
  * @brief Extracts the user provided arguments to their respective local variables and performs
  * validation on their formatting. If any errors are found, the function terminates the process.
  * 
+ * @param argc Non-negative value representing the number of arguments passed to the program
+ * from the environment in which the program is run.
  * @param argv Pointer to the first element of an array of argc + 1 pointers, of which the
  * last one is NULL and the previous ones, if any, point to strings that represent the
  * arguments passed to the program from the host environment. If argv[0] is not a NULL
  * pointer (or, equivalently, if argc > 0), it points to a string that represents the program
  * name, which is empty if the program name is not available from the host environment.
  * @param port The remote port number that the server should listen on
+ * @param options The options the server was started with.
  */
-void extract_args(char *argv[], int *port) {
-    /* Extract and validate remote port number */
-    *port = strtol(argv[1], NULL, 10);
+void extract_args(int argc, char *argv[], int *port, struct Server_Options *options) {
+    int opt;
+    /* Extract and validate any options */
+    while ((opt = getopt(argc, argv, "g:t:j:d:w:MLp:R:c:r:s:U:S:b:A:B")) != -1) {
+        switch (opt) {
+            case 'g':   // size the roster for the given number of games
+                options->maxGames = strtol(optarg, NULL, 10);
+                if (options->maxGames < 1 || options->maxGames > MAX_GAMES_LIMIT) handle_init_error("-g: Invalid maximum number of games", 0);
+                break;
+            case 't':   // turn on tracing with the given dump interval
+                options->trace = 1;
+                options->traceInterval = strtol(optarg, NULL, 10);
+                if (options->traceInterval < 0) handle_init_error("-t: Invalid dump interval", 0);
+                break;
+            case 'j':   // search the larger boards in parallel with the given number of threads
+                options->searchThreads = strtol(optarg, NULL, 10);
+                if (options->searchThreads < 1 || options->searchThreads > POOL_MAX_THREADS + 1) {
+                    handle_init_error("-j: Invalid number of search threads", 0);
+                }
+                break;
+            case 'd':   // time budget of each parallel search
+                options->searchBudget = strtol(optarg, NULL, 10);
+                if (options->searchBudget < 1) handle_init_error("-d: Invalid search budget", 0);
+                break;
+            case 'w':   // compute moves on the given number of engine workers
+                options->engineWorkers = strtol(optarg, NULL, 10);
+                if (options->engineWorkers < 1 || options->engineWorkers > MAX_WORKERS) {
+                    handle_init_error("-w: Invalid number of engine workers", 0);
+                }
+                break;
+            case 'M':   // search the moves of each scheduler pass together in lockstep
+                options->batchMoves = 1;
+                break;
+            case 'L':   // spin on the socket with locked memory for the lowest latency
+                options->lowLatency = 1;
+                break;
+            case 'p':   // pin the receive loop (and engine workers after it) to CPUs
+                options->pinCpu = strtol(optarg, NULL, 10);
+                if (options->pinCpu < 0 || options->pinCpu >= CPU_SETSIZE) handle_init_error("-p: Invalid CPU", 0);
+                break;
+            case 'R':   // run the receive loop under the SCHED_FIFO real-time scheduler
+                options->fifoPriority = strtol(optarg, NULL, 10);
+                if (options->fifoPriority < sched_get_priority_min(SCHED_FIFO) || options->fifoPriority > sched_get_priority_max(SCHED_FIFO)) {
+                    handle_init_error("-R: Invalid SCHED_FIFO priority", 0);
+                }
+                break;
+            case 'c':   // capture every received datagram to the given file
+                options->captureFile = optarg;
+                break;
+            case 'r':   // replay the given capture in-process instead of serving
+                options->replayFile = optarg;
+                break;
+            case 's':   // replay speed multiplier (0 for as fast as possible)
+                options->replaySpeed = strtol(optarg, NULL, 10);
+                if (options->replaySpeed < 0) handle_init_error("-s: Invalid replay speed", 0);
+                break;
+            case 'U':   // accept shared-memory clients on the given Unix socket
+                options->shmPath = optarg;
+                break;
+            case 'S':   // accept stream clients on the given TCP port or Unix socket
+                options->streamAddress = optarg;
+                break;
+            case 'b':   // tune the socket buffers between the given sizes (in KB)
+                if (sscanf(optarg, "%d:%d", &options->minBuffer, &options->maxBuffer) != 2 || options->minBuffer < 1
+                        || options->maxBuffer < options->minBuffer || options->maxBuffer > INT32_MAX / 1024) {
+                    handle_init_error("-b: Invalid buffer bounds", 0);
+                }
+                options->minBuffer *= 1024;
+                options->maxBuffer *= 1024;
+                break;
+            case 'A':   // accept admin clients on the given Unix socket
+                if (strchr(optarg, '/') == NULL) handle_init_error("-A: The admin socket must be a Unix socket path", 0);
+                options->adminPath = optarg;
+                break;
+            case 'B':   // run the parallel search benchmark and exit
+                options->benchmark = 1;
+                return;
+            default:
+                handle_init_error("Invalid option", 0);
+        }
+    }
+    /* A replay does not listen on a port */
+    if (options->replayFile != NULL) {
+        if (argc - optind != 0) handle_init_error("argc: Invalid number of command line arguments", 0);
+        return;
+    }
+    /* If arg count correct, extract and validate remote port number */
+    if (argc - optind + 1 != NUM_ARGS) handle_init_error("argc: Invalid number of command line arguments", 0);
+    *port = strtol(argv[optind], NULL, 10);
     if (*port < 1 || *port != (u_int16_t)(*port)) handle_init_error("remote-port: Invalid port number", 0);
 }
 
@@ -250,40 +967,81 @@ int create_endpoint(struct sockaddr_in *socketAddr, unsigned long address, int p
 }
 
 /**
- * @brief Sets the time to wait before a timeout on recvfrom calls to the specified number
- * of seconds, or turns it off if zero seconds was entered.
+ * @brief Asks the kernel to timestamp each datagram received on the socket so the time
+ * spent queued before being read can be traced.
  * 
  * @param sd The socket descriptor of the server comminication endpoint.
- * @param seconds The number of seconds to wait before a timeout.
  */
-void set_timeout(int sd, int seconds) {
-    struct timeval time = {0};
-    time.tv_sec = seconds;
+void enable_timestamps(int sd) {
+    int on = 1;
+    /* Sets the receive timestamp option */
+    if (setsockopt(sd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) < 0) {
+        print_error("enable_timestamps", errno, 0);
+    }
+}
 
-    /* Sets the recvfrom timeout option */
-    if (setsockopt(sd, SOL_SOCKET, SO_RCVTIMEO, &time, sizeof(time)) < 0) {
-        print_error("set_timeout", errno, 0);
+/**
+ * @brief Determines how long a received datagram was queued in the kernel before being read.
+ * 
+ * @param msg The message header the datagram was received with.
+ * @return The time in nanoseconds the datagram was queued, or 0 if it was not timestamped.
+ */
+uint64_t get_queue_time(struct msghdr *msg) {
+    struct cmsghdr *cmsg;
+    /* Search the control messages for the kernel receive timestamp */
+    for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            struct timespec arrival, now;
+            memcpy(&arrival, CMSG_DATA(cmsg), sizeof(arrival));
+            clock_gettime(CLOCK_REALTIME, &now);
+            return (now.tv_sec - arrival.tv_sec) * 1000000000LL + (now.tv_nsec - arrival.tv_nsec);
+        }
     }
+    return 0;
+}
+
+/**
+ * @brief Reads the monotonic server clock that game deadlines are measured against.
+ * 
+ * @return The current server clock time in seconds.
+ */
+int32_t server_clock(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int32_t)now.tv_sec;
 }
 
 /**
- * @brief Checks each TicTacToe game to see if it has timed out or not. If one has, that game
- * is reset.
+ * @brief Checks each TicTacToe game to see if it has timed out or not. A game waiting on its
+ * remote player is evicted to cold storage to wait there; any other game (or one that does not
+ * fit in cold storage) is reset. Games in cold storage that have timed out are also dropped.
+ * Only the hot game state is scanned.
  * 
- * @param roster The array of playable TicTacToe games.
+ * @param roster The roster of playable TicTacToe games.
  */
-void check_timeout(struct TTT_Game roster[MAX_GAMES]) {
+void check_timeout(struct TTT_Roster *roster) {
     int i;
+    int32_t now = server_clock();
     /* Searches over all games */
-    for (i = 0; i < MAX_GAMES; i++) {
-        /* Check if current game timeout has expired */
-        if (roster[i].timeout <= 0) {
-            printf("[+]Game #%d has timed out.\n", roster[i].gameNum);
-            printf("Player at %s (port %d) ran out of time to respond.\n", inet_ntoa(roster[i].p2Address.sin_addr), roster[i].p2Address.sin_port);
+    for (i = 0; i < maxGames; i++) {
+        /* Check if current game is being played and its deadline has passed */
+        if (roster->state[i].player != 0 && roster->state[i].deadline <= now) {
+            struct TTT_Game game = get_game(roster, i);
+            struct sockaddr_in playerAddr = player_address(&game);
+            int32_t overdue = now - roster->state[i].deadline;
+            int evicted;
+            /* Move the game out of the way if its player may still come back */
+            evicted = (evict_game(roster, i) != ERROR_CODE);
+            PROBE(timeout, game.gameNum, overdue, evicted);
+            if (evicted) continue;
+            dropStats.timedOut++;
+            printf("[+]Game #%d has timed out.\n", game.gameNum);
+            printf("Player at %s (port %d) ran out of time to respond.\n", inet_ntoa(playerAddr.sin_addr), playerAddr.sin_port);
             /* Reset the current game */
-            free_game(&roster[i]);
+            free_game(&game);
         }
     }
+    expire_cold_games(roster);
 }
 
 /**
@@ -301,68 +1059,178 @@ int same_address(const struct sockaddr_in *addr1, const struct sockaddr_in *addr
     return 1;
 }
 
+/**
+ * @brief Gets the address of the remote player registered to a game.
+ * 
+ * @param game The current game of TicTacToe being played.
+ * @return The socket address of the remote player.
+ */
+struct sockaddr_in player_address(const struct TTT_Game *game) {
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = game->info->p2Addr;
+    addr.sin_port = game->info->p2Port;
+    return addr;
+}
+
+/**
+ * @brief Gets the address a shared-memory or stream client is known by in the roster.
+ * 
+ * @param transport The address of the client's transport (SHM_ADDR or STREAM_ADDR).
+ * @param id The id the client was given when it connected.
+ * @return The socket address of the client.
+ */
+struct sockaddr_in client_address(in_addr_t transport, uint16_t id) {
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = transport;
+    addr.sin_port = htons(id);
+    return addr;
+}
+
+/**
+ * @brief Sends a reply to a remote player over the transport the player is connected by.
+ * 
+ * @param sd The socket descriptor of the server comminication endpoint.
+ * @param reply The reply datagram.
+ * @param length The size of the reply datagram.
+ * @param playerAddr The address of the remote player.
+ * @return The number of bytes sent, or -1 if there was an error (errno is set).
+ */
+ssize_t deliver_reply(int sd, const void *reply, size_t length, const struct sockaddr_in *playerAddr) {
+    if (playerAddr->sin_addr.s_addr == SHM_ADDR) return shm_reply(sd, reply, length, playerAddr);
+    if (playerAddr->sin_addr.s_addr == STREAM_ADDR) return stream_reply(sd, reply, length, playerAddr);
+    return udp_reply(sd, reply, length, playerAddr);
+}
+
+/**
+ * @brief Sends a reply datagram to a remote player over the UDP socket.
+ * 
+ * @param sd The socket descriptor of the server comminication endpoint.
+ * @param reply The reply datagram.
+ * @param length The size of the reply datagram.
+ * @param playerAddr The address of the remote player.
+ * @return The number of bytes sent, or -1 if there was an error (errno is set).
+ */
+ssize_t udp_reply(int sd, const void *reply, size_t length, const struct sockaddr_in *playerAddr) {
+    ssize_t rv = sendto(sd, reply, length, 0, (const struct sockaddr *)playerAddr, sizeof(struct sockaddr_in));
+    if (rv < 0) dropStats.sendFailed++;
+    return rv;
+}
+
+/**
+ * @brief Counts and drops a reply datagram instead of sending it (used while replaying a
+ * capture, where the players are not listening).
+ * 
+ * @param sd Unused.
+ * @param reply Unused.
+ * @param length The size of the reply datagram.
+ * @param playerAddr Unused.
+ * @return The size of the reply datagram, as if it had been sent.
+ */
+ssize_t discard_reply(int sd, const void *reply, size_t length, const struct sockaddr_in *playerAddr) {
+    repliesDiscarded++;
+    return length;
+}
+
 /**
  * @brief Initializes the starting state of the game board that both players start with.
  * 
  * @param game The current game of TicTacToe being played.
  */
 void init_shared_state(struct TTT_Game *game) {    
-    int i;
     /* Initializes the shared state (aka the board)  */
-    for (i = 1; i <= sizeof(game->board); i++) {
-        game->board[i-1] = i + '0';
-    }
+    game->state->board.marks[0] = 0;
+    game->state->board.marks[1] = 0;
 }
 
 /**
- * @brief Initializes the starting state of each game of TicTacToe in the current game roster.
+ * @brief Allocates the hot and cold arrays of the game roster with a slot for each of the
+ * maxGames games, and initializes the starting state of each game of TicTacToe in it. If the
+ * arrays cannot be allocated, the function terminates the process.
  * 
- * @param roster The array of playable TicTacToe games.
+ * @param roster The roster of playable TicTacToe games.
  */
-void init_game_roster(struct TTT_Game roster[MAX_GAMES]) {
+void init_game_roster(struct TTT_Roster *roster) {
     int i;
-    printf("[+]Initializing shared game states.\n");
+    void *state, *info;
+    printf("[+]Initializing shared game states (%d games).\n", maxGames);
+    /* Start each array on a cache line, so four hot game states share every line */
+    if (posix_memalign(&state, CACHE_LINE, maxGames * sizeof(struct Game_State)) != 0 ||
+        posix_memalign(&info, CACHE_LINE, maxGames * sizeof(struct Game_Info)) != 0 ||
+        (roster->pending = calloc(maxGames, sizeof(struct Move_Job *))) == NULL) {
+        print_error("init_game_roster: Unable to allocate the game roster", 0, 1);
+    }
+    roster->state = memset(state, 0, maxGames * sizeof(struct Game_State));
+    roster->info = info;
     /* Iterates over all games */
-    for (i = 0;  i < MAX_GAMES; i++) {
-        struct sockaddr_in blankAddr = {0};
+    for (i = 0;  i < maxGames; i++) {
+        struct Game_Info blankInfo = {0};
+        struct TTT_Game game = get_game(roster, i);
         /* Initialize current game attributes to default values */
-        roster[i].timeout = TIMEOUT;
-        roster[i].p2Address = blankAddr;
-        roster[i].gameNum = i+1;
-        roster[i].player = 0;
+        cancel_move(&game);
+        roster->state[i].deadline = 0;
+        roster->state[i].player = 0;
+        roster->state[i].variant = DEFAULT_VARIANT;
+        roster->info[i] = blankInfo;
         /* Initialize current game board */
-        init_shared_state(&roster[i]);
+        init_shared_state(&game);
     }
+    /* Empty cold storage */
+    memset(roster->cold, 0, sizeof(roster->cold));
+}
+
+/**
+ * @brief Gets a reference to a game in the roster.
+ * 
+ * @param roster The roster of playable TicTacToe games.
+ * @param index The roster index of the game.
+ * @return The reference to the game's hot state and cold bookkeeping.
+ */
+struct TTT_Game get_game(struct TTT_Roster *roster, int index) {
+    struct TTT_Game game = {index + 1, &roster->state[index], &roster->info[index], &roster->pending[index]};
+    return game;
+}
+
+/**
+ * @brief Gets the board variant a game is being played on.
+ * 
+ * @param game The current game of TicTacToe being played.
+ * @return The board variant of the game.
+ */
+const struct TTT_Variant *get_variant(const struct TTT_Game *game) {
+    return ttt_get_variant(game->state->variant);
 }
 
 /**
  * @brief Determines how many games are currently being played.
  * 
- * @param roster The array of playable TicTacToe games.
+ * @param roster The roster of playable TicTacToe games.
  * @return The number of games currently being played. 
  */
-int games_in_progress(struct TTT_Game roster[MAX_GAMES]) {
+int games_in_progress(const struct TTT_Roster *roster) {
     int i, count = 0;
     /* Searches over all games */
-    for (i = 0; i < MAX_GAMES; i++) {
+    for (i = 0; i < maxGames; i++) {
         /* Check if current game still in default state or has been started */
-        if (roster[i].player != 0) count++;
+        if (roster->state[i].player != 0) count++;
     }
     return count;
 }
 
 /**
- * @brief Finds an open game of TicTacToe to play if one is available.
+ * @brief Finds an open game of TicTacToe to play if one is available. Only the slots within the
+ * current capacity are used for new games.
  * 
- * @param roster The array of playable TicTacToe games.
+ * @param roster The roster of playable TicTacToe games.
  * @return The index of an open game if one is available, otherwise an error code is returned.
  */
-int find_open_game(struct TTT_Game roster[MAX_GAMES]) {
+int find_open_game(const struct TTT_Roster *roster) {
     int i, gameIndex = ERROR_CODE;
-    /* Searches over all games */
-    for (i = 0; i < MAX_GAMES; i++) {
+    /* Searches over the games within capacity */
+    for (i = 0; i < limits.capacity; i++) {
         /* Check if current game is being played */
-        if (roster[i].player == 0) {
+        if (roster->state[i].player == 0) {
             gameIndex = i;
             break;
         }
@@ -371,47 +1239,123 @@ int find_open_game(struct TTT_Game roster[MAX_GAMES]) {
 }
 
 /**
- * @brief Gets a command from the remote player and attempts to validate the data and syntax
- * based on the current protocol.
+ * @brief Finds the game a tagged NEW_GAME command already opened, if the remote player has not
+ * made a move in it yet (i.e. the command is being repeated because its reply was lost).
  * 
- * @param sd The socket descriptor of the server comminication endpoint.
+ * @param roster The roster of playable TicTacToe games.
  * @param playerAddr The address of the remote player.
- * @param datagram The datagram to store the command that the remote player sends.
- * @return The number of bytes received for the command, or an error code if an error occured. 
+ * @param tag The tag of the NEW_GAME command (the game number field).
+ * @return The index of the game if there is one, otherwise an error code is returned.
  */
-int get_command(int sd, struct sockaddr_in *playerAddr, struct Buffer *datagram) {
-    int rv;
-    socklen_t fromLength = sizeof(struct sockaddr_in);
-    /* Receive and validate command from remote player */
-    if ((rv = recvfrom(sd, datagram, sizeof(struct Buffer), 0, (struct sockaddr *)playerAddr, &fromLength)) <= 0) {
-        /* Check for error receiving command */
-        if (rv == 0) {
-            print_error("get_command: Received empty datagram. Datagram discarded", 0, 0);
-        } else {
-            /* Check for server timeout */
-            if (errno == EAGAIN || errno == EWOULDBLOCK){
-                return 0;
-            } else {
-                print_error("get_command", errno, 0);
-            }
+int find_tagged_game(const struct TTT_Roster *roster, const struct sockaddr_in *playerAddr, int tag) {
+    int i;
+    for (i = 0; i < maxGames; i++) {
+        const struct Game_Info *info = &roster->info[i];
+        if (roster->state[i].player != 0 && info->tag == tag && roster->state[i].lastMove == 0 &&
+            info->p2Addr == playerAddr->sin_addr.s_addr && info->p2Port == playerAddr->sin_port) return i;
+    }
+    return ERROR_CODE;
+}
+
+/**
+ * @brief Receives the commands waiting on the socket (up to RECEIVE_BATCH, in one call) and
+ * queues the valid ones in the scheduler. Each datagram is captured first if capturing is
+ * turned on.
+ * 
+ * @param sd The socket descriptor of the server comminication endpoint.
+ * @return The number of datagrams received.
+ */
+int receive_commands(int sd) {
+    static struct Command_Datagram commands[RECEIVE_BATCH];
+    static struct sockaddr_in playerAddrs[RECEIVE_BATCH];
+    static char controls[RECEIVE_BATCH][CMSG_SPACE(sizeof(struct timespec)) + CMSG_SPACE(sizeof(uint32_t))];
+    struct iovec iovs[RECEIVE_BATCH];
+    struct mmsghdr msgs[RECEIVE_BATCH];
+    int i, n, batch = PENDING_COMMANDS - scheduler.count;
+    if (batch > RECEIVE_BATCH) batch = RECEIVE_BATCH;
+    if (batch <= 0) return 0;
+    memset(commands, 0, sizeof(struct Command_Datagram) * batch);
+    memset(msgs, 0, sizeof(struct mmsghdr) * batch);
+    for (i = 0; i < batch; i++) {
+        iovs[i].iov_base = &commands[i];
+        iovs[i].iov_len = sizeof(struct Command_Datagram);
+        msgs[i].msg_hdr.msg_name = &playerAddrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_control = controls[i];
+        msgs[i].msg_hdr.msg_controllen = sizeof(controls[i]);
+    }
+    /* Receive the commands from the remote players */
+    if ((n = recvmmsg(sd, msgs, batch, MSG_DONTWAIT, NULL)) < 0) {
+        /* Nothing is waiting, or interrupted by a trace dump request */
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) print_error("receive_commands", errno, 0);
+        return 0;
+    }
+    for (i = 0; i < n; i++) {
+        int length = msgs[i].msg_len;
+        uint64_t queueTime;
+        if (length == 0) {
+            print_error("receive_commands: Received empty datagram. Datagram discarded", 0, 0);
+            continue;
         }
-        return ERROR_CODE;
-    } else if (datagram->version != VERSION) {  // check for correct version
-        print_error("get_command: Protocol version not supported. Datagram discarded", 0, 0);
-        return ERROR_CODE;
-    } else if (datagram->command < NEW_GAME || datagram->command > MOVE) {  // check for valid command
-        print_error("get_command: Invalid command. Datagram discarded", 0, 0);
-        return ERROR_CODE;
-    } else if (datagram->command != NEW_GAME && (datagram->gameNum < 1 || datagram->gameNum > MAX_GAMES)) { // check for valid game number
-        print_error("get_command: Invalid game number. Datagram discarded", 0, 0);
-        return ERROR_CODE;
+        /* Keep track of the kernel's drops and the receive queue depth */
+        read_drop_count(&msgs[i].msg_hdr);
+        if (++dropStats.received % QUEUE_SAMPLE == 0) sample_queue_depth(sd);
+        /* Capture the datagram with the time it arrived */
+        queueTime = get_queue_time(&msgs[i].msg_hdr);
+        if (capture.file != NULL) capture_write(&capture, trace_clock() - queueTime, &playerAddrs[i], &commands[i], length);
+        /* Start tracing the command now that it has been received */
+        if (traceEnabled) trace_command_begin(queueTime);
+        PROBE(receive, commands[i].header.command, commands[i].header.gameNum, queueTime);
+        if (validate_command(&commands[i], length) > 0) queue_command(&playerAddrs[i], &commands[i]);
+    }
+    return n;
+}
+
+/**
+ * @brief Validates a command received from a remote player (over the socket or from a
+ * capture being replayed). Invalid commands are reported and discarded.
+ * 
+ * @param command The datagram received.
+ * @param length The number of bytes received.
+ * @return The number of bytes received if the command is valid, or an error code if it
+ * should be discarded.
+ */
+int validate_command(const struct Command_Datagram *command, int length) {
+    int rv = length;
+    const struct Buffer *datagram = &command->header;
+    TRACE_BEGIN(STAGE_VALIDATE);
+    /* Validate command from remote player */
+    if (datagram->version != VERSION) {  // check for correct version
+        print_error("validate_command: Protocol version not supported. Datagram discarded", 0, 0);
+        rv = ERROR_CODE;
+    } else if (datagram->command < NEW_GAME || datagram->command > ANALYZE) {  // check for valid command
+        print_error("validate_command: Invalid command. Datagram discarded", 0, 0);
+        rv = ERROR_CODE;
+    } else if (datagram->command == MOVE && (datagram->gameNum < 1 || datagram->gameNum > maxGames)) { // check for valid game number
+        print_error("validate_command: Invalid game number. Datagram discarded", 0, 0);
+        rv = ERROR_CODE;
+    } else if (datagram->command != MOVE && (datagram->data < 0 || datagram->data >= NUM_VARIANTS)) { // check for valid variant
+        print_error("validate_command: Invalid board variant. Datagram discarded", 0, 0);
+        rv = ERROR_CODE;
+    } else if (datagram->command == ANALYZE && rv != sizeof(struct Command_Datagram)) { // check for the board
+        print_error("validate_command: ANALYZE command is missing its board. Datagram discarded", 0, 0);
+        rv = ERROR_CODE;
+    }
+    TRACE_END(STAGE_VALIDATE);
+    if (rv == ERROR_CODE) {
+        PROBE(reject, datagram->command, datagram->gameNum, PROBE_REJECT_INVALID);
+        dropStats.invalid++;
+        if (traceEnabled) trace_command_discard();
     }
     return rv;
 }
 
 /**
- * @brief Handles the NEW_GAME command from the remote player. Initializes a new game, if
- * available, and sends the first move to the remote player.
+ * @brief Handles the NEW_GAME command from the remote player. Initializes a new game of the
+ * requested board variant, if available, and sends the first move to the remote player. A
+ * NEW_GAME repeated with the same tag gets the first move of the game it opened again.
  * 
  * @param sd The socket descriptor of the server comminication endpoint.
  * @param playerAddr The address of the remote player.
@@ -419,33 +1363,41 @@ int get_command(int sd, struct sockaddr_in *playerAddr, struct Buffer *datagram)
  * @param game The current game of TicTacToe being played.
  */
 void new_game(int sd, const struct sockaddr_in *playerAddr, const struct Buffer *datagram, struct TTT_Game *game) {
-    int move;
     printf("Player at %s (port %d) issued a NEW_GAME command.\n", inet_ntoa(playerAddr->sin_addr), playerAddr->sin_port);
-    /* Check that there was an game open to play */
-    if (game != NULL) {
+    /* A repeated NEW_GAME is answered with the game it already opened */
+    if (game != NULL && game->state->player != 0) {
+        if (game->state->player == 2) {
+            repeat_reply(sd, game);
+        } else {
+            printf("Game #%d is already being started for this player. Datagram discarded\n", game->gameNum);
+        }
+        dropStats.repeated++;
+    } else if (game != NULL) {  // check that there was an game open to play
         /* Register player address to game and initialize the board */
-        game->p2Address = *playerAddr;
+        game->info->p2Addr = playerAddr->sin_addr.s_addr;
+        game->info->p2Port = playerAddr->sin_port;
+        game->info->tag = datagram->gameNum;
+        game->state->lastMove = 0;
+        game->state->lastReply = 0;
+        game->state->variant = datagram->data;
         init_shared_state(game);
-        printf("Player assigned to Game #%d. Beginning game.\n", game->gameNum);
-        /* Get first move to send to remote player */
-        if ((move = send_p1_move(sd, game)) == ERROR_CODE) {
-            /* Reset game if there was an error sending the move */
-            free_game(game);
-            return;
-        }
-        /* Update and print game board, and change turns */
-        game->board[move-1] = P1_MARK;
-        game->player = 2;
-        print_board(game);
+        printf("Player assigned to Game #%d (%s). Beginning game.\n", game->gameNum, get_variant(game)->name);
+        /* Make the first move to send to the remote player */
+        game->state->player = 1;
+        request_p1_move(sd, game, NEW_GAME);
     } else {
         print_error("new_game: Unable to find an open game", 0, 0);
+        PROBE(reject, datagram->command, 0, PROBE_REJECT_REFUSED);
+        dropStats.rejected++;
     }
 }
 
 /**
  * @brief Handles the MOVE command from the remote player. Receives and processes a move
  * from the remote player and sends a move back. If the game has ended from a move, an
- * appropriate message is printed and the game is reset for a new player.
+ * appropriate message is printed and the game is reset for a new player. A repeat of the
+ * player's last move (its reply was lost) gets the last reply again, even once the game has
+ * ended on that reply.
  * 
  * @param sd The socket descriptor of the server comminication endpoint.
  * @param playerAddr The address of the remote player.
@@ -455,91 +1407,101 @@ void new_game(int sd, const struct sockaddr_in *playerAddr, const struct Buffer
 void move(int sd, const struct sockaddr_in *playerAddr, const struct Buffer *datagram, struct TTT_Game *game) {
     /* Get move from remote player */
     int move = datagram->data - '0';
+    struct sockaddr_in p2Address = player_address(game);
     printf("Player at %s (port %d) issued a MOVE command.\n", inet_ntoa(playerAddr->sin_addr), playerAddr->sin_port);
     printf("********  Game #%d  ********\n", game->gameNum);
     /* Check that the move came from the player registered to the game */
-    if (same_address(playerAddr, &game->p2Address)) {
-        printf("Player 2 chose the move:  %c\n", datagram->data);
+    if (!same_address(playerAddr, &p2Address)) {
+        print_error("move: Player address does not match that registered to game", 0, 0);
+        printf("Game address: %s (port %d)\n", inet_ntoa(p2Address.sin_addr), p2Address.sin_port);
+        PROBE(reject, datagram->command, game->gameNum, PROBE_REJECT_REFUSED);
+        dropStats.rejected++;
+    } else if (move != 0 && move == game->state->lastMove && game->state->player != 1) {  // reply lost, move repeated
+        repeat_reply(sd, game);
+        dropStats.repeated++;
+    } else if (game->state->player != 2) {  // still computing the previous move
+        print_error("move: Not Player 2's turn. Datagram discarded", 0, 0);
+        PROBE(reject, datagram->command, game->gameNum, PROBE_REJECT_REFUSED);
+        dropStats.rejected++;
+    } else {
+        printf("Player 2 chose the move:  %d\n", move);
         /* Check that the received move is valid */
         if (validate_move(move, game)) {
             /* Update the board (for Player 2) and check if someone won */
-            game->board[move-1] = P2_MARK;
+            mark_square(game, move, 2);
+            game->state->lastMove = move;
             if (game_over(game)) return;
             /* If nobody won, change turns and make a move to send to the remote player */
-            game->player = 1;
-            if ((move = send_p1_move(sd, game)) == ERROR_CODE) {
-                free_game(game);    
-                return;
-            }
-            /* Update the board (for Player 1) and check if someone won */
-            game->board[move-1] = P1_MARK;
-            if (game_over(game)) return;
-            /* If nobody won, change turns and print the board after the exchange */
-            game->player = 2;
-            print_board(game);
+            game->state->player = 1;
+            request_p1_move(sd, game, MOVE);
         } else {
             free_game(game);
         }
-    } else {
-        print_error("move: Player address does not match that registered to game", 0, 0);
-        printf("Game address: %s (port %d)\n", inet_ntoa(game->p2Address.sin_addr), game->p2Address.sin_port);
     }
 }
 
 /**
- * @brief Provides an optimal move for the maximizing player assuming that minimizing player
- * is also playing optimally.
+ * @brief Handles the ANALYZE command from the remote player. Finds the best move and its
+ * minimax score for the player to move on the board that follows the command header, without
+ * opening a game. Positions are answered from the position cache when possible.
  * 
- * @param game The current game of TicTacToe being played.
- * @param depth The current depth in game tree.
- * @param isMax Whether it is the maximizers turn or not.
- * @return The best score achievable for the maximizer based on the current state of the game.
- */
-int minimax(struct TTT_Game *game, int depth, int isMax) {
-    /* Get score for current turn */
-    int score = check_win(game);
-    /* Check for base case */
-    if (score > 0) {    // maximizer won
-        return score - depth;
-    } else if (score < 0) {    // minimizer won
-        return score + depth;
-    } else if (check_draw(game)) {  // nobody won
-        return 0;
-    } else {
-        /* Initialize best score for maximizer/minimizer */
-        int i, best = (isMax) ? INT32_MIN : INT16_MAX;
-        if (isMax) {    // maximizers turn
-            /* Searches over all possible moves */
-            for (i = 0; i < sizeof(game->board); i++) {
-                /* Checks that current move is valid based on the current board */
-                if (game->board[i] == (i+1)+'0') {
-                    int value;
-                    /* Make the move */
-                    game->board[i] = P1_MARK;
-                    /* Get best score for move and update best move if the score was better */
-                    if ((value = minimax(game, depth+1, !isMax)) > best) best = value;
-                    /* Undo previous move */
-                    game->board[i] = (i+1)+'0';
-                }
-            }
-            return best;
-        } else {    // minimizers turn
-            /* Searches over all possible moves */
-            for (i = 0; i < sizeof(game->board); i++) {
-                /* Checks that current move is valid based on the current board */
-                if (game->board[i] == (i+1)+'0') {
-                    int value;
-                    /* Make the move */
-                    game->board[i] = P2_MARK;
-                    /* Get best score for move and update best move if the score was better */
-                    if ((value = minimax(game, depth+1, !isMax)) < best) best = value;
-                    /* Undo previous move */
-                    game->board[i] = (i+1)+'0';
-                }
-            }
-            return best;
-        }
+ * @param sd The socket descriptor of the server comminication endpoint.
+ * @param playerAddr The address of the remote player.
+ * @param datagram The datagram containing the command that the remote player sends.
+ * @param game Unused (ANALYZE is not tied to a game).
+ */
+void analyze(int sd, const struct sockaddr_in *playerAddr, const struct Buffer *datagram, struct TTT_Game *game) {
+    const struct Command_Datagram *command = (const struct Command_Datagram *)datagram;
+    const struct TTT_Variant *variant = ttt_get_variant(datagram->data);
+    uint64_t packed = (uint64_t)ntohl(command->board[0]) << 32 | ntohl(command->board[1]);
+    struct Move_Job *job = (engine != NULL) ? malloc(sizeof(struct Move_Job)) : NULL;
+    struct TTT_Board board;
+    int move, score;
+    printf("Player at %s (port %d) issued an ANALYZE command.\n", inet_ntoa(playerAddr->sin_addr), playerAddr->sin_port);
+    /* Check that the board is a position that can still be played */
+    if (ttt_unpack_board(variant, packed, &board) == TTT_ERROR || ttt_validate_position(variant, &board) == TTT_ERROR) {
+        print_error("analyze: Invalid board. Datagram discarded", 0, 0);
+        PROBE(reject, datagram->command, 0, PROBE_REJECT_REFUSED);
+        dropStats.rejected++;
+        free(job);
+        return;
+    }
+    /* Queue the analysis to the engine workers if they are running */
+    if (job != NULL) {
+        job->job.run = compute_move;
+        job->gameIndex = ERROR_CODE;
+        job->command = ANALYZE;
+        job->variant = datagram->data;
+        job->board = board;
+        job->playerAddr = *playerAddr;
+        job->tag = datagram->gameNum;
+        job->queued = trace_clock();
+        if (traceEnabled) trace_command_suspend(&job->trace);
+        engine_submit(engine, &job->job);
+        return;
+    }
+    /* Otherwise analyze the board now */
+    TRACE_BEGIN(STAGE_SEARCH);
+    move = analyze_board(variant, &board, &score);
+    TRACE_END(STAGE_SEARCH);
+    send_analysis(sd, playerAddr, datagram->gameNum, move, score);
+}
+
+/**
+ * @brief Finds the optimal move for Player 1 on a board of the given variant. Safe to call
+ * from the engine workers.
+ * 
+ * @param variant The board variant being played.
+ * @param board The board to search.
+ * @return The optimal square (1-based) to play.
+ */
+int search_board(const struct TTT_Variant *variant, const struct TTT_Board *board) {
+    /* Search the larger boards in parallel with a time budget if enabled */
+    if (searchSettings.enabled && variant->squares > 9) {
+        return parallel_find_best_move(variant, board, searchSettings.pool, searchSettings.budget, 0, NULL);
     }
+    /* Search with the engine specialized for the board variant */
+    return ttt_find_best_move(variant, board, NULL);
 }
 
 /**
@@ -550,59 +1512,23 @@ int minimax(struct TTT_Game *game, int depth, int isMax) {
  * @return The optimal move to make in order to win. 
  */
 int find_best_move(struct TTT_Game *game) {
-    int i, bestMove = -1, bestValue = INT32_MIN;
-    /* Searches over all possible moves */
-    for (i = 0; i < sizeof(game->board); i++) {
-        /* Checks that current move is valid based on the current board */
-        if (game->board[i] == (i+1)+'0') {
-            int moveValue;
-            /* Make the move */
-            game->board[i] = P1_MARK;
-            /* Get the move score */
-            moveValue = minimax(game, 0, 0);
-            /* Undo previous move */
-            game->board[i] = (i+1)+'0';
-            /* Update the best move if the current score was better */
-            if (moveValue > bestValue) {
-                bestValue = moveValue;
-                bestMove = i+1;
-            }
-        }
-    }
-    return bestMove;
+    uint64_t started = PROBE_ENABLED(search__end) ? trace_clock() : 0;
+    int move;
+    PROBE(search__start, game->gameNum, game->state->variant, __builtin_popcount(game->state->board.marks[0] | game->state->board.marks[1]));
+    move = search_board(get_variant(game), &game->state->board);
+    PROBE(search__end, game->gameNum, move, (started != 0) ? trace_clock() - started : 0);
+    return move;
 }
 
 /**
  * @brief Determines if someone has won the game yet or not.
  * 
  * @param game The current game of TicTacToe being played.
- * @return True if a player has won the game and false if the game is still going on. 
+ * @return A positive score if Player 1 has won, a negative score if Player 2 has won, and
+ * 0 if the game is still going on. 
  */
 int check_win(const struct TTT_Game *game) {
-    const int score = sizeof(game->board) + 1;
-    /***********************************************************************/
-    /* Brute force check to see if someone won. Return a +/- score if the  */
-    /* game is 'over' or return 0 if game should go on.                    */
-    /***********************************************************************/
-    if (game->board[0] == game->board[1] && game->board[1] == game->board[2]) { // row matches
-        return (game->board[0] == P1_MARK) ? score : -score;
-    } else if (game->board[3] == game->board[4] && game->board[4] == game->board[5]) { // row matches
-        return (game->board[3] == P1_MARK) ? score : -score;
-    } else if (game->board[6] == game->board[7] && game->board[7] == game->board[8]) { // row matches
-        return (game->board[6] == P1_MARK) ? score : -score;
-    } else if (game->board[0] == game->board[3] && game->board[3] == game->board[6]) { // column matches
-        return (game->board[0] == P1_MARK) ? score : -score;
-    } else if (game->board[1] == game->board[4] && game->board[4] == game->board[7]) { // column matches
-        return (game->board[1] == P1_MARK) ? score : -score;
-    } else if (game->board[2] == game->board[5] && game->board[5] == game->board[8]) { // column matches
-        return (game->board[2] == P1_MARK) ? score : -score;
-    } else if (game->board[0] == game->board[4] && game->board[4] == game->board[8]) { // diagonal matches
-        return (game->board[0] == P1_MARK) ? score : -score;
-    } else if (game->board[2] == game->board[4] && game->board[4] == game->board[6]) { // diagonal matches
-        return (game->board[2] == P1_MARK) ? score : -score;
-    } else {
-        return 0;  // return of 0 means keep playing
-    }
+    return ttt_check_win(get_variant(game), &game->state->board);
 }
 
 /**
@@ -612,13 +1538,7 @@ int check_win(const struct TTT_Game *game) {
  * @return True if there are no moves left to be made, false otherwise. 
  */
 int check_draw(const struct TTT_Game *game) {
-    int i;
-    /* Check each board square */
-    for (i = 0; i < sizeof(game->board); i++) {
-        /* Check if current square has been played */
-        if (game->board[i] == (i+1)+'0') return 0;
-    }
-    return 1;
+    return ttt_check_draw(get_variant(game), &game->state->board);
 }
 
 /**
@@ -627,89 +1547,211 @@ int check_draw(const struct TTT_Game *game) {
  * @param game The current game of TicTacToe being played.
  */
 void print_board(const struct TTT_Game *game) {
-    /*****************************************************************/
-    /* Brute force print out the board and all the squares/values    */
-    /*****************************************************************/
+    TRACE_BEGIN(STAGE_PRINT);
     /* Print header info */
     printf("\n\n\tTicTacToe Game #%d\n\n", game->gameNum);
     printf("Player 1 (%c)  -  Player 2 (%c)\n\n\n", P1_MARK, P2_MARK);
     /* Print current state of board */
-    printf("     |     |     \n");
-    printf("  %c  |  %c  |  %c \n", game->board[0], game->board[1], game->board[2]);
-    printf("_____|_____|_____\n");
-    printf("     |     |     \n");
-    printf("  %c  |  %c  |  %c \n", game->board[3], game->board[4], game->board[5]);
-    printf("_____|_____|_____\n");
-    printf("     |     |     \n");
-    printf("  %c  |  %c  |  %c \n", game->board[6], game->board[7], game->board[8]);
-    printf("     |     |     \n\n");
+    ttt_print_board(stdout, get_variant(game), &game->state->board, P1_MARK, P2_MARK);
+    TRACE_END(STAGE_PRINT);
 }
 
 /**
- * @brief Determines whether a given move is legal (i.e. number 1-9) and valid (i.e. hasn't
- * already been played) for the current game.
+ * @brief Determines whether a given move is legal (i.e. a square on the board) and valid
+ * (i.e. hasn't already been played) for the current game.
  * 
  * @param choice The player move to be validated.
  * @param game The current game of TicTacToe being played.
  * @return True if the given move if valid based on the current board, false otherwise. 
  */
 int validate_move(int choice, const struct TTT_Game *game) {
-    /* Check to see if the choice is a move on the board */
-    if (choice < 1 || choice > 9) {
-        print_error("Invalid move: Must be a number [1-9]", 0, 0);
-        return 0;
-    }
-    /* Check to see if the square chosen has a digit in it, if */
-    /* square 8 has an '8' then it is a valid choice */
-    if (game->board[choice-1] != (choice + '0')) {
-        print_error("Invalid move: Square already taken", 0, 0);
-        return 0;
+    switch (ttt_validate_move(get_variant(game), &game->state->board, choice)) {
+        case TTT_MOVE_OFF_BOARD:
+            print_error("Invalid move: Must be a square on the board", 0, 0);
+            return 0;
+        case TTT_MOVE_TAKEN:
+            print_error("Invalid move: Square already taken", 0, 0);
+            return 0;
     }
     return 1;
 }
 
 /**
- * @brief Sends Player 1's move to the remote player.
+ * @brief Marks a square of the game board for the given player.
  * 
- * @param sd The socket descriptor of the server comminication endpoint.
  * @param game The current game of TicTacToe being played.
- * @return The move that was sent, or an error code if there was an issue. 
+ * @param square The square (1-based) to mark.
+ * @param player The player (1 or 2) marking the square.
  */
-int send_p1_move(int sd, struct TTT_Game *game) {
-    struct Buffer datagram = {0};
-    /* Get move to send to remote player */
-    int move = find_best_move(game);
-    while (!validate_move(move, game)) move = find_best_move(game);
-    /* Pack move information into datagram */
-    datagram.version = VERSION;
-    datagram.command = MOVE;
-    datagram.data = move + '0';
-    datagram.gameNum = game->gameNum;
-    /* Send the move to the remote player */
-    printf("Server sent the move:  %c\n", datagram.data);
-    if (sendto(sd, &datagram, sizeof(struct Buffer), 0, (struct sockaddr *)&game->p2Address, sizeof(struct sockaddr_in)) < 0) {
-        print_error("send_p1_move", errno, 0);
-        return ERROR_CODE;
-    }
-    return (datagram.data - '0');
+void mark_square(struct TTT_Game *game, int square, int player) {
+    ttt_mark_square(&game->state->board, square, player);
 }
 
 /**
- * @brief Resets the current game for a new player.
+ * @brief Makes Player 1's move. If engine workers are running, the move is queued to them with
+ * a snapshot of the board and sent once it has been computed (see collect_moves()). If moves
+ * are batched, it is set aside and searched with the other moves of the scheduler pass (see
+ * search_move_batch()); otherwise it is computed and sent immediately.
  * 
+ * @param sd The socket descriptor of the server comminication endpoint.
  * @param game The current game of TicTacToe being played.
+ * @param command The command the move answers.
  */
-void free_game(struct TTT_Game *game) {
-    struct sockaddr_in blankAddr = {0};
-    printf("Game #%d has ended. Resetting game for new player.\n", game->gameNum);
+void request_p1_move(int sd, struct TTT_Game *game, int command) {
+    struct Move_Job *job = (engine != NULL) ? malloc(sizeof(struct Move_Job)) : NULL;
+    int move;
+    /* Queue the move to the engine workers if they are running */
+    if (job != NULL) {
+        job->job.run = compute_move;
+        job->gameIndex = game->gameNum - 1;
+        job->command = command;
+        job->variant = game->state->variant;
+        job->board = game->state->board;
+        job->queued = trace_clock();
+        if (traceEnabled) trace_command_suspend(&job->trace);
+        *game->pending = job;
+        engine_submit(engine, &job->job);
+        return;
+    }
+    /* Set the move aside for the batch if there is room (a parallel search is not batched) */
+    if (moveBatch.enabled && moveBatch.count < maxGames && !(searchSettings.enabled && get_variant(game)->squares > 9)) {
+        job = &moveBatch.jobs[moveBatch.count++];
+        atomic_store(&job->job.cancelled, 0);
+        job->gameIndex = game->gameNum - 1;
+        job->command = command;
+        job->variant = game->state->variant;
+        job->board = game->state->board;
+        if (traceEnabled) trace_command_suspend(&job->trace);
+        *game->pending = job;
+        return;
+    }
+    /* Otherwise get the move to send to remote player now */
+    TRACE_BEGIN(STAGE_SEARCH);
+    move = find_best_move(game);
+    while (!validate_move(move, game)) move = find_best_move(game);
+    TRACE_END(STAGE_SEARCH);
+    finish_p1_move(sd, game, move);
+}
+
+/**
+ * @brief Sends Player 1's move to the remote player.
+ * 
+ * @param sd The socket descriptor of the server comminication endpoint.
+ * @param game The current game of TicTacToe being played.
+ * @param move The square (1-based) Player 1 plays.
+ * @return The move that was sent, or an error code if there was an issue. 
+ */
+int send_p1_move(int sd, struct TTT_Game *game, int move) {
+    struct Buffer datagram = {0};
+    struct sockaddr_in p2Address = player_address(game);
+    uint64_t started = PROBE_ENABLED(send) ? trace_clock() : 0;
+    /* Pack move information into datagram */
+    datagram.version = VERSION;
+    datagram.command = MOVE;
+    datagram.data = move + '0';
+    datagram.gameNum = game->gameNum;
+    /* Send the move to the remote player */
+    printf("Server sent the move:  %d\n", move);
+    TRACE_BEGIN(STAGE_SEND);
+    if (send_reply(sd, &datagram, sizeof(struct Buffer), &p2Address) < 0) {
+        TRACE_END(STAGE_SEND);
+        print_error("send_p1_move", errno, 0);
+        return ERROR_CODE;
+    }
+    TRACE_END(STAGE_SEND);
+    PROBE(send, game->gameNum, move, (started != 0) ? trace_clock() - started : 0);
+    return (datagram.data - '0');
+}
+
+/**
+ * @brief Sends Player 1's move, updates the board and, if nobody won, hands the turn back to
+ * the remote player.
+ * 
+ * @param sd The socket descriptor of the server comminication endpoint.
+ * @param game The current game of TicTacToe being played.
+ * @param move The square (1-based) Player 1 plays.
+ */
+void finish_p1_move(int sd, struct TTT_Game *game, int move) {
+    struct Game_Info finished;
+    int lastMove;
+    /* Reset game if there was an error sending the move */
+    if (send_p1_move(sd, game, move) == ERROR_CODE) {
+        free_game(game);
+        return;
+    }
+    /* Update the board (for Player 1) and check if someone won */
+    mark_square(game, move, 1);
+    game->state->lastReply = move;
+    finished = *game->info;
+    lastMove = game->state->lastMove;
+    if (game_over(game)) {
+        /* Keep the player and the last moves in the open slot, so a repeated final move is answered */
+        *game->info = finished;
+        game->state->lastMove = lastMove;
+        game->state->lastReply = move;
+        return;
+    }
+    /* If nobody won, change turns and print the board after the exchange */
+    game->state->player = 2;
+    print_board(game);
+}
+
+/**
+ * @brief Sends the remote player Player 1's last move again, because the player repeated the
+ * command it answered.
+ * 
+ * @param sd The socket descriptor of the server comminication endpoint.
+ * @param game The current game of TicTacToe being played (or just ended).
+ */
+void repeat_reply(int sd, struct TTT_Game *game) {
+    printf("Player 2 repeated its last command. Game #%d.\n", game->gameNum);
+    send_p1_move(sd, game, game->state->lastReply);
+}
+
+/**
+ * @brief Cancels the move being computed for a game, if any. A queued move is skipped by the
+ * engine workers, and a move already being searched is dropped when it is collected.
+ * 
+ * @param game The current game of TicTacToe being played.
+ */
+void cancel_move(struct TTT_Game *game) {
+    if (*game->pending != NULL) {
+        atomic_store(&(*game->pending)->job.cancelled, 1);
+        *game->pending = NULL;
+    }
+}
+
+/**
+ * @brief Clears a game's roster slot so it is open for a new player.
+ * 
+ * @param game The current game of TicTacToe being played.
+ */
+void reset_game(struct TTT_Game *game) {
+    struct Game_Info blankInfo = {0};
     /* Reset game attributes */
-    game->timeout = TIMEOUT;
-    game->p2Address = blankAddr;
-    game->player = 0;
+    cancel_move(game);
+    game->state->deadline = 0;
+    game->state->player = 0;
+    game->state->lastMove = 0;
+    game->state->lastReply = 0;
+    *game->info = blankInfo;
     /* Reset game board */
     init_shared_state(game);
 }
 
+/**
+ * @brief Resets the current game for a new player.
+ * 
+ * @param game The current game of TicTacToe being played.
+ */
+void free_game(struct TTT_Game *game) {
+    int enabled = PROBE_ENABLED(free__game);
+    PROBE(free__game, game->gameNum, enabled ? __builtin_popcount(game->state->board.marks[0] | game->state->board.marks[1]) : 0,
+        (enabled && game->state->player != 0) ? limits.timeout - (game->state->deadline - server_clock()) : 0);
+    printf("Game #%d has ended. Resetting game for new player.\n", game->gameNum);
+    reset_game(game);
+}
+
 /**
  * @brief Checks if the current game has ended, prints the appropriate message if so,
  * and resets the game for a new player.
@@ -722,7 +1764,7 @@ int game_over(struct TTT_Game *game) {
     if (check_win(game) != 0) {
         /* Print final game board and winning player */
         print_board(game);
-        printf("==>\a Player %d wins\n", game->player);
+        printf("==>\a Player %d wins\n", game->state->player);
     } else if (check_draw(game)) {
         /* Print final game board and that the game was a draw */
         print_board(game);
@@ -743,46 +1785,2080 @@ int game_over(struct TTT_Game *game) {
  */
 void tictactoe(int sd) {
     int waitPrompt = 1;
-    struct TTT_Game gameRoster[MAX_GAMES] = {{0}};
-    command_handler commands[] = {new_game, move};
+    struct TTT_Roster gameRoster = {0};
+    struct pollfd events[NUM_EVENTS] = {{sd, POLLIN, 0}, {(engine != NULL) ? engine->eventFd : -1, POLLIN, 0}};
 
-    /* Initialize all games and server timeout time */
-    init_game_roster(gameRoster);
-    set_timeout(sd, TIMEOUT);
+    /* Initialize all games and the scheduler */
+    init_game_roster(&gameRoster);
+    init_scheduler();
+    watch_shm_peers(events);
+    watch_admin_peers(events);
     /* Play all the games */
     while (1) {
-        int rv;
-        time_t start, stop;
-        struct sockaddr_in playerAddr = {0};
-        struct Buffer datagram = {0};
-        /* Start clock for elapsed time from last command */
+        int ready;
+        /* Dump the stage latencies if requested */
+        trace_poll();
+        /* Apply the changes asked for by admin clients before handling any more commands */
+        if (adminControl.changed) apply_admin_changes(&gameRoster);
         if (waitPrompt) printf("[+]Waiting for another player to issue a command...\n");
-        start = time(NULL);
-        /* Wait for a command to be received */
-        if ((rv = get_command(sd, &playerAddr, &datagram)) > 0) {
-            int i, gameIndx = (datagram.command == NEW_GAME) ? find_open_game(gameRoster) : datagram.gameNum-1;
-            commands[(int)datagram.command](sd, &playerAddr, &datagram, (gameIndx < 0) ? NULL : &gameRoster[gameIndx]);
-            /* Stop clock for elapsed time from last command and update timeout clock for each ongoing game */
-            stop = time(NULL);
-            for (i = 0; i < MAX_GAMES; i++) {
-                /* Check if game is being played and update timeout clock if so */
-                if (gameRoster[i].player != 0) gameRoster[i].timeout -= difftime(stop, start);
-                /* Reset timout clock for game that just received the command */
-                if (i == gameIndx) gameRoster[gameIndx].timeout = TIMEOUT;
-            }
-            /* Reset any game that has timed out */
-            check_timeout(gameRoster);
+        /* Handle the commands received, moves of games in progress before new games */
+        if (scheduler.count > 0 && run_scheduler(sd, &gameRoster) > 0) waitPrompt = 1;
+        /* Send every reply queued for the stream clients */
+        if (streamTransport.numPeers > 0) flush_stream_peers();
+        watch_stream_peers(events);
+        /* Write out the captured datagrams before going idle (a burst is written together) */
+        if (capture.unflushed > 0 && scheduler.count == 0 && poll(events, NUM_EVENTS, 0) == 0 && !shm_requests_waiting() && !stream_requests_waiting()) {
+            capture_flush(&capture);
+        }
+        /* Wait for a command or a move computed by the engine workers */
+        if ((ready = wait_for_events(events, NUM_EVENTS)) < 0) {
+            if (errno != EINTR) print_error("tictactoe: poll", errno, 0);  // EINTR: trace dump request
+            continue;
+        }
+        /* Send the moves the engine workers have finished */
+        if (events[1].revents & POLLIN) {
+            collect_moves(sd, &gameRoster);
+            check_timeout(&gameRoster);
             waitPrompt = 1;
-        } else if (rv == 0) {   // server has timed out
-            /* Check if any games are currently being played */
-            if (games_in_progress(gameRoster) > 0) {
-                print_error("tictactoe: Nobody has responded in a while. Resetting game states", 0, 0);
-                /* Reset all games */
-                init_game_roster(gameRoster);
-                waitPrompt = 1;
-            } else {
-                waitPrompt = 0;
-            }
         }
+        /* Register new shared-memory clients and drop those that hung up */
+        if (shmTransport.listenFd >= 0) handle_shm_events(events);
+        /* Accept new stream clients and read what the connected ones have sent */
+        if (streamTransport.listenFd >= 0) handle_stream_events(events);
+        /* Answer admin clients and stage the changes they ask for */
+        if (adminControl.listenFd >= 0) handle_admin_events(events, &gameRoster);
+        /* Report drops and adjust the socket buffers every interval */
+        if (trace_clock() >= socketTuning.nextCheck) report_drops(sd);
+        if (ready > 0) {
+            /* Queue the commands received over every transport for the scheduler */
+            queue_commands(sd, events[0].revents & POLLIN);
+        } else if (games_in_progress(&gameRoster) > 0) {    // server has timed out
+            print_error("tictactoe: Nobody has responded in a while. Moving idle games to cold storage", 0, 0);
+            /* Evict idle games (resetting any that cannot be evicted) */
+            evict_idle_games(&gameRoster);
+            check_timeout(&gameRoster);
+            waitPrompt = 1;
+        } else {
+            expire_cold_games(&gameRoster);
+            waitPrompt = 0;
+        }
+    }
+}
+
+/**
+ * @brief Hands a validated command to its handler along with the game it is for. The caller
+ * resets the games that have timed out (see check_timeout()) once it has served the moves
+ * waiting for them.
+ * 
+ * @param sd The socket descriptor of the server comminication endpoint.
+ * @param roster The roster of games being played.
+ * @param playerAddr The address of the remote player.
+ * @param datagram The datagram containing the command that the remote player sent.
+ * @param waited The time (in nanoseconds) the command waited in the scheduler, for the dispatch
+ * probe (0 if not measured).
+ */
+void dispatch_command(int sd, struct TTT_Roster *roster, const struct sockaddr_in *playerAddr, const struct Buffer *datagram, uint64_t waited) {
+    static const command_handler commands[] = {new_game, move, analyze};
+    int gameIndx = locate_game(roster, playerAddr, datagram);
+    struct TTT_Game game = get_game(roster, (gameIndx < 0) ? 0 : gameIndx);
+    PROBE(dispatch, datagram->command, gameIndx + 1, waited);
+    commands[(int)datagram->command](sd, playerAddr, datagram, (gameIndx < 0) ? NULL : &game);
+    if (traceEnabled) trace_command_end(datagram->command);
+    /* Reset timout clock for game that just received the command */
+    if (gameIndx >= 0) roster->state[gameIndx].deadline = server_clock() + limits.timeout;
+}
+
+/**
+ * @brief Asks the kernel to busy-poll the device queue for a short time when the socket is read
+ * instead of waiting for an interrupt. Needs CAP_NET_ADMIN to raise the value above the system
+ * default, so failure is reported but not fatal.
+ * 
+ * @param sd The socket descriptor of the server comminication endpoint.
+ */
+void enable_busy_poll(int sd) {
+#ifdef SO_BUSY_POLL
+    int usec = BUSY_POLL_USEC;
+    if (setsockopt(sd, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof(usec)) < 0) {
+        print_error("enable_busy_poll", errno, 0);
+    }
+#endif
+}
+
+/**
+ * @brief Pins a thread to a single CPU so it keeps its cache and is never migrated. CPU
+ * numbers past the last online CPU wrap around.
+ * 
+ * @param thread The thread to pin.
+ * @param cpu The CPU to pin the thread to.
+ */
+void pin_thread(pthread_t thread, int cpu) {
+    int rv;
+    cpu_set_t cpus;
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu % ((online > 0) ? online : 1), &cpus);
+    if ((rv = pthread_setaffinity_np(thread, sizeof(cpus), &cpus)) != 0) print_error("pin_thread", rv, 0);
+}
+
+/**
+ * @brief Runs the calling thread under the SCHED_FIFO real-time scheduler, so it preempts
+ * every normal thread as soon as it is runnable. Needs CAP_SYS_NICE, so failure is reported
+ * but not fatal.
+ * 
+ * @param priority The SCHED_FIFO priority.
+ */
+void set_realtime(int priority) {
+    struct sched_param param = {0};
+    param.sched_priority = priority;
+    if (sched_setscheduler(0, SCHED_FIFO, &param) < 0) print_error("set_realtime", errno, 0);
+}
+
+/**
+ * @brief Locks every current and future page of the process in memory, which also faults in
+ * every page already allocated (the position cache, pools and queues), so no command ever
+ * waits on a page fault or on swap.
+ */
+void lock_memory(void) {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) print_error("lock_memory", errno, 0);
+}
+
+/**
+ * @brief Touches the stack the receive loop will use (the game roster and the deepest search)
+ * so it is faulted in and locked before the first command arrives.
+ */
+void prefault_stack(void) {
+    char stack[STACK_PREFAULT];
+    memset(stack, 0, sizeof(stack));
+    /* Keep the compiler from dropping the writes to the otherwise unused buffer */
+    __asm__ volatile("" : : "r"(stack) : "memory");
+}
+
+/**
+ * @brief Waits for a command or a move computed by the engine workers. In low-latency mode the
+ * descriptors are polled in a spin loop for up to SPIN_TIME milliseconds, so no wakeup is paid
+ * when a datagram arrives during a burst of traffic. Once the server has been quiet that long
+ * it sleeps as usual, so an idle server (possibly running under SCHED_FIFO) does not starve the
+ * rest of the machine.
+ * 
+ * The shared-memory rings (and the commands already read from stream clients) are checked along
+ * with the descriptors, and shared-memory clients are only asked to wake the server once it is
+ * about to sleep.
+ * 
+ * @param events The descriptors to wait on.
+ * @param numEvents The number of descriptors.
+ * @return The number of descriptors that are ready (plus one if shared-memory or stream commands
+ * are waiting), 0 if the server timed out, or -1 if an error occured (errno is set).
+ */
+int wait_for_events(struct pollfd *events, int numEvents) {
+    int ready = 0;
+    uint64_t start = trace_clock(), spinEnd = start + SPIN_TIME * 1000000ULL;
+    /* Commands already queued or read from stream clients are handled without waiting */
+    if (scheduler.count > 0 || stream_requests_waiting()) return ((ready = poll(events, numEvents, 0)) < 0) ? ready : ready + 1;
+    if (spinReceive) {
+        while ((ready = poll(events, numEvents, 0)) == 0 && !shm_requests_waiting() && !stream_requests_waiting() && trace_clock() < spinEnd) {
+            /* Keep serving trace dump requests while spinning */
+            trace_poll();
+        }
+        if (ready != 0) return ready;
+        if (shm_requests_waiting() || stream_requests_waiting()) return 1;
+    }
+    /* Ask the shared-memory clients to wake the server unless a command has already arrived */
+    if (!arm_shm_peers()) return ((ready = poll(events, numEvents, 0)) < 0) ? ready : ready + 1;
+    ready = poll(events, numEvents, limits.timeout * 1000 - (int)((trace_clock() - start) / 1000000));
+    disarm_shm_peers();
+    return ready;
+}
+
+/**
+ * @brief Pool task that searches a single root move of a parallel search and records its score
+ * if it is the best found so far. Scores from searches cut short by the time budget are dropped.
+ * 
+ * @param arg The root move task.
+ */
+void search_root_task(void *arg) {
+    struct Root_Task *task = arg;
+    struct Parallel_Search *search = task->search;
+    struct Search_Context ctx = {&search->alpha, &search->stop, search->deadline, 0};
+    int value = ttt_search_move(search->variant, &search->board, task->square, search->horizon, &ctx);
+    pthread_mutex_lock(&search->lock);
+    search->nodes += ctx.nodes;
+    /* A score above the shared bound is exact, so it is the new best root move */
+    if (!atomic_load(&search->stop) && value > search->bestValue) {
+        search->bestValue = value;
+        search->bestMove = task->square;
+        atomic_store(&search->alpha, value);
+    }
+    pthread_mutex_unlock(&search->lock);
+}
+
+/**
+ * @brief Searches every root move once to the current horizon. The first move (the best move
+ * from the previous iteration) is searched alone to establish a good cutoff bound, then the
+ * remaining moves are split across the pool (young brothers wait at the root).
+ * 
+ * @param search The parallel search being run.
+ * @param pool The pool to split the search across, or NULL to search on the calling thread.
+ * @param firstMove The root move (0-based) to search first.
+ * @return The best root move (0-based) found, or -1 if the time budget ran out first.
+ */
+int search_iteration(struct Parallel_Search *search, struct Pool *pool, int firstMove) {
+    int i, numTasks = 0;
+    struct Root_Task tasks[MAX_SQUARES];
+    struct Pool_Group group = {0};
+    uint32_t open = ~(search->board.marks[0] | search->board.marks[1]);
+    const struct TTT_Variant *variant = search->variant;
+    /* Reset the shared bound and best move for this iteration */
+    atomic_store(&search->alpha, INT32_MIN);
+    search->bestMove = -1;
+    search->bestValue = INT32_MIN;
+    /* Search the first move alone */
+    tasks[numTasks].search = search;
+    tasks[numTasks].square = firstMove;
+    search_root_task(&tasks[numTasks++]);
+    /* Split the remaining moves across the pool */
+    for (i = 0; i < variant->squares; i++) {
+        int square = variant->moveOrder[i];
+        if (square == firstMove || !(open & (1u << square))) continue;
+        tasks[numTasks].search = search;
+        tasks[numTasks].square = square;
+        if (pool != NULL) {
+            pool_submit(pool, &group, search_root_task, &tasks[numTasks]);
+        } else {
+            search_root_task(&tasks[numTasks]);
+        }
+        numTasks++;
+    }
+    if (pool != NULL) pool_wait(pool, &group);
+    return search->bestMove;
+}
+
+/**
+ * @brief Finds the best move for Player 1 with an iterative-deepening parallel alpha-beta search.
+ * Each iteration searches one ply deeper than the last until the board is exhausted, the maximum
+ * horizon is reached, or the time budget runs out, in which case the best move found so far is
+ * returned.
+ * 
+ * @param variant The board variant being searched.
+ * @param board The board to search.
+ * @param pool The pool to split the search across, or NULL to search on the calling thread.
+ * @param budget The time budget in milliseconds (0 for none).
+ * @param maxHorizon The deepest horizon to search to (0 for no limit).
+ * @param nodes If not NULL, set to the total number of nodes searched.
+ * @return The best square (1-based) found, or -1 if the board is full.
+ */
+int parallel_find_best_move(const struct TTT_Variant *variant, const struct TTT_Board *board, struct Pool *pool, int budget, int maxHorizon, uint64_t *nodes) {
+    int i, bestMove = -1, remaining = 0;
+    struct Parallel_Search search = {0};
+    uint32_t open = ~(board->marks[0] | board->marks[1]);
+    /* Count the open squares and default to the first one in search order */
+    for (i = 0; i < variant->squares; i++) {
+        if (!(open & (1u << variant->moveOrder[i]))) continue;
+        if (bestMove < 0) bestMove = variant->moveOrder[i];
+        remaining++;
+    }
+    if (bestMove < 0) return -1;
+    search.variant = variant;
+    search.board = *board;
+    search.deadline = (budget > 0) ? trace_clock() + (uint64_t)budget * 1000000ULL : 0;
+    pthread_mutex_init(&search.lock, NULL);
+    /* Deepen one ply at a time, searching the previous best move first */
+    for (search.horizon = 0; search.horizon < remaining; search.horizon++) {
+        int move = search_iteration(&search, pool, bestMove);
+        if (move >= 0) bestMove = move;
+        if (atomic_load(&search.stop) || (maxHorizon > 0 && search.horizon >= maxHorizon)) break;
+    }
+    pthread_mutex_destroy(&search.lock);
+    if (nodes != NULL) *nodes = search.nodes;
+    return bestMove + 1;
+}
+
+/**
+ * @brief Benchmarks the parallel search against the number of threads used. Each larger board
+ * variant is searched to a fixed horizon (without a time budget) with 1, 2, 4, ... threads
+ * up to the given maximum, and the speedup over a single thread is reported.
+ * 
+ * @param maxThreads The largest number of threads to benchmark.
+ */
+void run_search_benchmark(int maxThreads) {
+    /* Board variants and horizons benchmarked */
+    static const struct { int variant, horizon; } cases[] = {{1, 9}, {2, 8}};
+    int c;
+    printf("[+]Parallel search benchmark (fixed horizon, no time budget)\n");
+    printf("%-8s %8s %8s %10s %12s %10s %8s\n", "variant", "horizon", "threads", "time (ms)", "nodes", "Mnodes/s", "speedup");
+    for (c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        const struct TTT_Variant *variant = ttt_get_variant(cases[c].variant);
+        struct TTT_Board board = {{0, 0}};
+        double baseline = 0;
+        int threads;
+        for (threads = 1; threads <= maxThreads; threads = (threads * 2 > maxThreads && threads < maxThreads) ? maxThreads : threads * 2) {
+            struct Pool *pool = (threads > 1) ? pool_create(threads - 1) : NULL;
+            uint64_t nodes, start = trace_clock();
+            int move = parallel_find_best_move(variant, &board, pool, 0, cases[c].horizon, &nodes);
+            double elapsed = (trace_clock() - start) / 1e6;
+            if (threads == 1) baseline = elapsed;
+            printf("%-8s %8d %8d %10.1f %12llu %10.2f %7.2fx  (move %d)\n", variant->name, cases[c].horizon, threads,
+                elapsed, (unsigned long long)nodes, nodes / elapsed / 1e3, baseline / elapsed, move);
+            pool_destroy(pool);
+        }
+    }
+}
+
+/**
+ * @brief Packs a game's board, variant, game number and last moves into a single 64-bit word
+ * for cold storage. The NEW_GAME tag only matters before Player 2's first move, so it shares
+ * its bits with Player 2's last move.
+ * 
+ * @param game The game to pack.
+ * @return The packed game (never 0).
+ */
+uint64_t pack_game(const struct TTT_Game *game) {
+    uint64_t packed = ttt_pack_board(get_variant(game), &game->state->board) | (uint64_t)game->state->variant << 40 |
+        (uint64_t)game->gameNum << 42 | (uint64_t)game->state->lastReply << 51;
+    if (game->state->lastMove != 0) return packed | 1ULL << 50 | (uint64_t)game->state->lastMove << 56;
+    return packed | (uint64_t)game->info->tag << 56;
+}
+
+/**
+ * @brief Unpacks the board, variant and last moves of a game packed by pack_game().
+ * 
+ * @param packed The packed game.
+ * @param game The game to unpack into.
+ */
+void unpack_game(uint64_t packed, struct TTT_Game *game) {
+    game->state->variant = (packed >> 40) & 3;
+    ttt_unpack_board(get_variant(game), packed & ((1ULL << 40) - 1), &game->state->board);
+    game->state->lastReply = (packed >> 51) & 31;
+    game->state->lastMove = ((packed >> 50) & 1) ? (packed >> 56) & 31 : 0;
+    game->info->tag = cold_game_tag(packed);
+}
+
+/**
+ * @brief Gets the game number of a game packed by pack_game().
+ * 
+ * @param packed The packed game.
+ * @return The game number.
+ */
+int cold_game_number(uint64_t packed) {
+    return (packed >> 42) & 255;
+}
+
+/**
+ * @brief Gets the NEW_GAME tag of a game packed by pack_game().
+ * 
+ * @param packed The packed game.
+ * @return The tag, or 0 if the game has none or Player 2 has made a move in it.
+ */
+int cold_game_tag(uint64_t packed) {
+    return ((packed >> 50) & 1) ? 0 : (int)(packed >> 56);
+}
+
+/**
+ * @brief Determines whether a game can be evicted to cold storage, i.e. it is waiting on its
+ * remote player and has no move being computed.
+ * 
+ * @param roster The roster of playable TicTacToe games.
+ * @param index The roster index of the game.
+ * @return True if the game can be evicted, false otherwise.
+ */
+int can_evict(const struct TTT_Roster *roster, int index) {
+    return roster->state[index].player == 2 && roster->pending[index] == NULL;
+}
+
+/**
+ * @brief Evicts an idle game from its roster slot to cold storage, opening the slot. The game
+ * waits there for its remote player for up to the cold storage timeout.
+ * 
+ * @param roster The roster of playable TicTacToe games.
+ * @param index The roster index of the game.
+ * @return The cold storage index of the game, or an error code if the game cannot be evicted
+ * or cold storage is full.
+ */
+int evict_game(struct TTT_Roster *roster, int index) {
+    int i;
+    struct TTT_Game game = get_game(roster, index);
+    if (!can_evict(roster, index)) return ERROR_CODE;
+    /* Searches for an unused cold storage record */
+    for (i = 0; i < COLD_GAMES; i++) {
+        if (roster->cold[i].packed == 0) {
+            roster->cold[i].packed = pack_game(&game);
+            roster->cold[i].p2Addr = game.info->p2Addr;
+            roster->cold[i].p2Port = game.info->p2Port;
+            roster->cold[i].expires = (uint16_t)(server_clock() + limits.coldTimeout);
+            printf("[+]Game #%d has gone idle. Moved to cold storage.\n", game.gameNum);
+            reset_game(&game);
+            return i;
+        }
+    }
+    return ERROR_CODE;
+}
+
+/**
+ * @brief Evicts the game that has waited longest on its remote player to open a roster slot
+ * (within the current capacity) for a new game.
+ * 
+ * @param roster The roster of playable TicTacToe games.
+ * @return The roster index that was opened, or an error code if no game could be evicted.
+ */
+int evict_idle_game(struct TTT_Roster *roster) {
+    int i, oldest = ERROR_CODE;
+    /* Searches over the games within capacity for the earliest deadline */
+    for (i = 0; i < limits.capacity; i++) {
+        if (can_evict(roster, i) && (oldest < 0 || roster->state[i].deadline < roster->state[oldest].deadline)) oldest = i;
+    }
+    if (oldest < 0 || evict_game(roster, oldest) == ERROR_CODE) return ERROR_CODE;
+    return oldest;
+}
+
+/**
+ * @brief Evicts every game waiting on its remote player to cold storage.
+ * 
+ * @param roster The roster of playable TicTacToe games.
+ * @return The number of games evicted.
+ */
+int evict_idle_games(struct TTT_Roster *roster) {
+    int i, count = 0;
+    for (i = 0; i < maxGames; i++) {
+        if (evict_game(roster, i) != ERROR_CODE) count++;
+    }
+    return count;
+}
+
+/**
+ * @brief Finds a game in cold storage by its remote player and game number.
+ * 
+ * @param roster The roster of playable TicTacToe games.
+ * @param playerAddr The address of the remote player.
+ * @param gameNum The game number the remote player knows the game by.
+ * @return The cold storage index of the game, or an error code if it is not in cold storage.
+ */
+int find_cold_game(const struct TTT_Roster *roster, const struct sockaddr_in *playerAddr, int gameNum) {
+    int i;
+    for (i = 0; i < COLD_GAMES; i++) {
+        const struct Cold_Game *cold = &roster->cold[i];
+        if (cold->packed != 0 && cold_game_number(cold->packed) == gameNum &&
+            cold->p2Addr == playerAddr->sin_addr.s_addr && cold->p2Port == playerAddr->sin_port) return i;
+    }
+    return ERROR_CODE;
+}
+
+/**
+ * @brief Finds the game a tagged NEW_GAME command already opened in cold storage, if the remote
+ * player has not made a move in it yet (see find_tagged_game()).
+ * 
+ * @param roster The roster of playable TicTacToe games.
+ * @param playerAddr The address of the remote player.
+ * @param tag The tag of the NEW_GAME command (the game number field).
+ * @return The cold storage index of the game, or an error code if it is not in cold storage.
+ */
+int find_cold_tagged_game(const struct TTT_Roster *roster, const struct sockaddr_in *playerAddr, int tag) {
+    int i;
+    for (i = 0; i < COLD_GAMES; i++) {
+        const struct Cold_Game *cold = &roster->cold[i];
+        if (cold->packed != 0 && cold_game_tag(cold->packed) == tag &&
+            cold->p2Addr == playerAddr->sin_addr.s_addr && cold->p2Port == playerAddr->sin_port) return i;
+    }
+    return ERROR_CODE;
+}
+
+/**
+ * @brief Restores a game from cold storage into its (open) roster slot, waiting on Player 2.
+ * 
+ * @param roster The roster of playable TicTacToe games.
+ * @param index The roster index to restore the game to.
+ * @param cold The cold storage record of the game.
+ */
+void restore_game(struct TTT_Roster *roster, int index, const struct Cold_Game *cold) {
+    struct TTT_Game game = get_game(roster, index);
+    unpack_game(cold->packed, &game);
+    game.info->p2Addr = cold->p2Addr;
+    game.info->p2Port = cold->p2Port;
+    game.state->player = 2;
+    game.state->deadline = server_clock() + limits.timeout;
+    printf("[+]Game #%d restored from cold storage.\n", game.gameNum);
+}
+
+/**
+ * @brief Drops every game in cold storage whose remote player has not come back in time.
+ * 
+ * @param roster The roster of playable TicTacToe games.
+ */
+void expire_cold_games(struct TTT_Roster *roster) {
+    int i;
+    uint16_t now = (uint16_t)server_clock();
+    for (i = 0; i < COLD_GAMES; i++) {
+        struct Cold_Game *cold = &roster->cold[i];
+        /* Compare with wraparound of the 16 bit clock */
+        if (cold->packed != 0 && (int16_t)(cold->expires - now) <= 0) {
+            struct in_addr addr = {cold->p2Addr};
+            printf("[+]Game #%d in cold storage has timed out.\n", cold_game_number(cold->packed));
+            printf("Player at %s (port %d) ran out of time to respond.\n", inet_ntoa(addr), cold->p2Port);
+            cold->packed = 0;
+        }
+    }
+}
+
+/**
+ * @brief Finds the roster slot a command is for. A NEW_GAME command gets an open slot, evicting
+ * the longest idle game to cold storage if every slot is taken. A MOVE command for a game in
+ * cold storage, or a repeated NEW_GAME for a game evicted before its first move, has the game
+ * restored to its slot, evicting the slot's current game if needed.
+ * 
+ * @param roster The roster of playable TicTacToe games.
+ * @param playerAddr The address of the remote player.
+ * @param datagram The command that the remote player sent.
+ * @return The roster index the command is for, or an error code if no slot is available (or
+ * the command is not for a game).
+ */
+int locate_game(struct TTT_Roster *roster, const struct sockaddr_in *playerAddr, const struct Buffer *datagram) {
+    int index, coldIndex;
+    struct TTT_Game game;
+    struct sockaddr_in p2Address;
+    struct Cold_Game cold;
+    if (datagram->command == NEW_GAME) {
+        /* A repeated NEW_GAME is for the game it already opened, even if that game was evicted since */
+        if (datagram->gameNum != 0 && (index = find_tagged_game(roster, playerAddr, (uint8_t)datagram->gameNum)) != ERROR_CODE) return index;
+        if (datagram->gameNum == 0 || (coldIndex = find_cold_tagged_game(roster, playerAddr, (uint8_t)datagram->gameNum)) == ERROR_CODE) {
+            if ((index = find_open_game(roster)) == ERROR_CODE) index = evict_idle_game(roster);
+            return index;
+        }
+        index = cold_game_number(roster->cold[coldIndex].packed) - 1;
+    } else if (datagram->command == ANALYZE) {  // not tied to a game
+        return ERROR_CODE;
+    } else {
+        /* The game is hot if the slot is being played by the same player */
+        index = datagram->gameNum - 1;
+        game = get_game(roster, index);
+        p2Address = player_address(&game);
+        if (roster->state[index].player != 0 && same_address(playerAddr, &p2Address)) return index;
+        /* Otherwise restore it from cold storage if it was evicted */
+        if ((coldIndex = find_cold_game(roster, playerAddr, datagram->gameNum)) == ERROR_CODE) return index;
+    }
+    /* Free the record first so the slot's current game can take its place */
+    cold = roster->cold[coldIndex];
+    roster->cold[coldIndex].packed = 0;
+    if (roster->state[index].player == 0 || evict_game(roster, index) != ERROR_CODE) {
+        restore_game(roster, index, &cold);
+    } else {
+        roster->cold[coldIndex] = cold;
+        /* The slot belongs to another player until its game can be evicted */
+        if (datagram->command == NEW_GAME) return ERROR_CODE;
+    }
+    return index;
+}
+
+/**
+ * @brief Finds the best move and its minimax score for the maximizer on a board, searching the
+ * canonical form of the board only if it is not already in the position cache. Safe to call
+ * from the engine workers.
+ * 
+ * @param variant The board variant.
+ * @param board The board to analyze (the player to move holds marks[0]).
+ * @param score Set to the minimax score of the best move.
+ * @return The best square (1-based) to play.
+ */
+int analyze_board(const struct TTT_Variant *variant, const struct TTT_Board *board, int *score) {
+    int square, move, symmetry;
+    struct TTT_Board canonical;
+    uint64_t key = ttt_canonical_board(variant, board, &canonical, &symmetry);
+    const unsigned char *map = &variant->symmetries[symmetry * MAX_SQUARES];
+    if (!cache_lookup(analysisCache, key, &move, score)) {
+        move = ttt_find_best_move(variant, &canonical, score);
+        cache_insert(analysisCache, key, move, *score);
+    }
+    /* Map the move on the canonical board back to the board that was asked about */
+    for (square = 0; square < variant->squares; square++) {
+        if (map[square] == move - 1) return square + 1;
+    }
+    return move;
+}
+
+/**
+ * @brief Sends the result of an ANALYZE command to the remote player.
+ * 
+ * @param sd The socket descriptor of the server comminication endpoint.
+ * @param playerAddr The address of the remote player.
+ * @param tag The game number field of the command, echoed back to the player.
+ * @param move The best square (1-based) to play.
+ * @param score The minimax score of the best move.
+ */
+void send_analysis(int sd, const struct sockaddr_in *playerAddr, char tag, int move, int score) {
+    struct Analysis analysis = {{VERSION, ANALYZE, move + '0', tag}, htonl((uint32_t)score)};
+    printf("Server analyzed the board: best move %d (score %d)\n", move, score);
+    TRACE_BEGIN(STAGE_SEND);
+    if (send_reply(sd, &analysis, sizeof(struct Analysis), playerAddr) < 0) {
+        print_error("send_analysis", errno, 0);
+    }
+    TRACE_END(STAGE_SEND);
+}
+
+/**
+ * @brief Engine job that searches for Player 1's move on the board snapshot taken when the
+ * job was queued. Runs on an engine worker, so it must not touch the game roster.
+ * 
+ * @param job The move job.
+ */
+void compute_move(struct Engine_Job *job) {
+    struct Move_Job *moveJob = (struct Move_Job *)job;
+    moveJob->started = trace_clock();
+    PROBE(search__start, moveJob->gameIndex + 1, moveJob->variant, __builtin_popcount(moveJob->board.marks[0] | moveJob->board.marks[1]));
+    if (moveJob->command == ANALYZE) {
+        moveJob->move = analyze_board(ttt_get_variant(moveJob->variant), &moveJob->board, &moveJob->score);
+    } else {
+        moveJob->move = search_board(ttt_get_variant(moveJob->variant), &moveJob->board);
+    }
+    moveJob->finished = trace_clock();
+    PROBE(search__end, moveJob->gameIndex + 1, moveJob->move, moveJob->finished - moveJob->started);
+}
+
+/**
+ * @brief Collects the moves finished by the engine workers and sends each one to its game's
+ * remote player. Each game has at most one move being computed, so moves are applied in the
+ * order the game received its commands. Moves for games that were reset (e.g. timed out) while
+ * the move was queued or being searched are dropped.
+ * 
+ * @param sd The socket descriptor of the server comminication endpoint.
+ * @param roster The roster of playable TicTacToe games.
+ */
+void collect_moves(int sd, struct TTT_Roster *roster) {
+    struct Engine_Job *done;
+    engine_clear_event(engine);
+    while ((done = engine_complete(engine)) != NULL) {
+        struct Move_Job *job = (struct Move_Job *)done;
+        struct TTT_Game game;
+        /* Pick up tracing the command where it was set aside */
+        if (traceEnabled && !atomic_load(&job->job.cancelled)) {
+            trace_command_resume(&job->trace);
+            trace_stage_add(STAGE_ENGINE, job->started - job->queued);
+            trace_stage_add(STAGE_SEARCH, job->finished - job->started);
+        }
+        /* Analyses are not tied to a game */
+        if (job->command == ANALYZE) {
+            send_analysis(sd, &job->playerAddr, job->tag, job->move, job->score);
+            if (traceEnabled) trace_command_end(job->command);
+            free(job);
+            continue;
+        }
+        game = get_game(roster, job->gameIndex);
+        if (!atomic_load(&job->job.cancelled)) {
+            *game.pending = NULL;
+            printf("********  Game #%d  ********\n", game.gameNum);
+            finish_p1_move(sd, &game, job->move);
+            if (traceEnabled) trace_command_end(job->command);
+            /* Restart the remote player's clock now that they have the move */
+            if (game.state->player != 0) game.state->deadline = server_clock() + limits.timeout;
+        }
+        free(job);
+    }
+}
+
+/**
+ * @brief Searches the moves set aside during a scheduler pass, the boards of each variant
+ * together in lockstep, and sends each one to its game's remote player in the order they were
+ * requested. Moves for games that were reset since they were set aside are dropped.
+ * 
+ * @param sd The socket descriptor of the server comminication endpoint.
+ * @param roster The roster of playable TicTacToe games.
+ */
+void search_move_batch(int sd, struct TTT_Roster *roster) {
+    struct TTT_Board boards[MAX_GAMES_LIMIT];
+    int i, j, count, index[MAX_GAMES_LIMIT], moves[MAX_GAMES_LIMIT];
+    uint64_t started = (traceEnabled || PROBE_ENABLED(search__end)) ? trace_clock() : 0, elapsed;
+    /* Search the boards of each variant (the first time it is seen) together */
+    for (i = 0; i < moveBatch.count; i++) {
+        for (j = 0; j < i && moveBatch.jobs[j].variant != moveBatch.jobs[i].variant; j++);
+        if (j < i) continue;
+        for (j = i, count = 0; j < moveBatch.count; j++) {
+            if (moveBatch.jobs[j].variant != moveBatch.jobs[i].variant || atomic_load(&moveBatch.jobs[j].job.cancelled)) continue;
+            PROBE(search__start, moveBatch.jobs[j].gameIndex + 1, moveBatch.jobs[j].variant,
+                __builtin_popcount(moveBatch.jobs[j].board.marks[0] | moveBatch.jobs[j].board.marks[1]));
+            index[count] = j;
+            boards[count++] = moveBatch.jobs[j].board;
+        }
+        ttt_find_best_moves(ttt_get_variant(moveBatch.jobs[i].variant), boards, count, moves, NULL);
+        for (j = 0; j < count; j++) {
+            moveBatch.jobs[index[j]].move = moves[j];
+            PROBE(search__end, moveBatch.jobs[index[j]].gameIndex + 1, moves[j],
+                (PROBE_ENABLED(search__end) && started != 0) ? trace_clock() - started : 0);
+        }
+    }
+    elapsed = (started != 0) ? trace_clock() - started : 0;
+    /* Send the moves */
+    for (i = 0; i < moveBatch.count; i++) {
+        struct Move_Job *job = &moveBatch.jobs[i];
+        struct TTT_Game game;
+        if (atomic_load(&job->job.cancelled)) continue;
+        /* Pick up tracing the command where it was set aside (it waited on the whole batch) */
+        if (traceEnabled) {
+            trace_command_resume(&job->trace);
+            trace_stage_add(STAGE_SEARCH, elapsed);
+        }
+        game = get_game(roster, job->gameIndex);
+        *game.pending = NULL;
+        printf("********  Game #%d  ********\n", game.gameNum);
+        finish_p1_move(sd, &game, job->move);
+        if (traceEnabled) trace_command_end(job->command);
+        /* Restart the remote player's clock now that they have the move */
+        if (game.state->player != 0) game.state->deadline = server_clock() + limits.timeout;
+    }
+    moveBatch.count = 0;
+}
+
+/**
+ * @brief Waits until a captured datagram is due to be replayed, sending the moves the engine
+ * workers finish in the meantime.
+ * 
+ * @param due The trace_clock() time the datagram is due.
+ * @param roster The roster of games being replayed.
+ */
+void wait_for_replay(uint64_t due, struct TTT_Roster *roster) {
+    uint64_t now;
+    while ((now = trace_clock()) < due) {
+        struct timespec wait = {(due - now) / 1000000000ULL, (due - now) % 1000000000ULL};
+        if (engine != NULL) {
+            struct pollfd event = {engine->eventFd, POLLIN, 0};
+            if (ppoll(&event, 1, &wait, NULL) > 0) collect_moves(ERROR_CODE, roster);
+        } else {
+            nanosleep(&wait, NULL);
+        }
+    }
+}
+
+/**
+ * @brief Waits for the engine workers to finish the move being computed for a game (or every
+ * outstanding job), sending the moves they finish in the meantime.
+ * 
+ * @param roster The roster of games being replayed.
+ * @param index The roster index of the game, or an error code to wait for every job.
+ */
+void wait_for_move(struct TTT_Roster *roster, int index) {
+    while (engine != NULL && engine->outstanding > 0 && (index < 0 || roster->pending[index] != NULL)) {
+        struct pollfd event = {engine->eventFd, POLLIN, 0};
+        if (poll(&event, 1, -1) > 0) collect_moves(ERROR_CODE, roster);
+    }
+}
+
+/**
+ * @brief Replays a capture through the command dispatch in-process, with replies discarded
+ * instead of sent, and reports the throughput. Datagrams are replayed at their captured
+ * times divided by the speed, or back to back at speed 0. The report goes to stderr so the
+ * per-command output can be discarded.
+ * 
+ * @param path The path of the capture file.
+ * @param speed The replay speed multiplier (0 to replay as fast as possible).
+ */
+void replay_capture(const char *path, int speed) {
+    static struct TTT_Roster roster;
+    struct Capture_Record record;
+    uint64_t start, elapsed, replayed = 0, discarded = 0;
+    FILE *file;
+
+    if ((file = replay_open(path)) == NULL) {
+        if (errno) print_error("replay_capture: Unable to open capture", errno, 1);
+        print_error("replay_capture: Not a capture file", 0, 1);
+    }
+    /* Stub out the socket and start from an empty roster */
+    send_reply = discard_reply;
+    init_game_roster(&roster);
+    start = trace_clock();
+    while (replay_read(file, &record)) {
+        struct sockaddr_in playerAddr = {0};
+        struct Command_Datagram command = {{0}};
+        int length = (record.length < sizeof(struct Command_Datagram)) ? record.length : sizeof(struct Command_Datagram);
+        uint64_t due = start + ((speed > 0) ? record.time / speed : 0), now;
+        /* Wait until the datagram is due */
+        if (speed > 0) wait_for_replay(due, &roster);
+        playerAddr.sin_family = AF_INET;
+        playerAddr.sin_addr.s_addr = record.addr;
+        playerAddr.sin_port = record.port;
+        memcpy(&command, record.data, length);
+        replayed++;
+        /* Trace how far behind schedule the replay is as the queueing time */
+        now = trace_clock();
+        if (traceEnabled) trace_command_begin((speed > 0 && now > due) ? now - due : 0);
+        if (validate_command(&command, length) > 0) {
+            /* The player only sent the move after getting ours, so finish computing ours first */
+            if (command.header.command == MOVE) {
+                if (roster.pending[command.header.gameNum - 1] != NULL && moveBatch.count > 0) search_move_batch(ERROR_CODE, &roster);
+                wait_for_move(&roster, command.header.gameNum - 1);
+            }
+            dispatch_command(ERROR_CODE, &roster, &playerAddr, &command.header, 0);
+            check_timeout(&roster);
+        } else {
+            discarded++;
+        }
+        /* Send the moves the engine workers have finished */
+        if (engine != NULL && engine->outstanding > 0) collect_moves(ERROR_CODE, &roster);
+    }
+    /* Wait for the engine workers to finish the last moves */
+    if (moveBatch.count > 0) search_move_batch(ERROR_CODE, &roster);
+    wait_for_move(&roster, ERROR_CODE);
+    elapsed = trace_clock() - start;
+    fclose(file);
+
+    /* Report the throughput */
+    fprintf(stderr, "[+]Replayed %llu datagrams (%llu discarded) from %s in %.3f s: %.0f commands/s, %llu replies.\n",
+        (unsigned long long)replayed, (unsigned long long)discarded, path, elapsed / 1e9,
+        (elapsed > 0) ? replayed * 1e9 / elapsed : 0.0, (unsigned long long)repliesDiscarded);
+    if (traceEnabled) trace_dump(stderr);
+}
+
+/**
+ * @brief Asks the kernel to attach to each datagram received the number of datagrams it has
+ * dropped on the socket because the receive queue was full.
+ * 
+ * @param sd The socket descriptor of the server comminication endpoint.
+ */
+void enable_drop_counts(int sd) {
+    int on = 1;
+    if (setsockopt(sd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on)) < 0) {
+        print_error("enable_drop_counts", errno, 0);
+    }
+}
+
+/**
+ * @brief Reads the kernel's drop count attached to a received datagram, if any (the kernel
+ * only attaches it once something has been dropped).
+ * 
+ * @param msg The message header the datagram was received with.
+ */
+void read_drop_count(struct msghdr *msg) {
+    struct cmsghdr *cmsg;
+    for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+            memcpy(&dropStats.kernel, CMSG_DATA(cmsg), sizeof(uint32_t));
+        }
+    }
+}
+
+/**
+ * @brief Reads the memory use of the socket (queued bytes, buffer sizes and drops).
+ * 
+ * @param sd The socket descriptor of the server comminication endpoint.
+ * @param meminfo Set to the SK_MEMINFO_VARS counters of the socket.
+ * @return 0 on success, or an error code if the kernel does not support SO_MEMINFO.
+ */
+int read_socket_memory(int sd, uint32_t *meminfo) {
+    socklen_t length = SK_MEMINFO_VARS * sizeof(uint32_t);
+    return (getsockopt(sd, SOL_SOCKET, SO_MEMINFO, meminfo, &length) < 0) ? ERROR_CODE : 0;
+}
+
+/**
+ * @brief Samples the number of bytes queued on the receive socket, keeping the peak.
+ * 
+ * @param sd The socket descriptor of the server comminication endpoint.
+ */
+void sample_queue_depth(int sd) {
+    uint32_t meminfo[SK_MEMINFO_VARS];
+    if (read_socket_memory(sd, meminfo) == ERROR_CODE) return;
+    if (meminfo[SK_MEMINFO_RMEM_ALLOC] > socketTuning.queuePeak) socketTuning.queuePeak = meminfo[SK_MEMINFO_RMEM_ALLOC];
+    if (meminfo[SK_MEMINFO_RMEM_ALLOC] > socketTuning.windowPeak) socketTuning.windowPeak = meminfo[SK_MEMINFO_RMEM_ALLOC];
+}
+
+/**
+ * @brief Sets the size of a socket buffer, going past the system limit if the server has
+ * CAP_NET_ADMIN.
+ * 
+ * @param sd The socket descriptor of the server comminication endpoint.
+ * @param option The buffer to set (SO_RCVBUF or SO_SNDBUF).
+ * @param forceOption The privileged version of the option (SO_RCVBUFFORCE or SO_SNDBUFFORCE).
+ * @param bytes The size requested.
+ * @return The size the kernel actually gave the buffer (in the same units as the request), or
+ * an error code if it could not be read back.
+ */
+int set_buffer_size(int sd, int option, int forceOption, int bytes) {
+    int actual;
+    socklen_t length = sizeof(actual);
+    if (setsockopt(sd, SOL_SOCKET, forceOption, &bytes, sizeof(bytes)) < 0
+            && setsockopt(sd, SOL_SOCKET, option, &bytes, sizeof(bytes)) < 0) {
+        print_error("set_buffer_size", errno, 0);
+    }
+    if (getsockopt(sd, SOL_SOCKET, option, &actual, &length) < 0) return ERROR_CODE;
+    /* The kernel doubles the size to leave room for its bookkeeping */
+    return actual / 2;
+}
+
+/**
+ * @brief Turns on automatic tuning of the socket buffers, starting from the current sizes
+ * moved within the bounds.
+ * 
+ * @param sd The socket descriptor of the server comminication endpoint.
+ * @param minBuffer The smallest buffer size (in bytes) to set.
+ * @param maxBuffer The largest buffer size (in bytes) to set.
+ */
+void start_buffer_tuning(int sd, int minBuffer, int maxBuffer) {
+    int rcvBuffer, sndBuffer;
+    socklen_t length = sizeof(int);
+    socketTuning.minBuffer = minBuffer;
+    socketTuning.maxBuffer = maxBuffer;
+    if (getsockopt(sd, SOL_SOCKET, SO_RCVBUF, &rcvBuffer, &length) < 0 || getsockopt(sd, SOL_SOCKET, SO_SNDBUF, &sndBuffer, &length) < 0) {
+        print_error("start_buffer_tuning", errno, 1);
+    }
+    rcvBuffer = (rcvBuffer / 2 < minBuffer) ? minBuffer : (rcvBuffer / 2 > maxBuffer) ? maxBuffer : rcvBuffer / 2;
+    sndBuffer = (sndBuffer / 2 < minBuffer) ? minBuffer : (sndBuffer / 2 > maxBuffer) ? maxBuffer : sndBuffer / 2;
+    socketTuning.rcvBuffer = set_buffer_size(sd, SO_RCVBUF, SO_RCVBUFFORCE, rcvBuffer);
+    socketTuning.sndBuffer = set_buffer_size(sd, SO_SNDBUF, SO_SNDBUFFORCE, sndBuffer);
+    printf("[+]Socket buffers tuned between %d and %d bytes (receive %d, send %d).\n",
+        minBuffer, maxBuffer, socketTuning.rcvBuffer, socketTuning.sndBuffer);
+}
+
+/**
+ * @brief Adjusts the socket buffers based on the drops in the last interval. A buffer is
+ * doubled (up to the maximum) after any interval with drops, and halved (down to the minimum)
+ * after SHRINK_INTERVALS intervals in a row without drops, as long as the receive queue never
+ * filled more than a quarter of it in that time.
+ * 
+ * @param sd The socket descriptor of the server comminication endpoint.
+ * @param delta The drops in the last interval.
+ */
+void tune_buffers(int sd, const struct Drop_Stats *delta) {
+    int oldSize, newSize, minBuffer = socketTuning.minBuffer, maxBuffer = socketTuning.maxBuffer;
+    /* Receive buffer: the kernel drops datagrams when it is full */
+    oldSize = socketTuning.rcvBuffer;
+    if (delta->kernel > 0) {
+        socketTuning.quietIntervals = 0;
+        socketTuning.windowPeak = 0;
+        if (oldSize < maxBuffer) {
+            newSize = (oldSize > maxBuffer / 2) ? maxBuffer : oldSize * 2;
+            socketTuning.rcvBuffer = set_buffer_size(sd, SO_RCVBUF, SO_RCVBUFFORCE, newSize);
+            printf("[+]Receive buffer raised from %d to %d bytes after %u kernel drops.\n", oldSize, socketTuning.rcvBuffer, delta->kernel);
+        } else {
+            printf("[+]Receive buffer is at its %d byte limit; the server is not keeping up.\n", maxBuffer);
+        }
+    } else if (++socketTuning.quietIntervals >= SHRINK_INTERVALS) {
+        /* The kernel's queue accounting is twice the requested size, so a quarter is oldSize / 2 */
+        if (oldSize > minBuffer && socketTuning.windowPeak < (uint32_t)oldSize / 2) {
+            newSize = (oldSize / 2 < minBuffer) ? minBuffer : oldSize / 2;
+            socketTuning.rcvBuffer = set_buffer_size(sd, SO_RCVBUF, SO_RCVBUFFORCE, newSize);
+            printf("[+]Receive buffer lowered from %d to %d bytes (queue peaked at %u bytes with no drops).\n",
+                oldSize, socketTuning.rcvBuffer, socketTuning.windowPeak);
+        }
+        socketTuning.quietIntervals = 0;
+        socketTuning.windowPeak = 0;
+    }
+    /* Send buffer: sendto() fails when it is full */
+    oldSize = socketTuning.sndBuffer;
+    if (delta->sendFailed > 0) {
+        socketTuning.sendQuietIntervals = 0;
+        if (oldSize < maxBuffer) {
+            newSize = (oldSize > maxBuffer / 2) ? maxBuffer : oldSize * 2;
+            socketTuning.sndBuffer = set_buffer_size(sd, SO_SNDBUF, SO_SNDBUFFORCE, newSize);
+            printf("[+]Send buffer raised from %d to %d bytes after %llu failed sends.\n", oldSize, socketTuning.sndBuffer, (unsigned long long)delta->sendFailed);
+        }
+    } else if (++socketTuning.sendQuietIntervals >= SHRINK_INTERVALS) {
+        if (oldSize > minBuffer) {
+            newSize = (oldSize / 2 < minBuffer) ? minBuffer : oldSize / 2;
+            socketTuning.sndBuffer = set_buffer_size(sd, SO_SNDBUF, SO_SNDBUFFORCE, newSize);
+            printf("[+]Send buffer lowered from %d to %d bytes (no failed sends).\n", oldSize, socketTuning.sndBuffer);
+        }
+        socketTuning.sendQuietIntervals = 0;
+    }
+}
+
+/**
+ * @brief Reports the datagrams dropped since the last report, keeping the kernel's drops
+ * (the receive queue overflowed) apart from the server's own (invalid or rejected commands
+ * and replies that could not be sent), along with the games that timed out, and adjusts the
+ * socket buffers if tuning is on.
+ * 
+ * @param sd The socket descriptor of the server comminication endpoint.
+ */
+void report_drops(int sd) {
+    uint32_t meminfo[SK_MEMINFO_VARS] = {0};
+    struct Drop_Stats delta;
+    socketTuning.nextCheck = trace_clock() + TUNE_INTERVAL * 1000000000ULL;
+    /* The socket's own counter is current even if nothing has been received since the drops */
+    if (read_socket_memory(sd, meminfo) == 0) {
+        if (meminfo[SK_MEMINFO_DROPS] > dropStats.kernel) dropStats.kernel = meminfo[SK_MEMINFO_DROPS];
+        if (meminfo[SK_MEMINFO_RMEM_ALLOC] > socketTuning.queuePeak) socketTuning.queuePeak = meminfo[SK_MEMINFO_RMEM_ALLOC];
+        if (meminfo[SK_MEMINFO_RMEM_ALLOC] > socketTuning.windowPeak) socketTuning.windowPeak = meminfo[SK_MEMINFO_RMEM_ALLOC];
+    }
+    delta.kernel = dropStats.kernel - reportedDrops.kernel;
+    delta.invalid = dropStats.invalid - reportedDrops.invalid;
+    delta.rejected = dropStats.rejected - reportedDrops.rejected;
+    delta.sendFailed = dropStats.sendFailed - reportedDrops.sendFailed;
+    delta.received = dropStats.received - reportedDrops.received;
+    delta.timedOut = dropStats.timedOut - reportedDrops.timedOut;
+    if (delta.kernel > 0 || delta.invalid > 0 || delta.rejected > 0 || delta.sendFailed > 0 || delta.timedOut > 0) {
+        printf("[+]Drops since the last report: kernel %u (receive queue full), server %llu (%llu invalid, %llu rejected), "
+            "replies not sent %llu, games timed out %llu; %llu datagrams received, receive queue peaked at %u of %u bytes.\n",
+            delta.kernel, (unsigned long long)(delta.invalid + delta.rejected), (unsigned long long)delta.invalid,
+            (unsigned long long)delta.rejected, (unsigned long long)delta.sendFailed, (unsigned long long)delta.timedOut,
+            (unsigned long long)delta.received, socketTuning.queuePeak, meminfo[SK_MEMINFO_RCVBUF]);
+    }
+    if (socketTuning.maxBuffer > 0) tune_buffers(sd, &delta);
+    reportedDrops = dropStats;
+    socketTuning.queuePeak = 0;
+}
+
+/**
+ * @brief Starts accepting shared-memory clients on a Unix socket. If the socket cannot be
+ * created, the function terminates the process.
+ * 
+ * @param path The path of the Unix socket.
+ */
+void start_shm_transport(const char *path) {
+    int i;
+    for (i = 0; i < SHM_PEERS; i++) shmTransport.peers[i].endpoint.conn = -1;
+    if ((shmTransport.listenFd = shm_listen(path)) < 0) handle_init_error("-U: Unable to create shared-memory socket", errno);
+}
+
+/**
+ * @brief Accepts a shared-memory client's connection and gives it a free peer slot, where it
+ * waits for its registration (see register_shm_peer()) without holding up the receive loop. A
+ * client that has not registered within SHM_REGISTER_TIMEOUT milliseconds gives up its slot to
+ * the next one. The client is refused if every slot is taken.
+ */
+void accept_shm_peer(void) {
+    int i;
+    struct Shm_Endpoint endpoint;
+    uint64_t now = trace_clock();
+    if (shm_accept(shmTransport.listenFd, &endpoint) < 0) {
+        print_error("accept_shm_peer", errno, 0);
+        return;
+    }
+    for (i = 0; i < SHM_PEERS; i++) {
+        struct Shm_Peer *peer = &shmTransport.peers[i];
+        if (peer->endpoint.conn < 0) break;
+        if (peer->endpoint.channel == NULL && now >= peer->registerBy) {
+            shm_close(&peer->endpoint);
+            break;
+        }
+    }
+    if (i == SHM_PEERS) {
+        print_error("accept_shm_peer: Too many shared-memory clients. Client refused", 0, 0);
+        shm_close(&endpoint);
+        return;
+    }
+    shmTransport.peers[i].endpoint = endpoint;
+    shmTransport.peers[i].registerBy = now + SHM_REGISTER_TIMEOUT * 1000000ULL;
+}
+
+/**
+ * @brief Finishes the registration of a shared-memory client whose connection is readable and
+ * gives it a new id. An invalid registration frees the client's slot.
+ * 
+ * @param index The peer slot of the client.
+ */
+void register_shm_peer(int index) {
+    struct Shm_Peer *peer = &shmTransport.peers[index];
+    if (shm_register(&peer->endpoint) < 0) {
+        if (errno != EAGAIN) print_error("register_shm_peer", errno, 0);  // the slot is free again
+        return;
+    }
+    /* Give each client a new id so it cannot pick up an earlier client's games (0 is never used) */
+    if (++shmTransport.nextId == 0) shmTransport.nextId = 1;
+    peer->id = shmTransport.nextId;
+    shmTransport.numPeers++;
+    shm_answer(&peer->endpoint, 1);
+    printf("[+]Shared-memory client %d connected.\n", peer->id);
+}
+
+/**
+ * @brief Disconnects a shared-memory client. Its games are left to time out.
+ * 
+ * @param index The peer slot of the client.
+ */
+void drop_shm_peer(int index) {
+    printf("[+]Shared-memory client %d disconnected.\n", shmTransport.peers[index].id);
+    shm_close(&shmTransport.peers[index].endpoint);
+    shmTransport.numPeers--;
+}
+
+/**
+ * @brief Sets the descriptors the receive loop waits on for the shared-memory transport: the
+ * registration socket, then each client's connection (to notice it hang up) and request eventfd.
+ * 
+ * @param events The descriptors the receive loop waits on.
+ */
+void watch_shm_peers(struct pollfd *events) {
+    int i, on = (shmTransport.listenFd >= 0);
+    events[2].fd = shmTransport.listenFd;
+    events[2].events = POLLIN;
+    for (i = 0; i < SHM_PEERS; i++) {
+        const struct Shm_Endpoint *endpoint = &shmTransport.peers[i].endpoint;
+        /* The peer slots are only initialized once the transport is started */
+        events[3 + 2 * i].fd = on ? endpoint->conn : -1;
+        events[3 + 2 * i].events = POLLIN;
+        events[4 + 2 * i].fd = (on && endpoint->conn >= 0) ? endpoint->requestEvent : -1;
+        events[4 + 2 * i].events = POLLIN;
+    }
+}
+
+/**
+ * @brief Handles the shared-memory transport descriptors that are ready: accepts and registers
+ * new clients, drops clients that hung up and clears late wakeups.
+ * 
+ * @param events The descriptors the receive loop waited on.
+ */
+void handle_shm_events(struct pollfd *events) {
+    int i, changed = 0;
+    uint64_t count;
+    if (events[2].revents & POLLIN) {
+        accept_shm_peer();
+        changed = 1;
+    }
+    for (i = 0; i < SHM_PEERS; i++) {
+        if (shmTransport.peers[i].endpoint.conn < 0) continue;
+        if (shmTransport.peers[i].endpoint.channel == NULL) {
+            /* The registration has arrived (or the client hung up before sending it) */
+            if (events[3 + 2 * i].revents) {
+                register_shm_peer(i);
+                changed = 1;
+            }
+        } else if (events[3 + 2 * i].revents) {
+            /* A client never writes to its connection after registering, so it has hung up */
+            drop_shm_peer(i);
+            changed = 1;
+        } else if (events[4 + 2 * i].revents & POLLIN) {
+            /* A wakeup that raced with the server waking up anyway */
+            if (read(shmTransport.peers[i].endpoint.requestEvent, &count, sizeof(count)) < 0) {
+                /* Already cleared (EAGAIN) */
+            }
+        }
+    }
+    if (changed) watch_shm_peers(events);
+}
+
+/**
+ * @brief Takes the commands queued by the shared-memory clients and queues them in the
+ * scheduler, keeping at most SHM_BATCH waiting from each client so a busy client cannot fill
+ * the scheduler. Each command goes through the same validation as a datagram.
+ * 
+ * @return The number of commands taken.
+ */
+int queue_shm_commands(void) {
+    int i, n, taken = 0;
+    for (i = 0; i < SHM_PEERS; i++) {
+        struct Shm_Peer *peer = &shmTransport.peers[i];
+        struct sockaddr_in playerAddr = client_address(SHM_ADDR, peer->id);
+        if (peer->endpoint.channel == NULL) continue;
+        for (n = count_source_commands(&playerAddr); n < SHM_BATCH && scheduler.count < PENDING_COMMANDS; n++) {
+            struct Command_Datagram command = {{0}};
+            int length = shm_pop(&peer->endpoint.channel->requests, &command, sizeof(command));
+            if (length == 0) break;
+            if (capture.file != NULL) capture_write(&capture, trace_clock(), &playerAddr, &command, length);
+            if (traceEnabled) trace_command_begin(0);
+            if (validate_command(&command, length) > 0) queue_command(&playerAddr, &command);
+            taken++;
+        }
+    }
+    return taken;
+}
+
+/**
+ * @brief Checks whether any shared-memory client has queued a command.
+ * 
+ * @return True if a command is waiting, false otherwise.
+ */
+int shm_requests_waiting(void) {
+    int i;
+    for (i = 0; i < SHM_PEERS && shmTransport.numPeers > 0; i++) {
+        if (shmTransport.peers[i].endpoint.channel != NULL && shm_pending(&shmTransport.peers[i].endpoint.channel->requests)) return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Asks every shared-memory client to wake the server on its next command. Call before
+ * sleeping, and call disarm_shm_peers() after waking.
+ * 
+ * @return True if the server may sleep, false if a command arrived in the meantime (the
+ * clients are disarmed again).
+ */
+int arm_shm_peers(void) {
+    int i;
+    for (i = 0; i < SHM_PEERS && shmTransport.numPeers > 0; i++) {
+        if (shmTransport.peers[i].endpoint.channel != NULL && !shm_arm(&shmTransport.peers[i].endpoint.channel->requests)) {
+            disarm_shm_peers();
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Stops the shared-memory clients from waking the server.
+ */
+void disarm_shm_peers(void) {
+    int i;
+    for (i = 0; i < SHM_PEERS && shmTransport.numPeers > 0; i++) {
+        struct Shm_Endpoint *endpoint = &shmTransport.peers[i].endpoint;
+        if (endpoint->channel != NULL) shm_disarm(&endpoint->channel->requests, endpoint->requestEvent);
+    }
+}
+
+/**
+ * @brief Sends a reply to a shared-memory client. Replies to clients that have disconnected
+ * are dropped, as a datagram to a player that is gone would be.
+ * 
+ * @param sd Unused.
+ * @param reply The reply datagram.
+ * @param length The size of the reply datagram.
+ * @param playerAddr The address the client is known by.
+ * @return The number of bytes sent, or -1 if the client's reply ring is full (errno is set).
+ */
+ssize_t shm_reply(int sd, const void *reply, size_t length, const struct sockaddr_in *playerAddr) {
+    int i;
+    for (i = 0; i < SHM_PEERS; i++) {
+        struct Shm_Peer *peer = &shmTransport.peers[i];
+        if (peer->endpoint.channel != NULL && peer->id == ntohs(playerAddr->sin_port)) {
+            return shm_push(&peer->endpoint.channel->replies, peer->endpoint.replyEvent, reply, length);
+        }
+    }
+    return length;
+}
+
+/**
+ * @brief Starts accepting stream clients on a TCP port or Unix socket. If the socket cannot be
+ * created, the function terminates the process.
+ * 
+ * @param address The TCP port ([<ip>:]<port>) or Unix socket path.
+ */
+void start_stream_transport(const char *address) {
+    int i;
+    for (i = 0; i < STREAM_PEERS; i++) streamTransport.peers[i].conn.fd = -1;
+    if ((streamTransport.listenFd = stream_listen(address)) < 0) handle_init_error("-S: Unable to create stream socket", errno);
+}
+
+/**
+ * @brief Accepts a stream client and gives it a free peer slot and a new id. The client is
+ * refused if every slot is taken.
+ */
+void accept_stream_peer(void) {
+    int i;
+    struct Stream_Conn conn;
+    for (i = 0; i < STREAM_PEERS && streamTransport.peers[i].conn.fd >= 0; i++);
+    if (stream_accept(streamTransport.listenFd, (i < STREAM_PEERS) ? &streamTransport.peers[i].conn : &conn) < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) print_error("accept_stream_peer", errno, 0);
+        return;
+    }
+    if (i == STREAM_PEERS) {
+        print_error("accept_stream_peer: Too many stream clients. Client refused", 0, 0);
+        stream_close(&conn);
+        return;
+    }
+    /* Give each client a new id so it cannot pick up an earlier client's games (0 is never used) */
+    if (++streamTransport.nextId == 0) streamTransport.nextId = 1;
+    streamTransport.peers[i].id = streamTransport.nextId;
+    streamTransport.peers[i].closing = 0;
+    streamTransport.numPeers++;
+    printf("[+]Stream client %d connected.\n", streamTransport.peers[i].id);
+}
+
+/**
+ * @brief Disconnects a stream client. Its games are left to time out.
+ * 
+ * @param index The peer slot of the client.
+ */
+void drop_stream_peer(int index) {
+    printf("[+]Stream client %d disconnected.\n", streamTransport.peers[index].id);
+    stream_close(&streamTransport.peers[index].conn);
+    streamTransport.numPeers--;
+}
+
+/**
+ * @brief Checks whether a stream client has a command ready to be handled. A client that is not
+ * reading its replies is not served until it makes room for them.
+ * 
+ * @param peer The stream client.
+ * @return True if a command can be handled, false otherwise.
+ */
+int stream_peer_ready(const struct Stream_Peer *peer) {
+    return peer->conn.fd >= 0 && stream_pending(&peer->conn) && stream_space(&peer->conn) >= STREAM_RESERVE;
+}
+
+/**
+ * @brief Sets the descriptors the receive loop waits on for the stream transport: the listening
+ * socket, then each client's connection. A connection is read while its input buffer has room
+ * and written to while replies could not all be sent.
+ * 
+ * @param events The descriptors the receive loop waits on.
+ */
+void watch_stream_peers(struct pollfd *events) {
+    int i, on = (streamTransport.listenFd >= 0);
+    events[STREAM_EVENT].fd = streamTransport.listenFd;
+    events[STREAM_EVENT].events = POLLIN;
+    for (i = 0; i < STREAM_PEERS; i++) {
+        const struct Stream_Peer *peer = &streamTransport.peers[i];
+        /* The peer slots are only initialized once the transport is started */
+        events[STREAM_EVENT + 1 + i].fd = on ? peer->conn.fd : -1;
+        events[STREAM_EVENT + 1 + i].events = 0;
+        if (!on || peer->conn.fd < 0) continue;
+        if (!peer->closing && (peer->conn.inStart > 0 || peer->conn.inLength < STREAM_BUFFER)) events[STREAM_EVENT + 1 + i].events |= POLLIN;
+        if (peer->conn.outLength > 0) events[STREAM_EVENT + 1 + i].events |= POLLOUT;
+    }
+}
+
+/**
+ * @brief Handles the stream transport descriptors that are ready: accepts new clients, reads the
+ * commands the clients have sent, sends replies that were held back and drops clients whose
+ * connection failed.
+ * 
+ * @param events The descriptors the receive loop waited on.
+ */
+void handle_stream_events(struct pollfd *events) {
+    int i, rv;
+    if (events[STREAM_EVENT].revents & POLLIN) accept_stream_peer();
+    for (i = 0; i < STREAM_PEERS; i++) {
+        struct Stream_Peer *peer = &streamTransport.peers[i];
+        short revents = events[STREAM_EVENT + 1 + i].revents;
+        /* Skip slots filled or emptied since the descriptors were set */
+        if (peer->conn.fd < 0 || events[STREAM_EVENT + 1 + i].fd != peer->conn.fd || revents == 0) continue;
+        if (revents & POLLIN) {
+            /* A client that shuts down its side still gets the replies to what it sent */
+            if ((rv = stream_fill(&peer->conn)) == 0) {
+                peer->closing = 1;
+            } else if (rv < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                drop_stream_peer(i);
+                continue;
+            }
+        } else if (revents & (POLLERR | POLLHUP | POLLNVAL)) {
+            drop_stream_peer(i);
+            continue;
+        }
+        if ((revents & POLLOUT) && stream_flush(&peer->conn) < 0) drop_stream_peer(i);
+    }
+}
+
+/**
+ * @brief Takes the commands the stream clients have pipelined and queues them in the scheduler,
+ * keeping at most STREAM_BATCH waiting from each client so a busy client cannot fill the
+ * scheduler. Each command goes through the same validation as a datagram; its reply is queued
+ * on the connection and sent with the others by flush_stream_peers(). A client that sends a
+ * frame that cannot be parsed is dropped.
+ * 
+ * @return The number of commands taken.
+ */
+int queue_stream_commands(void) {
+    int i, n, taken = 0;
+    for (i = 0; i < STREAM_PEERS; i++) {
+        struct Stream_Peer *peer = &streamTransport.peers[i];
+        struct sockaddr_in playerAddr = client_address(STREAM_ADDR, peer->id);
+        if (peer->conn.fd < 0) continue;
+        for (n = count_source_commands(&playerAddr); n < STREAM_BATCH && scheduler.count < PENDING_COMMANDS && stream_peer_ready(peer); n++) {
+            struct Command_Datagram command = {{0}};
+            int length = stream_next(&peer->conn, &command, sizeof(command));
+            if (length < 0) {
+                print_error("queue_stream_commands: Invalid frame length. Client dropped", 0, 0);
+                dropStats.invalid++;
+                drop_stream_peer(i);
+                break;
+            }
+            if (capture.file != NULL) capture_write(&capture, trace_clock(), &playerAddr, &command, length);
+            if (traceEnabled) trace_command_begin(0);
+            if (validate_command(&command, length) > 0) queue_command(&playerAddr, &command);
+            taken++;
+        }
+    }
+    return taken;
+}
+
+/**
+ * @brief Sends the replies queued for each stream client, in one write per client. Clients whose
+ * connection failed are dropped; replies a client is too slow to take stay queued. A client that
+ * has shut down its side is dropped once every command it sent has been answered.
+ */
+void flush_stream_peers(void) {
+    int i;
+    for (i = 0; i < STREAM_PEERS; i++) {
+        struct Stream_Peer *peer = &streamTransport.peers[i];
+        struct sockaddr_in playerAddr = client_address(STREAM_ADDR, peer->id);
+        if (peer->conn.fd >= 0 && peer->conn.outLength > 0 && stream_flush(&peer->conn) < 0) drop_stream_peer(i);
+        if (peer->conn.fd >= 0 && peer->closing && !stream_pending(&peer->conn) && peer->conn.outLength == 0
+                && count_source_commands(&playerAddr) == 0) drop_stream_peer(i);
+    }
+}
+
+/**
+ * @brief Checks whether any stream client has a command that has been read and can be handled.
+ * 
+ * @return True if a command is waiting, false otherwise.
+ */
+int stream_requests_waiting(void) {
+    int i;
+    for (i = 0; i < STREAM_PEERS && streamTransport.numPeers > 0; i++) {
+        if (stream_peer_ready(&streamTransport.peers[i])) return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Queues a reply to a stream client. Replies to clients that have disconnected are
+ * dropped, as a datagram to a player that is gone would be.
+ * 
+ * @param sd Unused.
+ * @param reply The reply datagram.
+ * @param length The size of the reply datagram.
+ * @param playerAddr The address the client is known by.
+ * @return The number of bytes queued, or -1 if the client's output buffer is full (errno is set).
+ */
+ssize_t stream_reply(int sd, const void *reply, size_t length, const struct sockaddr_in *playerAddr) {
+    int i, rv;
+    for (i = 0; i < STREAM_PEERS; i++) {
+        struct Stream_Peer *peer = &streamTransport.peers[i];
+        if (peer->conn.fd >= 0 && peer->id == ntohs(playerAddr->sin_port)) {
+            if ((rv = stream_queue(&peer->conn, reply, length)) < 0) dropStats.sendFailed++;
+            return rv;
+        }
+    }
+    return length;
+}
+
+/**
+ * @brief Empties the scheduler.
+ */
+void init_scheduler(void) {
+    int i;
+    scheduler.count = scheduler.numMoves = scheduler.numSources = 0;
+    scheduler.firstArrival = scheduler.lastArrival = scheduler.firstTurn = scheduler.lastTurn = -1;
+    for (i = 0; i < PENDING_COMMANDS; i++) scheduler.freeCommands[i] = scheduler.freeSources[i] = i;
+    for (i = 0; i < SOURCE_BUCKETS; i++) scheduler.buckets[i] = -1;
+}
+
+/**
+ * @brief Finds the source of waiting commands with an address.
+ * 
+ * @param playerAddr The address of the source.
+ * @param bucket Set to the hash bucket of the address.
+ * @return The scheduler index of the source, or an error code if it has no commands waiting.
+ */
+int find_source(const struct sockaddr_in *playerAddr, int *bucket) {
+    int i;
+    *bucket = ((playerAddr->sin_addr.s_addr * 0x9E3779B1u) ^ playerAddr->sin_port) & (SOURCE_BUCKETS - 1);
+    for (i = scheduler.buckets[*bucket]; i >= 0; i = scheduler.sources[i].nextInBucket) {
+        if (same_address(&scheduler.sources[i].addr, playerAddr)) return i;
+    }
+    return ERROR_CODE;
+}
+
+/**
+ * @brief Queues a validated command in the scheduler, where it waits as an arrival until the
+ * next pick orders it. The command's trace is set aside while it waits. The caller makes sure
+ * the scheduler has room.
+ * 
+ * @param playerAddr The address of the remote player (or transport client).
+ * @param command The command the player sent.
+ */
+void queue_command(const struct sockaddr_in *playerAddr, const struct Command_Datagram *command) {
+    int index = scheduler.freeCommands[scheduler.count], bucket;
+    struct Pending_Command *pending = &scheduler.queue[index];
+    /* Count the command against its source, which it takes its turns with */
+    if ((pending->source = find_source(playerAddr, &bucket)) == ERROR_CODE) {
+        struct Command_Source *source = &scheduler.sources[pending->source = scheduler.freeSources[scheduler.numSources++]];
+        source->addr = *playerAddr;
+        source->count = 0;
+        source->first = source->last = -1;
+        source->nextInBucket = scheduler.buckets[bucket];
+        scheduler.buckets[bucket] = pending->source;
+    }
+    scheduler.sources[pending->source].count++;
+    pending->playerAddr = *playerAddr;
+    pending->command = *command;
+    pending->sequence = scheduler.sequence++;
+    pending->queued = PROBE_ENABLED(dispatch) ? trace_clock() : 0;
+    pending->next = -1;
+    if (scheduler.lastArrival >= 0) {
+        scheduler.queue[scheduler.lastArrival].next = index;
+    } else {
+        scheduler.firstArrival = index;
+    }
+    scheduler.lastArrival = index;
+    scheduler.count++;
+    if (traceEnabled) {
+        trace_stage_begin(STAGE_SCHED);
+        trace_command_suspend(&pending->trace);
+    }
+}
+
+/**
+ * @brief Counts the commands from a source that are waiting in the scheduler.
+ * 
+ * @param playerAddr The address of the source.
+ * @return The number of commands waiting.
+ */
+int count_source_commands(const struct sockaddr_in *playerAddr) {
+    int bucket, index = find_source(playerAddr, &bucket);
+    return (index == ERROR_CODE) ? 0 : scheduler.sources[index].count;
+}
+
+/**
+ * @brief Queues the commands waiting on every transport in the scheduler.
+ * 
+ * @param sd The socket descriptor of the server comminication endpoint.
+ * @param readSocket Whether to read the socket (false if it is known to be empty).
+ * @return The number of commands taken from the transports.
+ */
+int queue_commands(int sd, int readSocket) {
+    int taken = 0;
+    if (readSocket) taken += receive_commands(sd);
+    if (shmTransport.numPeers > 0) taken += queue_shm_commands();
+    if (streamTransport.numPeers > 0) taken += queue_stream_commands();
+    return taken;
+}
+
+/**
+ * @brief Determines the priority of a waiting command. A MOVE is ordered by the deadline of
+ * its game if the game is in the roster (moves for games in cold storage follow them), and
+ * everything else is new work.
+ * 
+ * @param roster The roster of games being played.
+ * @param pending The waiting command.
+ * @param deadline Set to the deadline of the command's game (INT32_MAX if it has none).
+ * @return PRIORITY_MOVE or PRIORITY_ADMIT.
+ */
+int command_priority(struct TTT_Roster *roster, const struct Pending_Command *pending, int32_t *deadline) {
+    const struct Buffer *datagram = &pending->command.header;
+    struct TTT_Game game;
+    struct sockaddr_in p2Address;
+    *deadline = INT32_MAX;
+    if (datagram->command != MOVE) return PRIORITY_ADMIT;
+    game = get_game(roster, datagram->gameNum - 1);
+    p2Address = player_address(&game);
+    if (game.state->player != 0 && same_address(&pending->playerAddr, &p2Address)) *deadline = game.state->deadline;
+    return PRIORITY_MOVE;
+}
+
+/**
+ * @brief Determines whether one waiting move is served before another: earliest game deadline
+ * first, then in arrival order.
+ * 
+ * @param index1 The scheduler index of the first move.
+ * @param index2 The scheduler index of the second move.
+ * @return True if the first move goes first, false otherwise.
+ */
+int earlier_move(int index1, int index2) {
+    const struct Pending_Command *move1 = &scheduler.queue[index1], *move2 = &scheduler.queue[index2];
+    return move1->deadline < move2->deadline || (move1->deadline == move2->deadline && move1->sequence < move2->sequence);
+}
+
+/**
+ * @brief Adds a waiting move to the heap of moves.
+ * 
+ * @param index The scheduler index of the move.
+ */
+void push_move(int index) {
+    int i = scheduler.numMoves++;
+    while (i > 0 && earlier_move(index, scheduler.moves[(i - 1) / 2])) {
+        scheduler.moves[i] = scheduler.moves[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    scheduler.moves[i] = index;
+}
+
+/**
+ * @brief Removes the first move from the heap of moves.
+ */
+void pop_move(void) {
+    int i = 0, child, last = scheduler.moves[--scheduler.numMoves];
+    while ((child = 2 * i + 1) < scheduler.numMoves) {
+        if (child + 1 < scheduler.numMoves && earlier_move(scheduler.moves[child + 1], scheduler.moves[child])) child++;
+        if (!earlier_move(scheduler.moves[child], last)) break;
+        scheduler.moves[i] = scheduler.moves[child];
+        i = child;
+    }
+    scheduler.moves[i] = last;
+}
+
+/**
+ * @brief Orders the commands that arrived since the last pick: each MOVE goes into the heap of
+ * moves by its game's current deadline, and each admission to the back of its source's FIFO
+ * (its source joining the turns if it had no admission waiting).
+ * 
+ * @param roster The roster of games being played.
+ */
+void order_arrivals(struct TTT_Roster *roster) {
+    while (scheduler.firstArrival >= 0) {
+        int index = scheduler.firstArrival;
+        struct Pending_Command *pending = &scheduler.queue[index];
+        struct Command_Source *source = &scheduler.sources[pending->source];
+        scheduler.firstArrival = pending->next;
+        pending->next = -1;
+        if (command_priority(roster, pending, &pending->deadline) == PRIORITY_MOVE) {
+            push_move(index);
+        } else if (source->last >= 0) {
+            scheduler.queue[source->last].next = index;
+            source->last = index;
+        } else {
+            source->first = source->last = index;
+            source->nextTurn = -1;
+            if (scheduler.lastTurn >= 0) {
+                scheduler.sources[scheduler.lastTurn].nextTurn = pending->source;
+            } else {
+                scheduler.firstTurn = pending->source;
+            }
+            scheduler.lastTurn = pending->source;
+        }
+    }
+    scheduler.lastArrival = -1;
+}
+
+/**
+ * @brief Picks the waiting command to serve next, without taking it out of the scheduler: moves
+ * before new work, moves by earliest game deadline, and then each source in turn (commands
+ * from one source in arrival order).
+ * 
+ * @param roster The roster of games being played.
+ * @param priority Set to the priority of the command picked.
+ * @return The scheduler index of the command, or an error code if none are waiting.
+ */
+int next_command(struct TTT_Roster *roster, int *priority) {
+    order_arrivals(roster);
+    if (scheduler.numMoves > 0) {
+        *priority = PRIORITY_MOVE;
+        return scheduler.moves[0];
+    }
+    *priority = PRIORITY_ADMIT;
+    return (scheduler.firstTurn >= 0) ? scheduler.sources[scheduler.firstTurn].first : ERROR_CODE;
+}
+
+/**
+ * @brief Takes the command picked by next_command() out of the scheduler. A source that still
+ * has admissions waiting goes to the back of the turns, and a source with no commands left is
+ * forgotten.
+ * 
+ * @param index The scheduler index of the command.
+ * @param priority The priority of the command.
+ */
+void take_command(int index, int priority) {
+    struct Pending_Command *pending = &scheduler.queue[index];
+    struct Command_Source *source = &scheduler.sources[pending->source];
+    if (priority == PRIORITY_MOVE) {
+        pop_move();
+    } else {
+        scheduler.firstTurn = source->nextTurn;
+        if (scheduler.firstTurn < 0) scheduler.lastTurn = -1;
+        if ((source->first = pending->next) < 0) {
+            source->last = -1;
+        } else {
+            /* Back of the turns */
+            source->nextTurn = -1;
+            if (scheduler.lastTurn >= 0) {
+                scheduler.sources[scheduler.lastTurn].nextTurn = pending->source;
+            } else {
+                scheduler.firstTurn = pending->source;
+            }
+            scheduler.lastTurn = pending->source;
+        }
+    }
+    if (--source->count == 0) {
+        int bucket, *link;
+        find_source(&source->addr, &bucket);
+        for (link = &scheduler.buckets[bucket]; *link != pending->source; link = &scheduler.sources[*link].nextInBucket);
+        *link = source->nextInBucket;
+        scheduler.freeSources[--scheduler.numSources] = pending->source;
+    }
+    scheduler.freeCommands[--scheduler.count] = index;
+}
+
+/**
+ * @brief Dispatches the commands waiting in the scheduler in priority order (up to
+ * PENDING_COMMANDS of them, so the receive loop keeps turning under load). Before new work is
+ * admitted after RECEIVE_REFRESH milliseconds of dispatching, the commands that have arrived in
+ * the meantime are received so their moves go first, and a game only times out once every move
+ * that arrived for it has been served. Moves set aside for batching are searched and
+ * sent at the end of the pass.
+ * 
+ * @param sd The socket descriptor of the server comminication endpoint.
+ * @param roster The roster of games being played.
+ * @return The number of commands dispatched.
+ */
+int run_scheduler(int sd, struct TTT_Roster *roster) {
+    int index, priority, handled = 0;
+    uint64_t received = trace_clock();
+    while (handled < PENDING_COMMANDS && (index = next_command(roster, &priority)) != ERROR_CODE) {
+        struct Pending_Command pending;
+        if (priority == PRIORITY_ADMIT && trace_clock() - received >= RECEIVE_REFRESH * 1000000ULL) {
+            received = trace_clock();
+            if (queue_commands(sd, 1) > 0) continue;
+            /* No moves are waiting, so reset the games that have run out of time */
+            check_timeout(roster);
+        }
+        /* Take the command out of the scheduler */
+        pending = scheduler.queue[index];
+        take_command(index, priority);
+        if (traceEnabled) {
+            trace_command_resume(&pending.trace);
+            trace_stage_end(STAGE_SCHED);
+        }
+        dispatch_command(sd, roster, &pending.playerAddr, &pending.command.header, (pending.queued != 0) ? trace_clock() - pending.queued : 0);
+        handled++;
+    }
+    /* Search and send the moves set aside during the pass */
+    if (moveBatch.count > 0) search_move_batch(sd, roster);
+    /* Reset any game that has timed out */
+    check_timeout(roster);
+    return handled;
+}
+
+/**
+ * @brief Starts accepting admin clients on a Unix socket only the server's user can connect to.
+ * If the socket cannot be created, the function terminates the process.
+ * 
+ * @param path The path of the Unix socket.
+ */
+void start_admin_control(const char *path) {
+    int i;
+    mode_t mask;
+    for (i = 0; i < ADMIN_PEERS; i++) adminControl.peers[i].fd = -1;
+    /* Create the socket file without group or other permissions (it can free games) */
+    mask = umask(S_IRWXG | S_IRWXO);
+    adminControl.listenFd = stream_listen(path);
+    umask(mask);
+    if (adminControl.listenFd < 0) handle_init_error("-A: Unable to create admin socket", errno);
+}
+
+/**
+ * @brief Accepts an admin client and gives it a free peer slot. The client is refused if every
+ * slot is taken.
+ */
+void accept_admin_peer(void) {
+    int i, fd;
+    if ((fd = accept4(adminControl.listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) print_error("accept_admin_peer", errno, 0);
+        return;
+    }
+    for (i = 0; i < ADMIN_PEERS && adminControl.peers[i].fd >= 0; i++);
+    if (i == ADMIN_PEERS) {
+        print_error("accept_admin_peer: Too many admin clients. Client refused", 0, 0);
+        close(fd);
+        return;
+    }
+    adminControl.peers[i].fd = fd;
+    adminControl.peers[i].length = 0;
+    adminControl.peers[i].outLength = 0;
+    adminControl.peers[i].listing = -1;
+    adminControl.peers[i].closing = 0;
+    printf("[+]Admin client connected.\n");
+}
+
+/**
+ * @brief Disconnects an admin client. Changes it asked for are still applied.
+ * 
+ * @param index The peer slot of the client.
+ */
+void drop_admin_peer(int index) {
+    printf("[+]Admin client disconnected.\n");
+    close(adminControl.peers[index].fd);
+    adminControl.peers[index].fd = -1;
+}
+
+/**
+ * @brief Sets the descriptors the receive loop waits on for admin control: the admin socket,
+ * then each client's connection.
+ * 
+ * @param events The descriptors the receive loop waits on.
+ */
+void watch_admin_peers(struct pollfd *events) {
+    int i, on = (adminControl.listenFd >= 0);
+    events[ADMIN_EVENT].fd = adminControl.listenFd;
+    events[ADMIN_EVENT].events = POLLIN;
+    for (i = 0; i < ADMIN_PEERS; i++) {
+        events[ADMIN_EVENT + 1 + i].fd = on ? adminControl.peers[i].fd : -1;
+        events[ADMIN_EVENT + 1 + i].events = admin_peer_events(&adminControl.peers[i]);
+    }
+}
+
+/**
+ * @brief Chooses what to wait for on an admin client's connection: room to send while replies
+ * are queued or a list is in progress, and more commands only while there is room to run them. A client that stops
+ * reading its replies is thus left waiting without holding up the receive loop.
+ * 
+ * @param peer The admin client.
+ * @return The poll() events to wait for.
+ */
+short admin_peer_events(const struct Admin_Peer *peer) {
+    short events = (peer->outLength > 0 || peer->listing >= 0) ? POLLOUT : 0;
+    if (!peer->closing && peer->listing < 0 && peer->length < ADMIN_LINE && ADMIN_OUTPUT - peer->outLength >= ADMIN_RESERVE) events |= POLLIN;
+    return events;
+}
+
+/**
+ * @brief Handles the admin descriptors that are ready: accepts new clients, sends queued
+ * replies, runs every complete command line the connected ones have sent and drops those that
+ * hung up (once their replies are out). Changes are only staged here; apply_admin_changes() puts them in force together
+ * before the next command is handled.
+ * 
+ * @param events The descriptors the receive loop waited on.
+ * @param roster The roster of games being played.
+ */
+void handle_admin_events(struct pollfd *events, struct TTT_Roster *roster) {
+    int i, n, changed = 0;
+    if (events[ADMIN_EVENT].revents & POLLIN) {
+        accept_admin_peer();
+        changed = 1;
+    }
+    for (i = 0; i < ADMIN_PEERS; i++) {
+        struct Admin_Peer *peer = &adminControl.peers[i];
+        struct pollfd *event = &events[ADMIN_EVENT + 1 + i];
+        if (peer->fd < 0 || event->fd != peer->fd || event->revents == 0) continue;
+        /* Make room by sending queued replies, then read what the client has sent (nothing if it hung up) */
+        if ((event->revents & POLLOUT) && flush_admin_peer(peer) < 0) {
+            drop_admin_peer(i);
+            changed = 1;
+            continue;
+        }
+        if ((event->revents & (POLLIN | POLLHUP | POLLERR)) && !peer->closing && peer->length < ADMIN_LINE) {
+            if ((n = read(peer->fd, peer->input + peer->length, ADMIN_LINE - peer->length)) > 0) {
+                peer->length += n;
+            } else if (n == 0) {
+                peer->closing = 1;  // dropped once the replies to what it sent are out
+            } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                drop_admin_peer(i);
+                changed = 1;
+                continue;
+            }
+        }
+        if (serve_admin_peer(peer, roster) == ERROR_CODE || flush_admin_peer(peer) < 0 || (peer->closing && peer->outLength == 0)) {
+            drop_admin_peer(i);
+            changed = 1;
+            continue;
+        }
+        event->events = admin_peer_events(peer);
+    }
+    if (changed) watch_admin_peers(events);
+}
+
+/**
+ * @brief Runs the complete command lines an admin client has sent, in order, as long as its
+ * output buffer has room for their replies (a list in progress is finished first). The rest
+ * wait until the client has read more of its replies.
+ * 
+ * @param peer The admin client.
+ * @param roster The roster of games being played.
+ * @return 0 on success, or an error code if the client is to be dropped.
+ */
+int serve_admin_peer(struct Admin_Peer *peer, struct TTT_Roster *roster) {
+    char *line = peer->input, *end;
+    int failed = 0;
+    if (peer->listing >= 0) list_games(peer, roster);
+    while (!failed && peer->listing < 0 && ADMIN_OUTPUT - peer->outLength >= ADMIN_RESERVE &&
+        (end = memchr(line, '\n', peer->input + peer->length - line)) != NULL) {
+        *end = '\0';
+        failed = (run_admin_command(peer, line, roster) == ERROR_CODE);
+        line = end + 1;
+    }
+    /* Keep what is left (a partial line, or lines waiting for room) for later */
+    peer->length -= line - peer->input;
+    memmove(peer->input, line, peer->length);
+    if (!failed && peer->length == ADMIN_LINE && memchr(peer->input, '\n', ADMIN_LINE) == NULL) {
+        admin_reply(peer, "error: command too long\n");
+        flush_admin_peer(peer);
+        failed = 1;
+    }
+    return failed ? ERROR_CODE : 0;
+}
+
+/**
+ * @brief Sends as much of an admin client's queued replies as its connection takes without
+ * blocking.
+ * 
+ * @param peer The admin client.
+ * @return The number of bytes still queued, or -1 if the connection failed (errno is set).
+ */
+int flush_admin_peer(struct Admin_Peer *peer) {
+    ssize_t rv;
+    if (peer->outLength == 0) return 0;
+    if ((rv = send(peer->fd, peer->output, peer->outLength, MSG_NOSIGNAL)) < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? peer->outLength : -1;
+    }
+    peer->outLength -= rv;
+    memmove(peer->output, peer->output + rv, peer->outLength);
+    return peer->outLength;
+}
+
+/**
+ * @brief Queues a line of a reply to an admin client. The line is queued whole or not at all.
+ * 
+ * @param peer The admin client.
+ * @param format The printf() format of the line.
+ * @return 0 if the line was queued, or an error code if the output buffer has no room for it.
+ */
+int admin_reply(struct Admin_Peer *peer, const char *format, ...) {
+    char text[ADMIN_REPLY];
+    int length;
+    va_list args;
+    va_start(args, format);
+    length = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    if (length >= (int)sizeof(text)) length = sizeof(text) - 1;
+    if (length > ADMIN_OUTPUT - peer->outLength) return ERROR_CODE;
+    memcpy(peer->output + peer->outLength, text, length);
+    peer->outLength += length;
+    return 0;
+}
+
+/**
+ * @brief Runs an admin command line. Every reply ends with a line holding "ok" or "error: "
+ * and the reason. The commands are:
+ * - stats: the roster occupancy, limits and drop counts (one "<name> <value>" per line)
+ * - list: every game in the roster and in cold storage
+ * - free <game>: frees a game in the roster
+ * - set timeout|cold-timeout|capacity <value>: changes a limit
+ * 
+ * @param peer The admin client.
+ * @param line The command line (without its newline).
+ * @param roster The roster of games being played.
+ * @return 0 if the reply was queued (a list is queued as the client reads it), or an error code
+ * if the client is not taking replies.
+ */
+int run_admin_command(struct Admin_Peer *peer, char *line, struct TTT_Roster *roster) {
+    char word[ADMIN_LINE], setting[ADMIN_LINE], extra;
+    int value;
+    /* Ignore a carriage return ending the line, and blank lines */
+    line[strcspn(line, "\r")] = '\0';
+    if (sscanf(line, "%s", word) != 1) return 0;
+    if (strcmp(word, "stats") == 0 && sscanf(line, "%*s %c", &extra) != 1) {
+        if (report_status(peer, roster) == ERROR_CODE) return ERROR_CODE;
+    } else if (strcmp(word, "list") == 0 && sscanf(line, "%*s %c", &extra) != 1) {
+        peer->listing = 0;
+        list_games(peer, roster);
+        return 0;
+    } else if (strcmp(word, "free") == 0 && sscanf(line, "%*s %d %c", &value, &extra) == 1) {
+        if (value < 1 || value > maxGames || roster->state[value - 1].player == 0) {
+            return admin_reply(peer, "error: game %d is not being played\n", value);
+        }
+        if (!adminControl.changed) adminControl.staged = limits;
+        adminControl.freeing[value - 1] = 1;
+        adminControl.changed = 1;
+    } else if (strcmp(word, "set") == 0 && sscanf(line, "%*s %s %d %c", setting, &value, &extra) == 2) {
+        struct Server_Limits staged = adminControl.changed ? adminControl.staged : limits;
+        if (strcmp(setting, "timeout") == 0 && value >= 1 && value <= MAX_TIMEOUT) {
+            staged.timeout = value;
+        } else if (strcmp(setting, "cold-timeout") == 0 && value >= 1 && value <= MAX_COLD_TIMEOUT) {
+            staged.coldTimeout = value;
+        } else if (strcmp(setting, "capacity") == 0 && value >= 1 && value <= maxGames) {
+            staged.capacity = value;
+        } else {
+            return admin_reply(peer, "error: invalid setting (timeout 1-%d, cold-timeout 1-%d, capacity 1-%d)\n",
+                MAX_TIMEOUT, MAX_COLD_TIMEOUT, maxGames);
+        }
+        adminControl.staged = staged;
+        adminControl.changed = 1;
+    } else {
+        return admin_reply(peer, "error: unknown command (stats, list, free <game>, set timeout|cold-timeout|capacity <value>)\n");
+    }
+    return admin_reply(peer, "ok\n");
+}
+
+/**
+ * @brief Sends an admin client the roster occupancy, the limits in force and the drop counts
+ * so far, one "<name> <value>" per line.
+ * 
+ * @param peer The admin client.
+ * @param roster The roster of games being played.
+ * @return 0 if the report was queued, or an error code if the client is not taking replies.
+ */
+int report_status(struct Admin_Peer *peer, const struct TTT_Roster *roster) {
+    int i, waiting = 0, computing = 0, open = 0, beyond = 0, cold = 0;
+    for (i = 0; i < maxGames; i++) {
+        if (roster->state[i].player == 2) waiting++;
+        else if (roster->state[i].player == 1) computing++;
+        else if (i < limits.capacity) open++;
+        if (roster->state[i].player != 0 && i >= limits.capacity) beyond++;
+    }
+    for (i = 0; i < COLD_GAMES; i++) {
+        if (roster->cold[i].packed != 0) cold++;
+    }
+    if (admin_reply(peer, "capacity %d\nmax-games %d\ntimeout %d\ncold-timeout %d\n", limits.capacity, maxGames, limits.timeout, limits.coldTimeout) == ERROR_CODE ||
+        admin_reply(peer, "games-in-progress %d\ngames-waiting %d\ngames-computing %d\ngames-open %d\ngames-beyond-capacity %d\ngames-cold %d\n",
+        waiting + computing, waiting, computing, open, beyond, cold) == ERROR_CODE ||
+        admin_reply(peer, "commands-waiting %d\nshm-clients %d\nstream-clients %d\n", scheduler.count, shmTransport.numPeers, streamTransport.numPeers) == ERROR_CODE ||
+        admin_reply(peer, "datagrams-received %llu\ndatagrams-invalid %llu\ncommands-rejected %llu\nreplies-not-sent %llu\ngames-timed-out %llu\nkernel-drops %u\n",
+        (unsigned long long)dropStats.received, (unsigned long long)dropStats.invalid, (unsigned long long)dropStats.rejected,
+        (unsigned long long)dropStats.sendFailed, (unsigned long long)dropStats.timedOut, dropStats.kernel) == ERROR_CODE) {
+        return ERROR_CODE;
+    }
+    return admin_reply(peer, "commands-repeated %llu\n", (unsigned long long)dropStats.repeated);
+}
+
+/**
+ * @brief Sends an admin client a line for every game in the roster (whose turn it is and the
+ * seconds left until it times out) and in cold storage (the seconds left until it expires),
+ * then "ok". The list goes out as the client reads it: when the output buffer fills, it stops
+ * and resumes from the next game (peer->listing) once there is room again, so games that
+ * change in between are listed as they are by then.
+ * 
+ * @param peer The admin client.
+ * @param roster The roster of games being played.
+ */
+void list_games(struct Admin_Peer *peer, struct TTT_Roster *roster) {
+    int32_t now = server_clock();
+    char player[ADMIN_LINE];
+    for (; peer->listing < maxGames; peer->listing++) {
+        struct TTT_Game game = get_game(roster, peer->listing);
+        if (game.state->player == 0) continue;
+        describe_player(player, sizeof(player), game.info->p2Addr, game.info->p2Port);
+        if (admin_reply(peer, "game %d variant %s turn %s player %s expires %d\n", game.gameNum, get_variant(&game)->name,
+            (game.state->player == 2) ? "player" : "server", player, game.state->deadline - now) == ERROR_CODE) return;
+    }
+    for (; peer->listing < maxGames + COLD_GAMES; peer->listing++) {
+        const struct Cold_Game *cold = &roster->cold[peer->listing - maxGames];
+        if (cold->packed == 0) continue;
+        describe_player(player, sizeof(player), cold->p2Addr, cold->p2Port);
+        if (admin_reply(peer, "cold %d variant %s player %s expires %d\n", cold_game_number(cold->packed),
+            ttt_get_variant((cold->packed >> 40) & 3)->name, player, (int16_t)(cold->expires - (uint16_t)now)) == ERROR_CODE) return;
+    }
+    if (admin_reply(peer, "ok\n") == 0) peer->listing = -1;
+}
+
+/**
+ * @brief Describes the remote player of a game by its transport and address.
+ * 
+ * @param text The buffer to write the description to.
+ * @param size The size of the buffer.
+ * @param addr The IP address of the remote player (SHM_ADDR or STREAM_ADDR for a transport client).
+ * @param port The port number (or transport client id) of the remote player.
+ */
+void describe_player(char *text, size_t size, in_addr_t addr, in_port_t port) {
+    struct in_addr ip = {addr};
+    if (addr == SHM_ADDR) {
+        snprintf(text, size, "shm:%d", ntohs(port));
+    } else if (addr == STREAM_ADDR) {
+        snprintf(text, size, "stream:%d", ntohs(port));
+    } else {
+        snprintf(text, size, "%s:%d", inet_ntoa(ip), ntohs(port));
+    }
+}
+
+/**
+ * @brief Applies every change staged by admin clients at once. Games are freed first, then the
+ * new limits are put in force: the deadlines of games already running move with a new timeout
+ * (so a shorter one takes effect at once), and games beyond a lowered capacity are played to
+ * the end while no new game is started in their slots.
+ * 
+ * @param roster The roster of games being played.
+ */
+void apply_admin_changes(struct TTT_Roster *roster) {
+    int i;
+    int32_t timeoutShift = adminControl.staged.timeout - limits.timeout;
+    int32_t coldShift = adminControl.staged.coldTimeout - limits.coldTimeout;
+    /* Free the games asked for */
+    for (i = 0; i < maxGames; i++) {
+        struct TTT_Game game = get_game(roster, i);
+        if (!adminControl.freeing[i]) continue;
+        adminControl.freeing[i] = 0;
+        if (game.state->player == 0) continue;  // already ended
+        printf("[+]Game #%d freed by an admin.\n", game.gameNum);
+        free_game(&game);
+    }
+    /* Move the deadlines of the running and evicted games with their timeouts */
+    if (timeoutShift != 0) {
+        for (i = 0; i < maxGames; i++) {
+            if (roster->state[i].player != 0) roster->state[i].deadline += timeoutShift;
+        }
+        printf("[+]Game timeout set to %d s by an admin.\n", adminControl.staged.timeout);
+    }
+    if (coldShift != 0) {
+        for (i = 0; i < COLD_GAMES; i++) {
+            if (roster->cold[i].packed != 0) roster->cold[i].expires += coldShift;
+        }
+        printf("[+]Cold storage timeout set to %d s by an admin.\n", adminControl.staged.coldTimeout);
+    }
+    if (adminControl.staged.capacity != limits.capacity) {
+        printf("[+]Capacity set to %d games by an admin.\n", adminControl.staged.capacity);
     }
+    limits = adminControl.staged;
+    adminControl.changed = 0;
+    /* Time out the games a shorter timeout has left past their deadline */
+    check_timeout(roster);
 }
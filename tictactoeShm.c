@@ -0,0 +1,399 @@
+/***********************************************************/
+/* Shared-memory transport for clients on the same host as */
+/* the TicTacToe server. Each client shares a pair of      */
+/* single-producer/single-consumer rings with the server   */
+/* and the two sides wake each other with eventfds.        */
+/***********************************************************/
+
+/* Needed for memfd_create() and accept4() */
+#define _GNU_SOURCE
+
+/* #include files go here */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+#include "tictactoeShm.h"
+
+/* The number of descriptors passed at registration (channel, request and reply eventfds). */
+#define SHM_FDS 3
+
+/**
+ * @brief Reads the monotonic clock.
+ *
+ * @return The current time in nanoseconds.
+ */
+static uint64_t shm_clock(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/**
+ * @brief Decides whether a receiver should spin on an empty ring. Spinning only pays off when
+ * the other side can run on another CPU at the same time.
+ *
+ * @return The number of nanoseconds to spin (0 on a single CPU).
+ */
+static uint64_t shm_spin_time(void) {
+    static long numCpus;
+    if (numCpus == 0) numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return (numCpus > 1) ? SHM_SPIN_NS : 0;
+}
+
+/**
+ * @brief Fills in the address of a Unix socket path.
+ *
+ * @param addr The address to fill in.
+ * @param path The socket path.
+ * @return Zero on success, -1 if the path is too long (errno is set).
+ */
+static int shm_address(struct sockaddr_un *addr, const char *path) {
+    memset(addr, 0, sizeof(struct sockaddr_un));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+/**
+ * @brief Creates the Unix socket clients register their shared channels on. An existing
+ * socket file at the path is replaced.
+ *
+ * @param path The socket path.
+ * @return The listening socket, or -1 if it could not be created (errno is set).
+ */
+int shm_listen(const char *path) {
+    int fd;
+    struct sockaddr_un addr;
+    if (shm_address(&addr, path) < 0) return -1;
+    if ((fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0)) < 0) return -1;
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Accepts a client's connection without waiting for its registration, which the
+ * caller finishes with shm_register() once the connection is readable.
+ *
+ * @param listenFd The listening socket.
+ * @param endpoint Set to the server side of the connection (with no channel yet).
+ * @return Zero on success, -1 if no connection could be accepted (errno is set).
+ */
+int shm_accept(int listenFd, struct Shm_Endpoint *endpoint) {
+    memset(endpoint, 0, sizeof(struct Shm_Endpoint));
+    endpoint->requestEvent = endpoint->replyEvent = -1;
+    if ((endpoint->conn = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) < 0) return -1;
+    return 0;
+}
+
+/**
+ * @brief Receives a client's registration and maps its shared channel, without blocking. The
+ * caller must answer the registration with shm_answer(). An invalid registration closes the
+ * connection.
+ *
+ * @param endpoint The server side of a connection accepted by shm_accept().
+ * @return Zero on success, -1 if the registration has not arrived yet (errno is EAGAIN) or was
+ * invalid (errno is EPROTO).
+ */
+int shm_register(struct Shm_Endpoint *endpoint) {
+    char byte, control[CMSG_SPACE(SHM_FDS * sizeof(int))];
+    int fds[SHM_FDS] = {-1, -1, -1}, i, seals;
+    struct iovec iov = {&byte, 1};
+    struct msghdr msg = {0};
+    struct cmsghdr *cmsg;
+    struct stat info;
+    void *channel = MAP_FAILED;
+    ssize_t received;
+
+    /* Receive the channel and eventfds */
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    received = recvmsg(endpoint->conn, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+    if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return -1;
+    if (received == 1 && (cmsg = CMSG_FIRSTHDR(&msg)) != NULL
+            && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS
+            && cmsg->cmsg_len == CMSG_LEN(SHM_FDS * sizeof(int))) {
+        memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+    }
+    /* Map the channel if it cannot shrink under the server, and check a matching client set it up */
+    if (fds[0] >= 0 && fstat(fds[0], &info) == 0 && info.st_size == sizeof(struct Shm_Channel)
+            && (seals = fcntl(fds[0], F_GET_SEALS)) >= 0 && (seals & F_SEAL_SHRINK)) {
+        channel = mmap(NULL, sizeof(struct Shm_Channel), PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+    }
+    if (channel == MAP_FAILED || ((struct Shm_Channel *)channel)->magic != SHM_MAGIC
+            || ((struct Shm_Channel *)channel)->size != sizeof(struct Shm_Channel)) {
+        if (channel != MAP_FAILED) munmap(channel, sizeof(struct Shm_Channel));
+        for (i = 0; i < SHM_FDS; i++) if (fds[i] >= 0) close(fds[i]);
+        close(endpoint->conn);
+        endpoint->conn = -1;
+        errno = EPROTO;
+        return -1;
+    }
+    close(fds[0]);
+    endpoint->channel = channel;
+    endpoint->requestEvent = fds[1];
+    endpoint->replyEvent = fds[2];
+    return 0;
+}
+
+/**
+ * @brief Tells a client whether its registration was accepted. A rejected endpoint must
+ * still be closed with shm_close().
+ *
+ * @param endpoint The server side of the connection.
+ * @param accepted Whether or not the server will serve the client.
+ */
+void shm_answer(struct Shm_Endpoint *endpoint, int accepted) {
+    char byte = accepted ? 1 : 0;
+    if (send(endpoint->conn, &byte, 1, MSG_NOSIGNAL) < 0) {
+        /* The client has gone; the server notices when the socket hangs up */
+    }
+}
+
+/**
+ * @brief Creates a shared channel and registers it with the server.
+ *
+ * @param path The server's registration socket path.
+ * @param endpoint Set to the client side of the connection.
+ * @return Zero on success, -1 if the server could not be reached or refused the client
+ * (errno is set).
+ */
+int shm_connect(const char *path, struct Shm_Endpoint *endpoint) {
+    int fds[SHM_FDS] = {-1, -1, -1}, err;
+    char byte = 0, control[CMSG_SPACE(SHM_FDS * sizeof(int))] = {0};
+    struct iovec iov = {&byte, 1};
+    struct msghdr msg = {0};
+    struct cmsghdr *cmsg;
+    struct sockaddr_un addr;
+
+    memset(endpoint, 0, sizeof(struct Shm_Endpoint));
+    endpoint->conn = endpoint->requestEvent = endpoint->replyEvent = -1;
+    if (shm_address(&addr, path) < 0) return -1;
+    /* Create the shared channel and the eventfds */
+    if ((fds[0] = memfd_create("tictactoe-shm", MFD_CLOEXEC | MFD_ALLOW_SEALING)) < 0) goto fail;
+    if (ftruncate(fds[0], sizeof(struct Shm_Channel)) < 0) goto fail;
+    if (fcntl(fds[0], F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) goto fail;
+    endpoint->channel = mmap(NULL, sizeof(struct Shm_Channel), PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+    if (endpoint->channel == MAP_FAILED) {
+        endpoint->channel = NULL;
+        goto fail;
+    }
+    endpoint->channel->magic = SHM_MAGIC;
+    endpoint->channel->size = sizeof(struct Shm_Channel);
+    if ((endpoint->requestEvent = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) goto fail;
+    if ((endpoint->replyEvent = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) goto fail;
+    fds[1] = endpoint->requestEvent;
+    fds[2] = endpoint->replyEvent;
+    /* Pass them to the server and wait for its answer */
+    if ((endpoint->conn = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0)) < 0) goto fail;
+    if (connect(endpoint->conn, (struct sockaddr *)&addr, sizeof(addr)) < 0) goto fail;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    if (sendmsg(endpoint->conn, &msg, MSG_NOSIGNAL) != 1) goto fail;
+    if (recv(endpoint->conn, &byte, 1, 0) != 1 || !byte) {
+        errno = ECONNREFUSED;
+        goto fail;
+    }
+    close(fds[0]);
+    return 0;
+
+fail:
+    err = errno;
+    if (fds[0] >= 0) close(fds[0]);
+    shm_close(endpoint);
+    errno = err;
+    return -1;
+}
+
+/**
+ * @brief Disconnects one side of a shared-memory connection and frees its resources.
+ *
+ * @param endpoint The endpoint to close.
+ */
+void shm_close(struct Shm_Endpoint *endpoint) {
+    if (endpoint->channel != NULL) munmap(endpoint->channel, sizeof(struct Shm_Channel));
+    if (endpoint->conn >= 0) close(endpoint->conn);
+    if (endpoint->requestEvent >= 0) close(endpoint->requestEvent);
+    if (endpoint->replyEvent >= 0) close(endpoint->replyEvent);
+    endpoint->channel = NULL;
+    endpoint->conn = endpoint->requestEvent = endpoint->replyEvent = -1;
+}
+
+/**
+ * @brief Appends a message to a ring, waking the consumer only if it is asleep. Must only be
+ * called by the ring's producer.
+ *
+ * @param ring The ring to write to.
+ * @param wakeFd The eventfd the consumer sleeps on.
+ * @param data The message.
+ * @param length The size of the message [1-SHM_MESSAGE_SIZE].
+ * @return The size of the message, or -1 if the ring is full (errno is EAGAIN) or the
+ * message is too big (errno is EMSGSIZE).
+ */
+int shm_push(struct Shm_Ring *ring, int wakeFd, const void *data, int length) {
+    const uint64_t one = 1;
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    struct Shm_Slot *slot = &ring->slots[head & (SHM_RING_SLOTS - 1)];
+    if (length < 1 || length > SHM_MESSAGE_SIZE) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    if (head - atomic_load_explicit(&ring->tail, memory_order_acquire) >= SHM_RING_SLOTS) {
+        errno = EAGAIN;
+        return -1;
+    }
+    slot->length = length;
+    memcpy(slot->data, data, length);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    /* Publish the message before checking whether the consumer went to sleep (pairs with shm_arm) */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&ring->sleeping, memory_order_relaxed) && atomic_exchange(&ring->sleeping, 0)) {
+        if (write(wakeFd, &one, sizeof(one)) < 0) {
+            /* The counter is already nonzero (EAGAIN), so the consumer is awake anyway */
+        }
+    }
+    return length;
+}
+
+/**
+ * @brief Takes the oldest message off a ring. Must only be called by the ring's consumer.
+ *
+ * @param ring The ring to read from.
+ * @param data The buffer the message is copied to (truncated to its size).
+ * @param size The size of the buffer.
+ * @return The number of bytes copied, or 0 if the ring is empty.
+ */
+int shm_pop(struct Shm_Ring *ring, void *data, int size) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed), length;
+    struct Shm_Slot *slot = &ring->slots[tail & (SHM_RING_SLOTS - 1)];
+    if (atomic_load_explicit(&ring->head, memory_order_acquire) == tail) return 0;
+    /* The peer writes the slot, so never trust its length */
+    length = slot->length;
+    if (length > SHM_MESSAGE_SIZE) length = SHM_MESSAGE_SIZE;
+    if (length > (uint32_t)size) length = size;
+    memcpy(data, slot->data, length);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return length;
+}
+
+/**
+ * @brief Checks whether a ring has messages waiting. Must only be called by the consumer.
+ *
+ * @param ring The ring to check.
+ * @return True if a message is waiting, false otherwise.
+ */
+int shm_pending(struct Shm_Ring *ring) {
+    return atomic_load_explicit(&ring->head, memory_order_acquire) != atomic_load_explicit(&ring->tail, memory_order_relaxed);
+}
+
+/**
+ * @brief Asks the producer of a ring to wake the consumer on its next message. Call before
+ * sleeping on the ring's eventfd, and call shm_disarm() after waking.
+ *
+ * @param ring The ring the consumer is about to sleep on.
+ * @return True if the consumer may sleep, false if a message arrived in the meantime.
+ */
+int shm_arm(struct Shm_Ring *ring) {
+    atomic_store_explicit(&ring->sleeping, 1, memory_order_relaxed);
+    /* Publish the flag before checking for messages (pairs with shm_push) */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (shm_pending(ring)) {
+        atomic_store_explicit(&ring->sleeping, 0, memory_order_relaxed);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Stops the producer of a ring from waking the consumer and clears any wakeup.
+ *
+ * @param ring The ring the consumer slept on.
+ * @param wakeFd The eventfd the consumer slept on.
+ */
+void shm_disarm(struct Shm_Ring *ring, int wakeFd) {
+    uint64_t count;
+    atomic_store_explicit(&ring->sleeping, 0, memory_order_relaxed);
+    if (read(wakeFd, &count, sizeof(count)) < 0) {
+        /* Nothing to clear (EAGAIN) */
+    }
+}
+
+/**
+ * @brief Sends a command to the server.
+ *
+ * @param endpoint The client side of the connection.
+ * @param data The command (same layout as the datagram).
+ * @param length The size of the command.
+ * @return The size of the command, or -1 if it could not be queued (errno is set).
+ */
+int shm_send(struct Shm_Endpoint *endpoint, const void *data, int length) {
+    return shm_push(&endpoint->channel->requests, endpoint->requestEvent, data, length);
+}
+
+/**
+ * @brief Receives a reply from the server. Spins on the ring for SHM_SPIN_NS nanoseconds
+ * before sleeping (on machines with more than one CPU), so replies that come back quickly
+ * never pay for a wakeup.
+ *
+ * @param endpoint The client side of the connection.
+ * @param data The buffer the reply is copied to.
+ * @param size The size of the buffer.
+ * @param timeout The number of milliseconds to wait (-1 to wait forever).
+ * @return The size of the reply, 0 if none arrived in time, or -1 if the server hung up
+ * (errno is set).
+ */
+int shm_receive(struct Shm_Endpoint *endpoint, void *data, int size, int timeout) {
+    struct Shm_Ring *ring = &endpoint->channel->replies;
+    uint64_t now = shm_clock(), spinEnd = now + shm_spin_time(), deadline = now + timeout * 1000000ULL;
+    int length;
+    /* Spin while the reply is likely to be on its way */
+    do {
+        if ((length = shm_pop(ring, data, size)) > 0) return length;
+    } while (shm_clock() < spinEnd);
+    /* Sleep until the server wakes us, hangs up or the time runs out */
+    while (1) {
+        struct pollfd events[2] = {{endpoint->replyEvent, POLLIN, 0}, {endpoint->conn, POLLIN, 0}};
+        int wait = -1, rv = 1;
+        if (timeout >= 0) {
+            if ((now = shm_clock()) >= deadline) return shm_pop(ring, data, size);
+            wait = (deadline - now + 999999) / 1000000;
+        }
+        if (shm_arm(ring)) {
+            rv = poll(events, 2, wait);
+            shm_disarm(ring, endpoint->replyEvent);
+        }
+        if ((length = shm_pop(ring, data, size)) > 0) return length;
+        if (rv < 0 && errno != EINTR) return -1;
+        if (rv > 0 && events[1].revents) {
+            errno = ECONNRESET;
+            return -1;
+        }
+    }
+}
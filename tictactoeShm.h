@@ -0,0 +1,71 @@
+/***********************************************************/
+/* Shared-memory transport for clients on the same host as */
+/* the TicTacToe server. Each client shares a pair of      */
+/* single-producer/single-consumer rings with the server   */
+/* and the two sides wake each other with eventfds.        */
+/***********************************************************/
+
+#ifndef TICTACTOE_SHM_H
+#define TICTACTOE_SHM_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+/* The value every shared channel starts with (checked by the server at registration). */
+#define SHM_MAGIC 0x54545431
+/* The number of messages each ring holds (a power of two). */
+#define SHM_RING_SLOTS 256
+/* The maximum size of a message (the largest command or reply). */
+#define SHM_MESSAGE_SIZE 12
+/* The number of nanoseconds a receiver spins on an empty ring before it sleeps. */
+#define SHM_SPIN_NS 50000
+/* The size of a cache line, which the producer and consumer indexes are kept apart by. */
+#define SHM_CACHE_LINE 64
+/* The number of milliseconds the server waits for a registration after accepting it. */
+#define SHM_REGISTER_TIMEOUT 100
+
+/* Structure for a message in a ring. */
+struct Shm_Slot {
+    uint32_t length;                // number of bytes in the message
+    char data[SHM_MESSAGE_SIZE];    // the message (same layout as a datagram)
+};
+
+/* Structure for a single-producer/single-consumer ring of messages. */
+struct Shm_Ring {
+    _Atomic uint32_t head __attribute__((aligned(SHM_CACHE_LINE)));  // next slot written (producer)
+    _Atomic uint32_t tail __attribute__((aligned(SHM_CACHE_LINE)));  // next slot read (consumer)
+    atomic_int sleeping;            // set while the consumer waits on its eventfd
+    struct Shm_Slot slots[SHM_RING_SLOTS] __attribute__((aligned(SHM_CACHE_LINE)));
+};
+
+/* Structure for the memory shared by a client and the server. */
+struct Shm_Channel {
+    uint32_t magic;                 // SHM_MAGIC
+    uint32_t size;                  // sizeof(struct Shm_Channel), to catch mismatched builds
+    struct Shm_Ring requests;       // commands from the client to the server
+    struct Shm_Ring replies;        // replies from the server to the client
+};
+
+/* Structure for one side of a shared-memory connection. */
+struct Shm_Endpoint {
+    int conn;                       // registration socket (closed by either side to disconnect)
+    int requestEvent;               // eventfd that wakes the server
+    int replyEvent;                 // eventfd that wakes the client
+    struct Shm_Channel *channel;    // shared rings (NULL until the client has registered)
+};
+
+int shm_listen(const char *path);
+int shm_accept(int listenFd, struct Shm_Endpoint *endpoint);
+int shm_register(struct Shm_Endpoint *endpoint);
+void shm_answer(struct Shm_Endpoint *endpoint, int accepted);
+int shm_connect(const char *path, struct Shm_Endpoint *endpoint);
+void shm_close(struct Shm_Endpoint *endpoint);
+int shm_push(struct Shm_Ring *ring, int wakeFd, const void *data, int length);
+int shm_pop(struct Shm_Ring *ring, void *data, int size);
+int shm_pending(struct Shm_Ring *ring);
+int shm_arm(struct Shm_Ring *ring);
+void shm_disarm(struct Shm_Ring *ring, int wakeFd);
+int shm_send(struct Shm_Endpoint *endpoint, const void *data, int length);
+int shm_receive(struct Shm_Endpoint *endpoint, void *data, int size, int timeout);
+
+#endif
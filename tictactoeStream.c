@@ -0,0 +1,364 @@
+/***********************************************************/
+/* Stream transport (TCP or Unix stream sockets) for the   */
+/* TicTacToe server. Commands and replies are sent as      */
+/* length-prefixed frames, so a client can keep many games */
+/* going and pipeline commands over one connection.        */
+/***********************************************************/
+
+/* Needed for accept4() */
+#define _GNU_SOURCE
+
+/* #include files go here */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "tictactoeStream.h"
+
+/**
+ * @brief Reads the monotonic clock.
+ *
+ * @return The current time in nanoseconds.
+ */
+static uint64_t stream_clock(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/**
+ * @brief Parses a stream address: a Unix socket path (anything containing a '/') or a TCP
+ * address of the form [<ip>:]<port>.
+ *
+ * @param address The address to parse.
+ * @param passive Whether the address is listened on (a missing IP address is then any local
+ * address, otherwise it is the loopback address).
+ * @param addr Set to the socket address.
+ * @param length Set to the size of the socket address.
+ * @return Zero on success, -1 if the address is invalid (errno is set).
+ */
+static int stream_address(const char *address, int passive, struct sockaddr_storage *addr, socklen_t *length) {
+    struct sockaddr_un *unixAddr = (struct sockaddr_un *)addr;
+    struct sockaddr_in *inetAddr = (struct sockaddr_in *)addr;
+    const char *colon = strrchr(address, ':'), *portText = (colon != NULL) ? colon + 1 : address;
+    char host[INET_ADDRSTRLEN], *end;
+    long port;
+    memset(addr, 0, sizeof(struct sockaddr_storage));
+    if (strchr(address, '/') != NULL) {
+        if (strlen(address) >= sizeof(unixAddr->sun_path)) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        unixAddr->sun_family = AF_UNIX;
+        strcpy(unixAddr->sun_path, address);
+        *length = sizeof(struct sockaddr_un);
+        return 0;
+    }
+    inetAddr->sin_family = AF_INET;
+    inetAddr->sin_addr.s_addr = htonl(passive ? INADDR_ANY : INADDR_LOOPBACK);
+    if (colon != NULL) {
+        if (colon - address >= INET_ADDRSTRLEN) {
+            errno = EINVAL;
+            return -1;
+        }
+        memcpy(host, address, colon - address);
+        host[colon - address] = '\0';
+        if (inet_pton(AF_INET, host, &inetAddr->sin_addr) != 1) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+    port = strtol(portText, &end, 10);
+    if (*portText == '\0' || *end != '\0' || port < 1 || port > UINT16_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    inetAddr->sin_port = htons(port);
+    *length = sizeof(struct sockaddr_in);
+    return 0;
+}
+
+/**
+ * @brief Turns off Nagle's algorithm on a TCP connection. Replies are already coalesced into one
+ * write per flush, so holding them back for an acknowledgement would only add latency. Has no
+ * effect on Unix sockets.
+ *
+ * @param fd The connected socket.
+ */
+static void stream_nodelay(int fd) {
+    int on = 1;
+    if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)) < 0) {
+        /* Not a TCP socket (EOPNOTSUPP) */
+    }
+}
+
+/**
+ * @brief Appends bytes to the output ring of a connection. The caller must check there is room.
+ *
+ * @param conn The connection.
+ * @param data The bytes to append.
+ * @param length The number of bytes.
+ */
+static void stream_append(struct Stream_Conn *conn, const void *data, int length) {
+    int end = (conn->outStart + conn->outLength) % STREAM_BUFFER, first = STREAM_BUFFER - end;
+    if (first > length) first = length;
+    memcpy(conn->output + end, data, first);
+    memcpy(conn->output, (const char *)data + first, length - first);
+    conn->outLength += length;
+}
+
+/**
+ * @brief Creates the non-blocking socket stream clients connect to. An existing socket file at
+ * a Unix socket path is replaced.
+ *
+ * @param address A Unix socket path or a TCP address ([<ip>:]<port>).
+ * @return The listening socket, or -1 if it could not be created (errno is set).
+ */
+int stream_listen(const char *address) {
+    int fd, on = 1;
+    struct sockaddr_storage addr;
+    socklen_t length;
+    if (stream_address(address, 1, &addr, &length) < 0) return -1;
+    if ((fd = socket(addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) return -1;
+    if (addr.ss_family == AF_UNIX) {
+        unlink(address);
+    } else if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) < 0) {
+        /* Only matters when restarting while old connections linger */
+    }
+    if (bind(fd, (struct sockaddr *)&addr, length) < 0 || listen(fd, SOMAXCONN) < 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Accepts a client connection as a non-blocking socket with empty buffers.
+ *
+ * @param listenFd The listening socket.
+ * @param conn Set to the server side of the connection.
+ * @return Zero on success, -1 if no connection could be accepted (errno is set).
+ */
+int stream_accept(int listenFd, struct Stream_Conn *conn) {
+    conn->inStart = conn->inLength = conn->outStart = conn->outLength = 0;
+    if ((conn->fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) < 0) return -1;
+    stream_nodelay(conn->fd);
+    return 0;
+}
+
+/**
+ * @brief Connects to the server's stream listener with a blocking socket.
+ *
+ * @param address A Unix socket path or a TCP address ([<ip>:]<port>, the loopback address if
+ * no IP address is given).
+ * @param conn Set to the client side of the connection.
+ * @return Zero on success, -1 if the server could not be reached (errno is set).
+ */
+int stream_connect(const char *address, struct Stream_Conn *conn) {
+    struct sockaddr_storage addr;
+    socklen_t length;
+    conn->inStart = conn->inLength = conn->outStart = conn->outLength = 0;
+    conn->fd = -1;
+    if (stream_address(address, 0, &addr, &length) < 0) return -1;
+    if ((conn->fd = socket(addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) return -1;
+    if (connect(conn->fd, (struct sockaddr *)&addr, length) < 0) {
+        int err = errno;
+        stream_close(conn);
+        errno = err;
+        return -1;
+    }
+    stream_nodelay(conn->fd);
+    return 0;
+}
+
+/**
+ * @brief Closes one side of a stream connection. Unsent output is dropped.
+ *
+ * @param conn The connection to close.
+ */
+void stream_close(struct Stream_Conn *conn) {
+    if (conn->fd >= 0) close(conn->fd);
+    conn->fd = -1;
+}
+
+/**
+ * @brief Reads whatever the peer has sent into the input buffer (one read call).
+ *
+ * @param conn The connection.
+ * @return The number of bytes read, 0 if the peer closed the connection, or -1 if there was an
+ * error (errno is set, EAGAIN if nothing was waiting or ENOBUFS if the input buffer is full).
+ */
+int stream_fill(struct Stream_Conn *conn) {
+    ssize_t rv;
+    /* Move the unparsed bytes to the front to make room */
+    if (conn->inStart > 0) {
+        memmove(conn->input, conn->input + conn->inStart, conn->inLength - conn->inStart);
+        conn->inLength -= conn->inStart;
+        conn->inStart = 0;
+    }
+    if (conn->inLength == STREAM_BUFFER) {
+        errno = ENOBUFS;
+        return -1;
+    }
+    if ((rv = recv(conn->fd, conn->input + conn->inLength, STREAM_BUFFER - conn->inLength, 0)) > 0) conn->inLength += rv;
+    return rv;
+}
+
+/**
+ * @brief Takes the next complete frame out of the input buffer.
+ *
+ * @param conn The connection.
+ * @param data The buffer the frame is copied to (truncated to its size).
+ * @param size The size of the buffer.
+ * @return The number of bytes copied, 0 if no complete frame has been received, or -1 if the
+ * frame is empty or longer than STREAM_FRAME_MAX (errno is EPROTO; the stream cannot be
+ * parsed any further).
+ */
+int stream_next(struct Stream_Conn *conn, void *data, int size) {
+    const unsigned char *frame = (const unsigned char *)conn->input + conn->inStart;
+    int available = conn->inLength - conn->inStart, length;
+    if (available < STREAM_HEADER) return 0;
+    length = frame[0] << 8 | frame[1];
+    if (length == 0 || length > STREAM_FRAME_MAX) {
+        errno = EPROTO;
+        return -1;
+    }
+    if (available < STREAM_HEADER + length) return 0;
+    conn->inStart += STREAM_HEADER + length;
+    if (length > size) length = size;
+    memcpy(data, frame + STREAM_HEADER, length);
+    return length;
+}
+
+/**
+ * @brief Checks whether stream_next() has anything to return (a complete frame or a framing
+ * error).
+ *
+ * @param conn The connection.
+ * @return True if a frame is waiting, false otherwise.
+ */
+int stream_pending(const struct Stream_Conn *conn) {
+    const unsigned char *frame = (const unsigned char *)conn->input + conn->inStart;
+    int available = conn->inLength - conn->inStart, length;
+    if (available < STREAM_HEADER) return 0;
+    length = frame[0] << 8 | frame[1];
+    return length == 0 || length > STREAM_FRAME_MAX || available >= STREAM_HEADER + length;
+}
+
+/**
+ * @brief Gets the room left in the output ring of a connection.
+ *
+ * @param conn The connection.
+ * @return The number of bytes that can still be queued (including frame headers).
+ */
+int stream_space(const struct Stream_Conn *conn) {
+    return STREAM_BUFFER - conn->outLength;
+}
+
+/**
+ * @brief Queues a frame to be sent on the next stream_flush().
+ *
+ * @param conn The connection.
+ * @param data The frame contents (same layout as the datagram).
+ * @param length The size of the frame contents [1-STREAM_FRAME_MAX].
+ * @return The size of the frame contents, or -1 if the output ring is full (errno is ENOBUFS)
+ * or the frame is too big (errno is EMSGSIZE).
+ */
+int stream_queue(struct Stream_Conn *conn, const void *data, int length) {
+    unsigned char header[STREAM_HEADER] = {(unsigned char)(length >> 8), (unsigned char)length};
+    if (length < 1 || length > STREAM_FRAME_MAX) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    if (stream_space(conn) < STREAM_HEADER + length) {
+        errno = ENOBUFS;
+        return -1;
+    }
+    stream_append(conn, header, STREAM_HEADER);
+    stream_append(conn, data, length);
+    return length;
+}
+
+/**
+ * @brief Sends as much of the queued output as the socket takes in one gathered write (the
+ * ring may wrap, so it is sent as two pieces).
+ *
+ * @param conn The connection.
+ * @return The number of bytes still queued, or -1 if the connection failed (errno is set).
+ */
+int stream_flush(struct Stream_Conn *conn) {
+    struct iovec iov[2];
+    struct msghdr msg = {0};
+    ssize_t rv;
+    int first = STREAM_BUFFER - conn->outStart;
+    if (conn->outLength == 0) return 0;
+    if (first > conn->outLength) first = conn->outLength;
+    iov[0].iov_base = conn->output + conn->outStart;
+    iov[0].iov_len = first;
+    iov[1].iov_base = conn->output;
+    iov[1].iov_len = conn->outLength - first;
+    msg.msg_iov = iov;
+    msg.msg_iovlen = (iov[1].iov_len > 0) ? 2 : 1;
+    if ((rv = sendmsg(conn->fd, &msg, MSG_NOSIGNAL)) < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? conn->outLength : -1;
+    }
+    conn->outStart = (conn->outStart + rv) % STREAM_BUFFER;
+    conn->outLength -= rv;
+    if (conn->outLength == 0) conn->outStart = 0;
+    return conn->outLength;
+}
+
+/**
+ * @brief Sends a command to the server, waiting until it has all been written.
+ *
+ * @param conn The client side of the connection.
+ * @param data The command (same layout as the datagram).
+ * @param length The size of the command.
+ * @return The size of the command, or -1 if it could not be sent (errno is set).
+ */
+int stream_send(struct Stream_Conn *conn, const void *data, int length) {
+    if (stream_queue(conn, data, length) < 0) return -1;
+    while (conn->outLength > 0) {
+        if (stream_flush(conn) < 0) return -1;
+    }
+    return length;
+}
+
+/**
+ * @brief Receives a reply from the server.
+ *
+ * @param conn The client side of the connection.
+ * @param data The buffer the reply is copied to.
+ * @param size The size of the buffer.
+ * @param timeout The number of milliseconds to wait (-1 to wait forever).
+ * @return The size of the reply, 0 if none arrived in time, or -1 if the server hung up or
+ * sent a frame that cannot be parsed (errno is set).
+ */
+int stream_receive(struct Stream_Conn *conn, void *data, int size, int timeout) {
+    uint64_t now, deadline = stream_clock() + timeout * 1000000ULL;
+    int length, rv;
+    while ((length = stream_next(conn, data, size)) == 0) {
+        struct pollfd event = {conn->fd, POLLIN, 0};
+        int wait = -1;
+        if (timeout >= 0) {
+            if ((now = stream_clock()) >= deadline) return 0;
+            wait = (deadline - now + 999999) / 1000000;
+        }
+        if ((rv = poll(&event, 1, wait)) < 0 && errno != EINTR) return -1;
+        if (rv > 0 && (rv = stream_fill(conn)) <= 0) {
+            if (rv == 0) errno = ECONNRESET;
+            return -1;
+        }
+    }
+    return length;
+}
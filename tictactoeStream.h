@@ -0,0 +1,40 @@
+/***********************************************************/
+/* Stream transport (TCP or Unix stream sockets) for the   */
+/* TicTacToe server. Commands and replies are sent as      */
+/* length-prefixed frames, so a client can keep many games */
+/* going and pipeline commands over one connection.        */
+/***********************************************************/
+
+#ifndef TICTACTOE_STREAM_H
+#define TICTACTOE_STREAM_H
+
+/* The size of the frame header (the frame length as a 16-bit big-endian integer). */
+#define STREAM_HEADER 2
+/* The largest frame accepted (longer commands are truncated like datagrams). */
+#define STREAM_FRAME_MAX 64
+/* The size of each connection's input and output buffers. */
+#define STREAM_BUFFER 4096
+
+/* Structure for one side of a stream connection. */
+struct Stream_Conn {
+    int fd;                         // connected socket (-1 if closed)
+    int inStart, inLength;          // first unparsed byte and number of bytes in the input buffer
+    int outStart, outLength;        // first unsent byte and number of bytes in the output ring
+    char input[STREAM_BUFFER];      // bytes received and not yet parsed into frames
+    char output[STREAM_BUFFER];     // framed replies not yet sent (a ring)
+};
+
+int stream_listen(const char *address);
+int stream_accept(int listenFd, struct Stream_Conn *conn);
+int stream_connect(const char *address, struct Stream_Conn *conn);
+void stream_close(struct Stream_Conn *conn);
+int stream_fill(struct Stream_Conn *conn);
+int stream_next(struct Stream_Conn *conn, void *data, int size);
+int stream_pending(const struct Stream_Conn *conn);
+int stream_space(const struct Stream_Conn *conn);
+int stream_queue(struct Stream_Conn *conn, const void *data, int length);
+int stream_flush(struct Stream_Conn *conn);
+int stream_send(struct Stream_Conn *conn, const void *data, int length);
+int stream_receive(struct Stream_Conn *conn, void *data, int size, int timeout);
+
+#endif
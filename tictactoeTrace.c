@@ -0,0 +1,299 @@
+/***********************************************************/
+/* Low-overhead per-stage latency tracing for the server.  */
+/* Stage latencies are aggregated into HDR histograms per  */
+/* command type and dumped on a signal or at intervals.    */
+/***********************************************************/
+
+/* #include files go here */
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include "tictactoeTrace.h"
+
+int traceEnabled = 0;
+
+/* The number of seconds between periodic dumps (0 to only dump on SIGUSR1). */
+static int dumpInterval = 0;
+/* The time of the last periodic dump. */
+static uint64_t lastDump = 0;
+/* Set by the signal handler when a dump has been requested. */
+static volatile sig_atomic_t dumpRequested = 0;
+/* The latency histograms for each stage of each command type. */
+static struct HDR_Histogram histograms[TRACE_COMMANDS][NUM_STAGES];
+/* The latency record of the command currently being processed. */
+static struct Trace_Record current;
+
+/* The names of the traced command types. */
+static const char *commandNames[TRACE_COMMANDS] = {"NEW_GAME", "MOVE", "ANALYZE"};
+/* The names of the traced stages. */
+static const char *stageNames[NUM_STAGES] = {"queue", "validate", "sched", "engine", "search", "print", "send", "total"};
+
+/**
+ * @brief Determines the histogram counter that a value is recorded in.
+ *
+ * @param value The value to be recorded.
+ * @return The index of the counter for the value.
+ */
+static int hdr_index(uint64_t value) {
+    int msb, shift;
+    /* Values below the sub-bucket count are recorded exactly */
+    if (value < HDR_SUB_COUNT) return (int)value;
+    /* Clamp values past the tracked range to the last counter */
+    if ((msb = 63 - __builtin_clzll(value)) > HDR_MAX_BITS) return HDR_COUNTS - 1;
+    /* Keep the top HDR_SUB_BITS bits of the value */
+    shift = msb - HDR_SUB_BITS + 1;
+    return HDR_SUB_COUNT + (shift - 1) * HDR_HALF_COUNT + (int)((value >> shift) - HDR_HALF_COUNT);
+}
+
+/**
+ * @brief Determines the highest value that is recorded in a histogram counter.
+ *
+ * @param index The index of the counter.
+ * @return The highest value equivalent to the counter.
+ */
+static uint64_t hdr_value(int index) {
+    int shift, sub;
+    if (index < HDR_SUB_COUNT) return (uint64_t)index;
+    shift = (index - HDR_SUB_COUNT) / HDR_HALF_COUNT + 1;
+    sub = (index - HDR_SUB_COUNT) % HDR_HALF_COUNT + HDR_HALF_COUNT;
+    return (((uint64_t)sub + 1) << shift) - 1;
+}
+
+/**
+ * @brief Resets a histogram to its empty state.
+ *
+ * @param hist The histogram to reset.
+ */
+void hdr_init(struct HDR_Histogram *hist) {
+    memset(hist, 0, sizeof(struct HDR_Histogram));
+    hist->min = UINT64_MAX;
+}
+
+/**
+ * @brief Records a value in a histogram.
+ *
+ * @param hist The histogram to record the value in.
+ * @param value The value to record.
+ */
+void hdr_record(struct HDR_Histogram *hist, uint64_t value) {
+    hist->counts[hdr_index(value)]++;
+    hist->count++;
+    if (value < hist->min) hist->min = value;
+    if (value > hist->max) hist->max = value;
+}
+
+/**
+ * @brief Finds the value at the given percentile of a histogram.
+ *
+ * @param hist The histogram to search.
+ * @param percentile The percentile to find [0-100].
+ * @return The value at the percentile (within the histogram precision), or 0 if empty.
+ */
+uint64_t hdr_percentile(const struct HDR_Histogram *hist, double percentile) {
+    int i;
+    uint64_t seen = 0, target;
+    if (hist->count == 0) return 0;
+    /* Find the rank of the value at the percentile */
+    target = (uint64_t)(percentile / 100.0 * hist->count + 0.5);
+    if (target < 1) target = 1;
+    if (target > hist->count) target = hist->count;
+    /* Walk the counters until the rank has been reached */
+    for (i = 0; i < HDR_COUNTS; i++) {
+        if ((seen += hist->counts[i]) >= target) {
+            uint64_t value = hdr_value(i);
+            return (value > hist->max) ? hist->max : value;
+        }
+    }
+    return hist->max;
+}
+
+/**
+ * @brief Adds all the values recorded in one histogram to another.
+ *
+ * @param dest The histogram to add values to.
+ * @param src The histogram to add values from.
+ */
+void hdr_merge(struct HDR_Histogram *dest, const struct HDR_Histogram *src) {
+    int i;
+    if (src->count == 0) return;
+    for (i = 0; i < HDR_COUNTS; i++) dest->counts[i] += src->counts[i];
+    dest->count += src->count;
+    if (src->min < dest->min) dest->min = src->min;
+    if (src->max > dest->max) dest->max = src->max;
+}
+
+/**
+ * @brief Reads the monotonic clock used for tracing.
+ *
+ * @return The current time in nanoseconds.
+ */
+uint64_t trace_clock(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/**
+ * @brief Signal handler that requests a dump of the trace histograms.
+ *
+ * @param signum The signal number received.
+ */
+static void request_dump(int signum) {
+    dumpRequested = 1;
+}
+
+/**
+ * @brief Turns on tracing and sets up SIGUSR1 to request a dump of the trace histograms.
+ *
+ * @param interval The number of seconds between periodic dumps (0 to only dump on SIGUSR1).
+ */
+void trace_init(int interval) {
+    int i, j;
+    struct sigaction action = {0};
+    /* Reset all histograms */
+    for (i = 0; i < TRACE_COMMANDS; i++) {
+        for (j = 0; j < NUM_STAGES; j++) hdr_init(&histograms[i][j]);
+    }
+    /* Install the dump request handler (without SA_RESTART so recvfrom is interrupted) */
+    action.sa_handler = request_dump;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGUSR1, &action, NULL);
+    dumpInterval = interval;
+    lastDump = trace_clock();
+    traceEnabled = 1;
+}
+
+/**
+ * @brief Begins tracing a newly received command.
+ *
+ * @param queueTime The time the datagram spent queued in the kernel, or 0 if unknown.
+ */
+void trace_command_begin(uint64_t queueTime) {
+    memset(&current, 0, sizeof(current));
+    current.active = 1;
+    current.start = trace_clock();
+    if (queueTime) {
+        current.elapsed[STAGE_QUEUE] = queueTime;
+        current.stages |= 1u << STAGE_QUEUE;
+    }
+}
+
+/**
+ * @brief Starts timing a stage of the current command.
+ *
+ * @param stage The stage being started.
+ */
+void trace_stage_begin(enum TTT_Stage stage) {
+    if (current.active) current.stageStart[stage] = trace_clock();
+}
+
+/**
+ * @brief Stops timing a stage of the current command. A stage may be timed more than once
+ * per command, in which case the times are summed.
+ *
+ * @param stage The stage being stopped.
+ */
+void trace_stage_end(enum TTT_Stage stage) {
+    if (current.active) {
+        current.elapsed[stage] += trace_clock() - current.stageStart[stage];
+        current.stages |= 1u << stage;
+    }
+}
+
+/**
+ * @brief Finishes tracing the current command and records its stage latencies.
+ *
+ * @param command The command type of the current command.
+ */
+void trace_command_end(int command) {
+    int i;
+    if (!current.active) return;
+    current.active = 0;
+    if (command < 0 || command >= TRACE_COMMANDS) return;
+    /* Total time includes the time spent queued in the kernel */
+    current.elapsed[STAGE_TOTAL] = current.elapsed[STAGE_QUEUE] + trace_clock() - current.start;
+    current.stages |= 1u << STAGE_TOTAL;
+    /* Record each stage that was timed */
+    for (i = 0; i < NUM_STAGES; i++) {
+        if (current.stages & (1u << i)) hdr_record(&histograms[command][i], current.elapsed[i]);
+    }
+}
+
+/**
+ * @brief Stops tracing the current command without recording it (e.g. it was discarded).
+ */
+void trace_command_discard(void) {
+    current.active = 0;
+}
+
+/**
+ * @brief Sets the current command aside while its move is computed by an engine worker, so
+ * other commands can be traced in the meantime.
+ *
+ * @param record The record the current command is saved to.
+ */
+void trace_command_suspend(struct Trace_Record *record) {
+    *record = current;
+    current.active = 0;
+}
+
+/**
+ * @brief Makes a command set aside by trace_command_suspend() the current command again.
+ *
+ * @param record The record the command was saved to.
+ */
+void trace_command_resume(const struct Trace_Record *record) {
+    current = *record;
+}
+
+/**
+ * @brief Adds a stage time measured elsewhere (e.g. on an engine worker) to the current command.
+ *
+ * @param stage The stage that was timed.
+ * @param elapsed The time in nanoseconds spent in the stage.
+ */
+void trace_stage_add(enum TTT_Stage stage, uint64_t elapsed) {
+    if (current.active) {
+        current.elapsed[stage] += elapsed;
+        current.stages |= 1u << stage;
+    }
+}
+
+/**
+ * @brief Dumps the trace histograms if a dump was requested by a signal or the dump interval
+ * has passed.
+ */
+void trace_poll(void) {
+    uint64_t now;
+    if (!traceEnabled) return;
+    now = trace_clock();
+    if (dumpRequested || (dumpInterval > 0 && now - lastDump >= (uint64_t)dumpInterval * 1000000000ULL)) {
+        dumpRequested = 0;
+        lastDump = now;
+        trace_dump(stdout);
+    }
+}
+
+/**
+ * @brief Prints the latency percentiles of each stage of each command type (in microseconds).
+ *
+ * @param stream The stream to print to.
+ */
+void trace_dump(FILE *stream) {
+    int i, j;
+    fprintf(stream, "[+]Stage latencies since the server started (usec):\n");
+    for (i = 0; i < TRACE_COMMANDS; i++) {
+        fprintf(stream, "%s (%llu commands)\n", commandNames[i], (unsigned long long)histograms[i][STAGE_TOTAL].count);
+        fprintf(stream, "  %-9s %8s %9s %9s %9s %9s %9s %9s\n", "stage", "count", "min", "p50", "p90", "p99", "p99.9", "max");
+        for (j = 0; j < NUM_STAGES; j++) {
+            const struct HDR_Histogram *hist = &histograms[i][j];
+            if (hist->count == 0) continue;
+            fprintf(stream, "  %-9s %8llu %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n", stageNames[j],
+                (unsigned long long)hist->count, hist->min / 1000.0,
+                hdr_percentile(hist, 50) / 1000.0, hdr_percentile(hist, 90) / 1000.0,
+                hdr_percentile(hist, 99) / 1000.0, hdr_percentile(hist, 99.9) / 1000.0,
+                hist->max / 1000.0);
+        }
+    }
+    fflush(stream);
+}
@@ -0,0 +1,82 @@
+/***********************************************************/
+/* Low-overhead per-stage latency tracing for the server.  */
+/* Stage latencies are aggregated into HDR histograms per  */
+/* command type and dumped on a signal or at intervals.    */
+/***********************************************************/
+
+#ifndef TICTACTOE_TRACE_H
+#define TICTACTOE_TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* The number of bits of sub-bucket precision for each histogram (~1% error). */
+#define HDR_SUB_BITS 7
+/* The number of sub-buckets in the first histogram bucket. */
+#define HDR_SUB_COUNT (1 << HDR_SUB_BITS)
+/* The number of sub-buckets in every other histogram bucket. */
+#define HDR_HALF_COUNT (HDR_SUB_COUNT / 2)
+/* The largest power of two (in nanoseconds) tracked by a histogram (~18 minutes). */
+#define HDR_MAX_BITS 40
+/* The total number of counters in each histogram. */
+#define HDR_COUNTS (HDR_SUB_COUNT + (HDR_MAX_BITS - HDR_SUB_BITS + 1) * HDR_HALF_COUNT)
+
+/* The number of command types traced (NEW_GAME, MOVE and ANALYZE). */
+#define TRACE_COMMANDS 3
+
+/* The stages of a command that are timed by the tracer. */
+enum TTT_Stage {
+    STAGE_QUEUE,        // time the datagram spent queued in the kernel
+    STAGE_VALIDATE,     // time spent validating the command in validate_command()
+    STAGE_SCHED,        // time the command waited in the server's scheduler
+    STAGE_ENGINE,       // time a move job waited for an engine worker
+    STAGE_SEARCH,       // time spent in find_best_move()
+    STAGE_PRINT,        // time spent printing the board
+    STAGE_SEND,         // time spent in sendto()
+    STAGE_TOTAL,        // time from kernel arrival to the end of dispatch
+    NUM_STAGES
+};
+
+/* High dynamic range histogram of latencies in nanoseconds. */
+struct HDR_Histogram {
+    uint64_t count;                 // number of values recorded
+    uint64_t min, max;              // smallest and largest values recorded
+    uint64_t counts[HDR_COUNTS];    // number of values recorded in each bucket
+};
+
+/* Structure for the latency record of a command being processed. */
+struct Trace_Record {
+    int active;                         // whether or not a command is being traced
+    unsigned stages;                    // bitmask of the stages that were timed
+    uint64_t start;                     // time the command was received
+    uint64_t stageStart[NUM_STAGES];    // time each stage was last started
+    uint64_t elapsed[NUM_STAGES];       // total time spent in each stage
+};
+
+/* Whether or not tracing is turned on (checked by the TRACE_* macros). */
+extern int traceEnabled;
+
+/* Starts timing the given stage of the current command if tracing is on. */
+#define TRACE_BEGIN(stage) do { if (traceEnabled) trace_stage_begin(stage); } while (0)
+/* Stops timing the given stage of the current command if tracing is on. */
+#define TRACE_END(stage) do { if (traceEnabled) trace_stage_end(stage); } while (0)
+
+void hdr_init(struct HDR_Histogram *hist);
+void hdr_record(struct HDR_Histogram *hist, uint64_t value);
+uint64_t hdr_percentile(const struct HDR_Histogram *hist, double percentile);
+void hdr_merge(struct HDR_Histogram *dest, const struct HDR_Histogram *src);
+
+uint64_t trace_clock(void);
+void trace_init(int interval);
+void trace_command_begin(uint64_t queueTime);
+void trace_stage_begin(enum TTT_Stage stage);
+void trace_stage_end(enum TTT_Stage stage);
+void trace_command_end(int command);
+void trace_command_discard(void);
+void trace_command_suspend(struct Trace_Record *record);
+void trace_command_resume(const struct Trace_Record *record);
+void trace_stage_add(enum TTT_Stage stage, uint64_t elapsed);
+void trace_poll(void);
+void trace_dump(FILE *stream);
+
+#endif
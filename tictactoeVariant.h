@@ -0,0 +1,319 @@
+/***********************************************************/
+/* Engine template specialized for a single board variant. */
+/* This file is included once per variant by the generated */
+/* tictactoeVariants.h, with VARIANT (the identifier       */
+/* suffix) and the VARIANT_* geometry constants defined,   */
+/* so every loop below runs over compile-time constants.   */
+/***********************************************************/
+
+/* Pastes the variant suffix onto a function name. */
+#define VARIANT_PASTE(name, suffix) name##_##suffix
+#define VARIANT_NAME(name, suffix) VARIANT_PASTE(name, suffix)
+#define VFN(name) VARIANT_NAME(name, VARIANT)
+
+/**
+ * @brief Determines if someone has won the game yet or not.
+ *
+ * @param board The board to check.
+ * @return A positive score if Player 1 has won, a negative score if Player 2 has won, and
+ * 0 if the game is still going on.
+ */
+static int VFN(check_win)(const struct TTT_Board *board) {
+    if (VFN(has_line)(board->marks[0])) return VARIANT_WIN_SCORE;
+    if (VFN(has_line)(board->marks[1])) return -VARIANT_WIN_SCORE;
+    return 0;
+}
+
+/**
+ * @brief Determines if there are moves left in the game to be made or not.
+ *
+ * @param board The board to check.
+ * @return True if there are no moves left to be made, false otherwise.
+ */
+static int VFN(check_draw)(const struct TTT_Board *board) {
+    return (board->marks[0] | board->marks[1]) == VARIANT_FULL;
+}
+
+/**
+ * @brief Scores a board at the search horizon by how many more lines are still open to
+ * Player 1 than to Player 2.
+ *
+ * @param board The board to score.
+ * @return The heuristic score of the board for the maximizer.
+ */
+static int VFN(evaluate)(const struct TTT_Board *board) {
+    return VFN(open_lines)(board->marks[1]) - VFN(open_lines)(board->marks[0]);
+}
+
+/**
+ * @brief Provides an optimal move for the maximizing player assuming that minimizing player
+ * is also playing optimally.
+ *
+ * @param board The board being searched (restored before returning).
+ * @param depth The current depth in game tree.
+ * @param isMax Whether it is the maximizers turn or not.
+ * @return The best score achievable for the maximizer based on the current state of the game.
+ */
+static int VFN(minimax)(struct TTT_Board *board, int depth, int isMax) {
+    /* Get score for current turn */
+    int score = VFN(check_win)(board);
+    /* Check for base case */
+    if (score > 0) {    // maximizer won
+        return score - depth;
+    } else if (score < 0) {    // minimizer won
+        return score + depth;
+    } else if (VFN(check_draw)(board)) {  // nobody won
+        return 0;
+    } else if (depth >= VARIANT_MAX_DEPTH) {    // search horizon reached
+        return VFN(evaluate)(board);
+    } else {
+        /* Initialize best score for maximizer/minimizer */
+        int i, best = (isMax) ? INT32_MIN : INT32_MAX;
+        uint32_t open = ~(board->marks[0] | board->marks[1]) & VARIANT_FULL;
+        /* Searches over all possible moves */
+        for (i = 0; i < VARIANT_SQUARES; i++) {
+            uint32_t square = 1u << VFN(moveOrder)[i];
+            /* Checks that current move is valid based on the current board */
+            if (open & square) {
+                int value;
+                /* Make the move, get its score and undo it */
+                board->marks[!isMax] |= square;
+                value = VFN(minimax)(board, depth+1, !isMax);
+                board->marks[!isMax] &= ~square;
+                /* Update best score if the score was better for the current player */
+                if ((isMax) ? value > best : value < best) best = value;
+            }
+        }
+        return best;
+    }
+}
+
+/**
+ * @brief Finds the optimal move for Player 1 to make based on the current state of the board.
+ *
+ * @param board The board to search.
+ * @param value If not NULL, set to the minimax score of the optimal move.
+ * @return The optimal square (1-based) to play, or -1 if the board is full.
+ */
+static int VFN(find_best_move)(const struct TTT_Board *board, int *value) {
+    int i, bestMove = -1, bestValue = INT32_MIN;
+    struct TTT_Board search = *board;
+    uint32_t open = ~(board->marks[0] | board->marks[1]) & VARIANT_FULL;
+    /* Searches over all possible moves */
+    for (i = 0; i < VARIANT_SQUARES; i++) {
+        uint32_t square = 1u << VFN(moveOrder)[i];
+        /* Checks that current move is valid based on the current board */
+        if (open & square) {
+            int moveValue;
+            /* Make the move, get its score and undo it */
+            search.marks[0] |= square;
+            moveValue = VFN(minimax)(&search, 0, 0);
+            search.marks[0] &= ~square;
+            /* Update the best move if the current score was better */
+            if (moveValue > bestValue) {
+                bestValue = moveValue;
+                bestMove = VFN(moveOrder)[i] + 1;
+            }
+        }
+    }
+    if (value != NULL) *value = bestValue;
+    return bestMove;
+}
+
+/**
+ * @brief Minimax over a batch of boards in lockstep, one board per lane, giving every lane the
+ * score minimax() gives its board. Boards are held in search order (bit i is square
+ * moveOrder[i]), so the k-th child of every lane plays that lane's k-th open square in move
+ * order: lanes with as many open squares walk the same tree, and a lane sits out the children
+ * it has no move for.
+ *
+ * @param p1 The squares marked by Player 1 on each lane.
+ * @param p2 The squares marked by Player 2 on each lane.
+ * @param active The lanes being searched (all ones) at this node.
+ * @param depth The current depth in game tree.
+ * @param isMax Whether it is the maximizers turn or not.
+ * @return The best score achievable for the maximizer on each active lane.
+ */
+static ttt_lanes_i32 VFN(minimax_lanes)(ttt_lanes_u32 p1, ttt_lanes_u32 p2, ttt_lanes_i32 active, int depth, int isMax) {
+    /* Score the lanes that end here: a win for either player, then a draw (scored 0) */
+    ttt_lanes_i32 won = VFN(has_line_lanes)(p1), lost = VFN(has_line_lanes)(p2);
+    ttt_lanes_u32 open = ~(p1 | p2) & VARIANT_FULL, remaining;
+    ttt_lanes_i32 ended = won | lost | (open == 0), live, best;
+    ttt_lanes_i32 score = (won & (VARIANT_WIN_SCORE - depth)) | (~won & lost & (depth - VARIANT_WIN_SCORE));
+    if (depth >= VARIANT_MAX_DEPTH) {    // search horizon reached
+        return score | (~ended & (VFN(open_lines_lanes)(p2) - VFN(open_lines_lanes)(p1)));
+    }
+    live = active & ~ended;
+    if (!any_lane((ttt_lanes_u32)live)) return score;
+    /* Searches the k-th open square of every live lane together */
+    best = (ttt_lanes_i32){0} + ((isMax) ? INT32_MIN : INT32_MAX);
+    remaining = open & (ttt_lanes_u32)live;
+    while (any_lane(remaining)) {
+        ttt_lanes_u32 square = remaining & -remaining;
+        ttt_lanes_i32 child = (square != 0), value;
+        remaining ^= square;
+        /* Update best score on the lanes where the score was better for the current player */
+        if (isMax) {
+            value = VFN(minimax_lanes)(p1 | square, p2, child, depth+1, 0);
+            best = blend_lanes(child & (value > best), value, best);
+        } else {
+            value = VFN(minimax_lanes)(p1, p2 | square, child, depth+1, 1);
+            best = blend_lanes(child & (value < best), value, best);
+        }
+    }
+    return score | (live & best);
+}
+
+/**
+ * @brief Finds the optimal move for Player 1 on each of up to TTT_LANES boards, searched in
+ * lockstep by minimax_lanes(). The moves and scores are those find_best_move() gives.
+ *
+ * @param boards The boards to search.
+ * @param count The number of boards (at most TTT_LANES).
+ * @param moves Set to the optimal square (1-based) to play on each board, or -1 if it is full.
+ * @param values If not NULL, set to the minimax score of the optimal move on each board.
+ */
+static void VFN(find_best_moves)(const struct TTT_Board *boards, int count, int *moves, int *values) {
+    ttt_lanes_u32 p1 = {0}, p2 = {0}, remaining, bestSquare = {0};
+    ttt_lanes_i32 active = {0}, bestValue = (ttt_lanes_i32){0} + INT32_MIN;
+    int i, lane;
+    /* Load each board into a lane in search order */
+    for (lane = 0; lane < count; lane++) {
+        for (i = 0; i < VARIANT_SQUARES; i++) {
+            p1[lane] |= ((boards[lane].marks[0] >> VFN(moveOrder)[i]) & 1u) << i;
+            p2[lane] |= ((boards[lane].marks[1] >> VFN(moveOrder)[i]) & 1u) << i;
+        }
+        active[lane] = -1;
+    }
+    /* Searches over all possible moves, the k-th open square of every board together */
+    remaining = ~(p1 | p2) & VARIANT_FULL & (ttt_lanes_u32)active;
+    while (any_lane(remaining)) {
+        ttt_lanes_u32 square = remaining & -remaining;
+        ttt_lanes_i32 child = (square != 0), value, better;
+        remaining ^= square;
+        value = VFN(minimax_lanes)(p1 | square, p2, child, 0, 0);
+        /* Update the best move on the lanes where the current score was better */
+        better = child & (value > bestValue);
+        bestValue = blend_lanes(better, value, bestValue);
+        bestSquare = (ttt_lanes_u32)blend_lanes(better, (ttt_lanes_i32)square, (ttt_lanes_i32)bestSquare);
+    }
+    for (lane = 0; lane < count; lane++) {
+        moves[lane] = (bestSquare[lane] != 0) ? VFN(moveOrder)[__builtin_ctz(bestSquare[lane])] + 1 : -1;
+        if (values != NULL) values[lane] = bestValue[lane];
+    }
+}
+
+/**
+ * @brief Searches the game tree with alpha-beta pruning to the given horizon. The lower bound
+ * shared by every task of a parallel search is folded into alpha at each node, so a better
+ * root move found by one task prunes the trees being searched by the others.
+ *
+ * @param board The board being searched (restored before returning).
+ * @param depth The current depth in game tree.
+ * @param horizon The depth at which the board is scored by evaluate().
+ * @param alpha The score the maximizer is already assured of.
+ * @param beta The score the minimizer is already assured of.
+ * @param isMax Whether it is the maximizers turn or not.
+ * @param ctx The search context (shared bound, time budget and node count).
+ * @return The best score achievable for the maximizer, or a bound on it if it fell outside
+ * the alpha-beta window. The result is meaningless once the search has been stopped.
+ */
+static int VFN(alphabeta)(struct TTT_Board *board, int depth, int horizon, int alpha, int beta, int isMax, struct Search_Context *ctx) {
+    /* Get score for current turn */
+    int i, best, shared, score = VFN(check_win)(board);
+    uint32_t open;
+    /* Check for base case */
+    if (score > 0) {    // maximizer won
+        return score - depth;
+    } else if (score < 0) {    // minimizer won
+        return score + depth;
+    } else if (VFN(check_draw)(board)) {  // nobody won
+        return 0;
+    } else if (depth >= horizon) {    // search horizon reached
+        return VFN(evaluate)(board);
+    } else if (search_expired(ctx)) {   // time budget has run out
+        return 0;
+    }
+    /* Raise alpha to the best root score found by any task */
+    if ((shared = atomic_load_explicit(ctx->alpha, memory_order_relaxed)) > alpha) alpha = shared;
+    if (alpha >= beta) return alpha;
+    /* Searches over all possible moves until the window closes */
+    best = (isMax) ? INT32_MIN : INT32_MAX;
+    open = ~(board->marks[0] | board->marks[1]) & VARIANT_FULL;
+    for (i = 0; i < VARIANT_SQUARES && alpha < beta; i++) {
+        uint32_t square = 1u << VFN(moveOrder)[i];
+        if (open & square) {
+            int value;
+            /* Make the move, get its score and undo it */
+            board->marks[!isMax] |= square;
+            value = VFN(alphabeta)(board, depth+1, horizon, alpha, beta, !isMax, ctx);
+            board->marks[!isMax] &= ~square;
+            /* Update best score and narrow the window for the current player */
+            if (isMax) {
+                if (value > best) best = value;
+                if (best > alpha) alpha = best;
+            } else {
+                if (value < best) best = value;
+                if (best < beta) beta = best;
+            }
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Scores a single root move for Player 1 with an alpha-beta search to the given horizon.
+ *
+ * @param board The board before the move.
+ * @param square The square (0-based) Player 1 plays.
+ * @param horizon The number of plies searched after the move.
+ * @param ctx The search context (shared bound, time budget and node count).
+ * @return The score of the move, or an upper bound on it if it is no better than the shared
+ * bound.
+ */
+static int VFN(search_move)(const struct TTT_Board *board, int square, int horizon, struct Search_Context *ctx) {
+    struct TTT_Board search = *board;
+    search.marks[0] |= 1u << square;
+    return VFN(alphabeta)(&search, 0, horizon, atomic_load(ctx->alpha), INT32_MAX, 0, ctx);
+}
+
+/**
+ * @brief Prints out the current state of the board nicely formatted. Open squares show
+ * their square number.
+ *
+ * @param out The stream to print to.
+ * @param board The board to print.
+ * @param p1Mark The marker used for Player 1.
+ * @param p2Mark The marker used for Player 2.
+ */
+static void VFN(print_board)(FILE *out, const struct TTT_Board *board, char p1Mark, char p2Mark) {
+    int row, column;
+    for (row = 0; row < VARIANT_ROWS; row++) {
+        /* Print the separator above every row but the first */
+        if (row > 0) {
+            for (column = 0; column < VARIANT_COLUMNS; column++) fprintf(out, (column == 0) ? "_____" : "|_____");
+            fprintf(out, "\n");
+        }
+        for (column = 0; column < VARIANT_COLUMNS; column++) fprintf(out, (column == 0) ? "     " : "|     ");
+        fprintf(out, "\n");
+        /* Print each square as its marker or its square number */
+        for (column = 0; column < VARIANT_COLUMNS; column++) {
+            int square = row * VARIANT_COLUMNS + column;
+            if (column > 0) fprintf(out, "|");
+            if (board->marks[0] & (1u << square)) {
+                fprintf(out, "  %c  ", p1Mark);
+            } else if (board->marks[1] & (1u << square)) {
+                fprintf(out, "  %c  ", p2Mark);
+            } else {
+                fprintf(out, (VARIANT_SQUARES < 10) ? "  %d  " : " %2d  ", square + 1);
+            }
+        }
+        fprintf(out, "\n");
+    }
+    for (column = 0; column < VARIANT_COLUMNS; column++) fprintf(out, (column == 0) ? "     " : "|     ");
+    fprintf(out, "\n\n");
+}
+
+#undef VFN
+#undef VARIANT_NAME
+#undef VARIANT_PASTE
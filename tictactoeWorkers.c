@@ -0,0 +1,175 @@
+/***********************************************************/
+/* Engine worker pool that computes moves off the server's */
+/* receive loop. Jobs are queued to the workers in FIFO    */
+/* order and handed back through a lock-free completion    */
+/* queue, with an eventfd to wake the receive loop.        */
+/***********************************************************/
+
+/* #include files go here */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "tictactoeWorkers.h"
+
+/**
+ * @brief Pushes a finished job onto the completion queue. Safe to call from any number of
+ * workers at once (multi-producer, single-consumer, lock-free).
+ *
+ * @param pool The pool the job belongs to.
+ * @param job The finished job.
+ */
+static void completion_push(struct Engine_Pool *pool, struct Engine_Job *job) {
+    struct Engine_Job *prev;
+    atomic_store_explicit(&job->next, NULL, memory_order_relaxed);
+    prev = atomic_exchange_explicit(&pool->head, job, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, job, memory_order_release);
+}
+
+/**
+ * @brief Main loop of each engine worker. Takes jobs from the submission queue in order,
+ * computes them (unless cancelled while queued) and hands them back on the completion queue.
+ *
+ * @param arg The pool the worker belongs to.
+ * @return Always NULL.
+ */
+static void *worker_main(void *arg) {
+    struct Engine_Pool *pool = arg;
+    const uint64_t one = 1;
+    while (1) {
+        struct Engine_Job *job;
+        /* Wait for a job to be submitted */
+        pthread_mutex_lock(&pool->lock);
+        while (pool->first == NULL && !pool->shutdown) pthread_cond_wait(&pool->ready, &pool->lock);
+        if (pool->first == NULL) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        job = pool->first;
+        if ((pool->first = job->queueNext) == NULL) pool->last = NULL;
+        pthread_mutex_unlock(&pool->lock);
+        /* Compute the job and hand it back to the receive loop */
+        if (!atomic_load(&job->cancelled)) job->run(job);
+        completion_push(pool, job);
+        if (write(pool->eventFd, &one, sizeof(one)) < 0) perror("worker_main: write");
+    }
+    return NULL;
+}
+
+/**
+ * @brief Creates a pool of engine workers.
+ *
+ * @param numWorkers The number of worker threads to create [1-MAX_WORKERS].
+ * @return The new pool, or NULL if it could not be created.
+ */
+struct Engine_Pool *engine_create(int numWorkers) {
+    int i;
+    struct Engine_Pool *pool;
+    if (numWorkers < 1 || numWorkers > MAX_WORKERS) return NULL;
+    if ((pool = calloc(1, sizeof(struct Engine_Pool))) == NULL) return NULL;
+    if ((pool->eventFd = eventfd(0, EFD_NONBLOCK)) < 0) {
+        free(pool);
+        return NULL;
+    }
+    pool->numWorkers = numWorkers;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->ready, NULL);
+    atomic_store(&pool->head, &pool->stub);
+    pool->tail = &pool->stub;
+    for (i = 0; i < numWorkers; i++) {
+        if (pthread_create(&pool->threads[i], NULL, worker_main, pool) != 0) {
+            perror("engine_create: pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    return pool;
+}
+
+/**
+ * @brief Stops the engine workers (after they finish the queued jobs) and frees the pool.
+ * Completed jobs that were never collected are not freed.
+ *
+ * @param pool The pool to destroy.
+ */
+void engine_destroy(struct Engine_Pool *pool) {
+    int i;
+    if (pool == NULL) return;
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->ready);
+    pthread_mutex_unlock(&pool->lock);
+    for (i = 0; i < pool->numWorkers; i++) pthread_join(pool->threads[i], NULL);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->ready);
+    close(pool->eventFd);
+    free(pool);
+}
+
+/**
+ * @brief Queues a job for the engine workers. Jobs are started in the order they are submitted.
+ * Must only be called from the receive loop.
+ *
+ * @param pool The pool to run the job on.
+ * @param job The job to run.
+ */
+void engine_submit(struct Engine_Pool *pool, struct Engine_Job *job) {
+    job->queueNext = NULL;
+    atomic_store(&job->cancelled, 0);
+    pool->outstanding++;
+    pthread_mutex_lock(&pool->lock);
+    if (pool->last != NULL) {
+        pool->last->queueNext = job;
+    } else {
+        pool->first = job;
+    }
+    pool->last = job;
+    pthread_cond_signal(&pool->ready);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * @brief Takes the oldest finished job off the completion queue. Must only be called from
+ * the receive loop (the single consumer).
+ *
+ * @param pool The pool to collect from.
+ * @return The finished job, or NULL if no finished jobs are waiting.
+ */
+struct Engine_Job *engine_complete(struct Engine_Pool *pool) {
+    struct Engine_Job *tail = pool->tail;
+    struct Engine_Job *next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    /* Skip over the placeholder node */
+    if (tail == &pool->stub) {
+        if (next == NULL) return NULL;
+        pool->tail = tail = next;
+        next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    }
+    if (next != NULL) {
+        pool->tail = next;
+        pool->outstanding--;
+        return tail;
+    }
+    /* A worker is midway through pushing after the tail; try again later */
+    if (tail != atomic_load_explicit(&pool->head, memory_order_acquire)) return NULL;
+    /* The tail is the last job, so push the placeholder behind it before taking it */
+    completion_push(pool, &pool->stub);
+    if ((next = atomic_load_explicit(&tail->next, memory_order_acquire)) != NULL) {
+        pool->tail = next;
+        pool->outstanding--;
+        return tail;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Resets the completion event so the receive loop only wakes for newly finished jobs.
+ * Call before draining the completion queue.
+ *
+ * @param pool The pool whose event is reset.
+ */
+void engine_clear_event(struct Engine_Pool *pool) {
+    uint64_t count;
+    if (read(pool->eventFd, &count, sizeof(count)) < 0) {
+        /* Nothing to clear (EAGAIN) */
+    }
+}
@@ -0,0 +1,46 @@
+/***********************************************************/
+/* Engine worker pool that computes moves off the server's */
+/* receive loop. Jobs are queued to the workers in FIFO    */
+/* order and handed back through a lock-free completion    */
+/* queue, with an eventfd to wake the receive loop.        */
+/***********************************************************/
+
+#ifndef TICTACTOE_WORKERS_H
+#define TICTACTOE_WORKERS_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+/* The maximum number of engine worker threads. */
+#define MAX_WORKERS 64
+
+/* Structure for a job computed by an engine worker (embedded at the start of each job type). */
+struct Engine_Job {
+    void (*run)(struct Engine_Job *job);    // function that computes the job on a worker
+    struct Engine_Job *queueNext;           // next job in the submission queue
+    _Atomic(struct Engine_Job *) next;      // next job in the completion queue
+    atomic_int cancelled;                   // set if the result is no longer wanted
+};
+
+/* Structure for a pool of engine workers. */
+struct Engine_Pool {
+    int numWorkers;                         // number of worker threads
+    pthread_t threads[MAX_WORKERS];         // worker threads
+    pthread_mutex_t lock;                   // protects the submission queue
+    pthread_cond_t ready;                   // signalled when a job is submitted
+    struct Engine_Job *first, *last;        // submission queue (FIFO)
+    int shutdown;                           // set when the pool is being destroyed
+    _Atomic(struct Engine_Job *) head;      // completion queue: newest job (pushed by workers)
+    struct Engine_Job *tail;                // completion queue: oldest job (popped by receive loop)
+    struct Engine_Job stub;                 // completion queue placeholder node
+    int eventFd;                            // readable while completed jobs are waiting
+    int outstanding;                        // jobs submitted but not yet collected (receive loop only)
+};
+
+struct Engine_Pool *engine_create(int numWorkers);
+void engine_destroy(struct Engine_Pool *pool);
+void engine_submit(struct Engine_Pool *pool, struct Engine_Job *job);
+struct Engine_Job *engine_complete(struct Engine_Pool *pool);
+void engine_clear_event(struct Engine_Pool *pool);
+
+#endif